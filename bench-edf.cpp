@@ -0,0 +1,303 @@
+/*!
+	File name: $HeadURL:
+	\file
+    \brief Large-file benchmark: random access at the end of a >2 GiB recording must cost the same as at the start.
+
+	\note Usage: bench-edf <scratch file> [size in GiB, default 20]
+
+		  A sparse EDF file is created (header written, then a few marker records: the first ones
+		  past 2 GiB and 4 GiB and the last one), so no disk space is used on file systems with
+		  sparse file support (on NTFS the file is not marked sparse and the size is allocated).
+		  Marker samples are non-zero and differ per record, everything else reads back as zero, so a
+		  truncated or wrapped 64-bit offset reads the wrong values. The program exits with failure
+		  if any value read back is wrong. The scratch file is removed at the end.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+*   \brief Return the sample value written at position iIndex of a marker record (never 0, different per record).
+*/
+
+static short int sMarkerValue( long long llRecord, int iIndex )
+{
+	return( (short int)(1 + (llRecord * 131 + (long long)iIndex * 17) % 32000) );
+}
+
+/*!
+*   \brief Return the value expected at a sample: the marker value in a marker record, else 0.
+*/
+
+static int iExpectedSample( const vector<long long> &allMarkers, long long llRecord, int iSignal, int iSample, int iSamplesPerSignal )
+{
+	if( find( allMarkers.begin(), allMarkers.end(), llRecord ) == allMarkers.end() )
+	{
+		return( 0 );
+	}
+
+	return( sMarkerValue( llRecord, iSignal * iSamplesPerSignal + iSample ) );
+}
+
+/*!
+*   \brief Write a sparse EDF file of about llTargetBytes bytes.
+*   \return true if the file was written.
+*/
+
+static bool bWriteSparseEdf( char *pszFile, long long llTargetBytes, int iNumberSignals, int iSamplesPerSignal, long long *pllNumberRecords,
+	vector<long long> *pallMarkers )
+{
+	long long llRecordSize = (long long)iNumberSignals * iSamplesPerSignal * 2;
+	long long llNumberRecords = llTargetBytes / llRecordSize;
+	int iHeaderBytes = 256 + iNumberSignals * 256;
+	vector<char> acHeader( iHeaderBytes, ' ' );
+	char szField[96];
+
+	// Fixed length header (8 version, 80 patient, 80 recording, 8 date, 8 time, 8 header bytes, 44, 8 records, 8 duration, 4 ns):
+	memcpy( &acHeader[0], "0", 1 );
+	memcpy( &acHeader[8], "X X X X", 7 );
+	memcpy( &acHeader[88], "Startdate X X X X", 17 );
+	memcpy( &acHeader[168], "01.01.14", 8 );
+	memcpy( &acHeader[176], "00.00.00", 8 );
+	sprintf( szField, "%-8d", iHeaderBytes );						memcpy( &acHeader[184], szField, 8 );
+	sprintf( szField, "%-8lld", llNumberRecords );					memcpy( &acHeader[236], szField, 8 );
+	memcpy( &acHeader[244], "1", 1 );
+	sprintf( szField, "%-4d", iNumberSignals );						memcpy( &acHeader[252], szField, 4 );
+
+	// Variable length header, field by field for all signals:
+	char *pcField = &acHeader[256];
+	const int aiFieldSizes[] = { 16, 80, 8, 8, 8, 8, 8, 80, 8, 32 };
+
+	for( int iField = 0; iField < 10; iField++ )
+	{
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			switch( iField )
+			{
+				case 0: sprintf( szField, "EEG %-12d", iThisSignal ); break;
+				case 2: sprintf( szField, "%-8s", "uV" ); break;
+				case 3: sprintf( szField, "%-8d", -3200 ); break;
+				case 4: sprintf( szField, "%-8d", 3200 ); break;
+				case 5: sprintf( szField, "%-8d", -32768 ); break;
+				case 6: sprintf( szField, "%-8d", 32767 ); break;
+				case 8: sprintf( szField, "%-8d", iSamplesPerSignal ); break;
+				default: szField[0] = '\0'; break;
+			}
+
+			memcpy( pcField, szField, strlen( szField ) );
+			pcField += aiFieldSizes[iField];
+		}
+	}
+
+	// Marker records: the first records wholly past 2 GiB and 4 GiB (where 32-bit offsets wrap) and the last one:
+	const long long allLimits[] = { 1LL << 31, 1LL << 32 };
+
+	pallMarkers->clear();
+
+	for( int iLimit = 0; iLimit < 2; iLimit++ )
+	{
+		long long llRecord = (allLimits[iLimit] - iHeaderBytes) / llRecordSize + 1;
+
+		if( llRecord < llNumberRecords - 1 )
+		{
+			pallMarkers->push_back( llRecord );
+		}
+	}
+
+	pallMarkers->push_back( llNumberRecords - 1 );
+
+	ofstream oFile( pszFile, ios::out | ios::binary | ios::trunc );
+	vector<short int> asRecord( (size_t)(llRecordSize / 2) );
+
+	oFile.write( &acHeader[0], iHeaderBytes );
+
+	for( size_t iMarker = 0; iMarker < pallMarkers->size(); iMarker++ )
+	{
+		long long llRecord = (*pallMarkers)[iMarker];
+
+		for( size_t iIndex = 0; iIndex < asRecord.size(); iIndex++ )
+		{
+			asRecord[iIndex] = sMarkerValue( llRecord, (int)iIndex );		// little-endian host assumed, as in the reader
+		}
+
+		oFile.seekp( (streamoff)(iHeaderBytes + llRecord * llRecordSize) );
+		oFile.write( (const char *)&asRecord[0], llRecordSize );
+	}
+
+	oFile.close();
+
+	*pllNumberRecords = llNumberRecords;
+	return( !oFile.fail() );
+}
+
+/*!
+*   \brief Time random single sample reads and record reads over the first and last GiB.
+*   \return Number of reads that failed or returned a wrong value.
+*/
+
+static int iTimeRegion( CReadEDF *poEDF, const char *pszName, long long llFirstRecord, long long llRegionRecords, int iSamplesPerSignal,
+	const vector<long long> &allMarkers )
+{
+	const int iIterations = 20000;
+	mt19937_64 oRandom( 2014 );
+	vector<short int> asRecord( poEDF->iGetSamplesPerRecord() );
+	int iNumberSignals = 0;
+	int iFailures = 0;
+
+	poEDF->eGetNumberSignals( &iNumberSignals );
+
+	chrono::steady_clock::time_point oStart = chrono::steady_clock::now();
+
+	for( int i = 0; i < iIterations; i++ )
+	{
+		long long llRecord = llFirstRecord + (long long)(oRandom() % llRegionRecords);
+		short int iSignal = (short int)(oRandom() % iNumberSignals);
+		int iSample = (int)(oRandom() % iSamplesPerSignal);
+		long long llSample = llRecord * iSamplesPerSignal + iSample;
+		int iSampleValue = -1;
+
+		if( poEDF->eGetSample( iSignal, llSample, &iSampleValue ) != CReadEDF::EDF_SUCCESS
+			|| iSampleValue != iExpectedSample( allMarkers, llRecord, iSignal, iSample, iSamplesPerSignal ) )
+		{
+			iFailures++;
+		}
+	}
+
+	chrono::steady_clock::time_point oMiddle = chrono::steady_clock::now();
+
+	for( int i = 0; i < iIterations; i++ )
+	{
+		long long llRecord = llFirstRecord + (long long)(oRandom() % llRegionRecords);
+
+		if( poEDF->eReadRecords( llRecord, 1, &asRecord[0] ) != CReadEDF::EDF_SUCCESS
+			|| asRecord[0] != iExpectedSample( allMarkers, llRecord, 0, 0, iSamplesPerSignal ) )
+		{
+			iFailures++;
+		}
+	}
+
+	chrono::steady_clock::time_point oEnd = chrono::steady_clock::now();
+
+	double dSampleMicros = chrono::duration<double, micro>( oMiddle - oStart ).count() / iIterations;
+	double dRecordMicros = chrono::duration<double, micro>( oEnd - oMiddle ).count() / iIterations;
+
+	printf( "%-6s records %10lld..%-10lld  eGetSample %8.3f us  eReadRecords %8.3f us  failures %d\n",
+		pszName, llFirstRecord, llFirstRecord + llRegionRecords - 1, dSampleMicros, dRecordMicros, iFailures );
+
+	return( iFailures );
+}
+
+/*!
+*   \brief Read every marker record back with eReadRecords() and a sample of each signal with eGetSample().
+*   \return Number of reads that failed or returned a wrong value.
+*/
+
+static int iCheckMarkers( CReadEDF *poEDF, const vector<long long> &allMarkers, int iSamplesPerSignal )
+{
+	vector<short int> asRecord( poEDF->iGetSamplesPerRecord() );
+	int iNumberSignals = 0;
+	int iFailures = 0;
+
+	poEDF->eGetNumberSignals( &iNumberSignals );
+
+	for( size_t iMarker = 0; iMarker < allMarkers.size(); iMarker++ )
+	{
+		long long llRecord = allMarkers[iMarker];
+		int iRecordFailures = 0;
+
+		if( poEDF->eReadRecords( llRecord, 1, &asRecord[0] ) != CReadEDF::EDF_SUCCESS )
+		{
+			iRecordFailures++;
+		}
+		else
+		{
+			for( size_t iIndex = 0; iIndex < asRecord.size(); iIndex++ )
+			{
+				iRecordFailures += (asRecord[iIndex] != sMarkerValue( llRecord, (int)iIndex )) ? 1 : 0;
+			}
+		}
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			int iSample = (iThisSignal * 37) % iSamplesPerSignal;
+			int iSampleValue = -1;
+
+			if( poEDF->eGetSample( (short int)iThisSignal, llRecord * iSamplesPerSignal + iSample, &iSampleValue ) != CReadEDF::EDF_SUCCESS
+				|| iSampleValue != sMarkerValue( llRecord, iThisSignal * iSamplesPerSignal + iSample ) )
+			{
+				iRecordFailures++;
+			}
+		}
+
+		printf( "marker record %-10lld (byte offset %14lld)  failures %d\n", llRecord,
+			(long long)poEDF->iGetHeaderBytes() + llRecord * poEDF->iGetRecordSize(), iRecordFailures );
+		iFailures += iRecordFailures;
+	}
+
+	return( iFailures );
+}
+
+int main( int argc, char* argv[] )
+{
+	int iRetVal = EXIT_FAILURE;			// be pessimistic
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( argc < 2 )
+		{
+			cout << "Usage: bench-edf <scratch file> [size in GiB, default 20]" << endl;
+			break;
+		}
+
+		const int iNumberSignals = 256;			// high-density EEG
+		const int iSamplesPerSignal = 256;		// 256 Hz, 1 s records
+		long long llGiB = (argc > 2) ? atoll( argv[2] ) : 20;
+		long long llNumberRecords = 0;
+		vector<long long> allMarkers;
+
+		if( !bWriteSparseEdf( argv[1], llGiB << 30, iNumberSignals, iSamplesPerSignal, &llNumberRecords, &allMarkers ) )
+		{
+			cout << "Could not write the scratch file: " << argv[1] << endl;
+			break;
+		}
+
+		CReadEDF oEDF( argv[1] );
+
+		if( oEDF.bReadyStatus() )
+		{
+			long long llRegionRecords = min( llNumberRecords, (1LL << 30) / oEDF.iGetRecordSize() );
+
+			printf( "%lld GiB, %d signals, %lld records of %d bytes\n", llGiB, iNumberSignals, llNumberRecords, oEDF.iGetRecordSize() );
+			int iFailures = iCheckMarkers( &oEDF, allMarkers, iSamplesPerSignal );
+
+			iFailures += iTimeRegion( &oEDF, "start", 0, llRegionRecords, iSamplesPerSignal, allMarkers );
+			iFailures += iTimeRegion( &oEDF, "end", llNumberRecords - llRegionRecords, llRegionRecords, iSamplesPerSignal, allMarkers );
+
+			if( iFailures == 0 )
+			{
+				iRetVal = EXIT_SUCCESS;
+			}
+			else
+			{
+				cout << iFailures << " reads failed or returned wrong values" << endl;
+			}
+		}
+
+		remove( argv[1] );
+		break;
+
+	} // for()
+
+	return( iRetVal );
+
+} // main()
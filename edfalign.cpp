@@ -0,0 +1,532 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for a time-aligned virtual recording over several EDF files.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include "edfalign.h"
+
+using namespace std;
+
+/*!
+*   \brief Constructor for the CAlignEDF class: open every file and place it on the shared clock.
+*   \param apszInputFiles - input files (EDF or EDF+)
+*   \param iNumberFiles - number of input files
+*   \param dSampleRate - shared sample rate in Hz (0 = the highest native sample rate)
+*   \param iNumberThreads - files opened and read concurrently (0 = one per hardware thread)
+*/
+
+CAlignEDF::CAlignEDF( char **apszInputFiles, int iNumberFiles, double dSampleRate, int iNumberThreads )
+{
+	m_eStaticStatus = CReadEDF::EDF_VOID;
+	m_dSampleRate = dSampleRate;
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_llOriginSeconds = 0;
+	m_dOriginFraction = 0.0;
+	m_asFiles.resize( max( iNumberFiles, 0 ) );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( iNumberFiles <= 0 || dSampleRate < 0.0 )
+		{
+			m_eStaticStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		// Opening may scan a whole EDF+D file, so the files are opened in parallel:
+		vRunParallel( iNumberFiles, [&]( int iFile ) { vOpenFile( m_asFiles[iFile], apszInputFiles[iFile] ); } );
+
+		m_eStaticStatus = CReadEDF::EDF_SUCCESS;
+
+		for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+		{
+			if( m_asFiles[iFile].eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				m_eStaticStatus = m_asFiles[iFile].eEdfStatus;
+				break;
+			}
+		}
+
+		if( m_eStaticStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		// Time 0 is the earliest start; starts are kept relative to the earliest header second to keep double precision:
+		long long llFirstSeconds = m_asFiles[0].llHeaderSeconds;
+
+		for( int iFile = 1; iFile < iNumberFiles; iFile++ )
+		{
+			llFirstSeconds = min( llFirstSeconds, m_asFiles[iFile].llHeaderSeconds );
+		}
+
+		double dOrigin = numeric_limits<double>::max();
+
+		for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+		{
+			file_S &sFile = m_asFiles[iFile];
+
+			sFile.dOffset = (double)(sFile.llHeaderSeconds - llFirstSeconds) + sFile.dFirstOnset;
+			dOrigin = min( dOrigin, sFile.dOffset );
+		}
+
+		for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+		{
+			m_asFiles[iFile].dOffset -= dOrigin;
+		}
+
+		m_llOriginSeconds = llFirstSeconds + (long long)floor( dOrigin );
+		m_dOriginFraction = dOrigin - floor( dOrigin );
+
+		// Channels: every ordinary signal, in file order:
+		double dHighestRate = 0.0;
+
+		for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+		{
+			CReadEDF *poEDF = m_asFiles[iFile].poEDF;
+			int iNumberSignals = 0;
+
+			poEDF->eGetNumberSignals( &iNumberSignals );
+
+			for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+			{
+				if( iThisSignal == m_asFiles[iFile].iAnnotationSignal )
+				{
+					continue;
+				}
+
+				channel_S sChannel;
+
+				sChannel.iFile = iFile;
+				sChannel.iSignal = iThisSignal;
+				sChannel.iNumberSamples = poEDF->iGetNumberSamples( iThisSignal );
+				sChannel.iSignalOffset = poEDF->iGetSignalOffset( iThisSignal );
+				poEDF->eGetCalibration( iThisSignal, &sChannel.dGain, &sChannel.dOffset );
+				sChannel.sLabel = poEDF->pszGetSignalLabel( iThisSignal );
+
+				size_t iEnd = sChannel.sLabel.find_last_not_of( ' ' );
+				sChannel.sLabel.erase( (iEnd == string::npos) ? 0 : iEnd + 1 );
+
+				dHighestRate = max( dHighestRate, sChannel.iNumberSamples / m_asFiles[iFile].dRecordDuration );
+				m_asChannels.push_back( sChannel );
+			}
+		}
+
+		if( m_dSampleRate == 0.0 )
+		{
+			m_dSampleRate = dHighestRate;
+		}
+
+		if( m_asChannels.empty() || m_dSampleRate <= 0.0 )
+		{
+			m_eStaticStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;
+		}
+	} //for()
+}
+
+/*!
+*   \brief Destructor for the CAlignEDF class.
+*/
+
+CAlignEDF::~CAlignEDF( void )
+{
+	for( size_t iFile = 0; iFile < m_asFiles.size(); iFile++ )
+	{
+		delete m_asFiles[iFile].poEDF;
+	}
+}
+
+/*!
+*   \brief Open one file and find its start: header start, EDF+ first record onset and (EDF+D) record onsets.
+*/
+
+void CAlignEDF::vOpenFile( file_S &sFile, char *pszInputFile )
+{
+	sFile.poEDF = new CReadEDF( pszInputFile, &sFile.eEdfStatus );
+	sFile.llHeaderSeconds = 0;
+	sFile.dFirstOnset = 0.0;
+	sFile.dOffset = 0.0;
+	sFile.dRecordDuration = 0.0;
+	sFile.llNumberRecords = 0;
+	sFile.iAnnotationSignal = -1;
+
+	CReadEDF *poEDF = sFile.poEDF;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( !poEDF->bReadyStatus( &sFile.eEdfStatus ) )
+		{
+			break;
+		}
+
+		sFile.eEdfStatus = poEDF->eGetStartSeconds( &sFile.llHeaderSeconds );
+		if( sFile.eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		sFile.dRecordDuration = poEDF->dGetRecordDuration();
+		if( sFile.dRecordDuration <= 0.0 )
+		{
+			sFile.eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		poEDF->eGetNumberRecords( &sFile.llNumberRecords );
+
+		// Unknown number of records (-1): whatever the file holds:
+		if( sFile.llNumberRecords < 0 )
+		{
+			struct stat sStat;
+
+			sFile.llNumberRecords = (stat( pszInputFile, &sStat ) == 0 && poEDF->iGetRecordSize() > 0)
+				? max( 0LL, ((long long)sStat.st_size - poEDF->iGetHeaderBytes()) / poEDF->iGetRecordSize() ) : 0;
+		}
+
+		bool bDiscontinuous = false;
+
+		if( !poEDF->bIsEdfPlus( &bDiscontinuous ) || sFile.llNumberRecords == 0 )
+		{
+			break;
+		}
+
+		sFile.iAnnotationSignal = poEDF->iFindSignal( "EDF Annotations" );
+		if( sFile.iAnnotationSignal < 0 )
+		{
+			break;
+		}
+
+		// The first TAL of every data record holds the record's onset after the header start:
+		int iSamplesPerRecord = poEDF->iGetSamplesPerRecord();
+		long long llScanRecords = bDiscontinuous ? sFile.llNumberRecords : 1;
+
+		sFile.asRecords.resize( (size_t)iSamplesPerRecord * SCAN_RECORDS );
+
+		for( long long llFirst = 0; llFirst < llScanRecords && sFile.eEdfStatus == CReadEDF::EDF_SUCCESS; llFirst += SCAN_RECORDS )
+		{
+			long long llCount = min( (long long)SCAN_RECORDS, llScanRecords - llFirst );
+
+			sFile.eEdfStatus = poEDF->eReadRecords( llFirst, llCount, &sFile.asRecords[0] );
+
+			for( long long llRecord = 0; llRecord < llCount && sFile.eEdfStatus == CReadEDF::EDF_SUCCESS; llRecord++ )
+			{
+				double dOnset = 0.0;
+
+				if( !bReadOnset( sFile, &sFile.asRecords[llRecord * iSamplesPerRecord], &dOnset ) )
+				{
+					sFile.eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+				}
+				else if( llFirst + llRecord == 0 )
+				{
+					sFile.dFirstOnset = dOnset;
+				}
+
+				if( bDiscontinuous )
+				{
+					sFile.adRecordOnsets.push_back( dOnset - sFile.dFirstOnset );
+				}
+			}
+		}
+
+		// EDF+D records must follow each other without overlap:
+		for( size_t iRecord = 1; iRecord < sFile.adRecordOnsets.size() && sFile.eEdfStatus == CReadEDF::EDF_SUCCESS; iRecord++ )
+		{
+			if( sFile.adRecordOnsets[iRecord] < sFile.adRecordOnsets[iRecord - 1] + sFile.dRecordDuration - 1e-6 )
+			{
+				sFile.eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			}
+		}
+	} //for()
+
+	vector<short int>().swap( sFile.asRecords );
+}
+
+/*!
+*   \brief Parse the onset of the time keeping TAL ("+Onset\x14\x14") at the start of a record's annotation signal.
+*   \return true if pdOnset was loaded.
+*/
+
+bool CAlignEDF::bReadOnset( file_S &sFile, const short int *psRecord, double *pdOnset )
+{
+	CReadEDF *poEDF = sFile.poEDF;
+	const char *pacAnnotations = (const char *)(psRecord + poEDF->iGetSignalOffset( sFile.iAnnotationSignal ));
+	int iBytes = poEDF->iGetNumberSamples( sFile.iAnnotationSignal ) * (int)sizeof(short int);
+	char szOnset[32];
+	int iLength = 0;
+
+	while( iLength < iBytes && iLength < (int)sizeof(szOnset) - 1 && pacAnnotations[iLength] != '\x14' && pacAnnotations[iLength] != '\x15' )
+	{
+		szOnset[iLength] = pacAnnotations[iLength];
+		iLength++;
+	}
+
+	szOnset[iLength] = '\0';
+
+	if( iLength < 2 || (szOnset[0] != '+' && szOnset[0] != '-') || iLength >= iBytes || pacAnnotations[iLength] != '\x14' )
+	{
+		return( false );
+	}
+
+	char *pszEnd = NULL;
+
+	*pdOnset = strtod( szOnset, &pszEnd );
+	return( *pszEnd == '\0' );
+}
+
+/*!
+*   \brief Return the data record covering a time in seconds from the file's start (may be out of range; an EDF+D gap gives the record before it).
+*/
+
+long long CAlignEDF::llRecordAt( const file_S &sFile, double dLocalSeconds )
+{
+	if( sFile.adRecordOnsets.empty() )
+	{
+		return( (long long)floor( dLocalSeconds / sFile.dRecordDuration ) );
+	}
+
+	return( (long long)(upper_bound( sFile.adRecordOnsets.begin(), sFile.adRecordOnsets.end(), dLocalSeconds ) - sFile.adRecordOnsets.begin()) - 1 );
+}
+
+double CAlignEDF::dRecordOnset( const file_S &sFile, long long llRecord )
+{
+	return( sFile.adRecordOnsets.empty() ? llRecord * sFile.dRecordDuration : sFile.adRecordOnsets[llRecord] );
+}
+
+/*!
+*   \brief Read a window of all channels on the shared clock.
+*   \param dStartSeconds - window start in seconds from time 0 of the virtual recording
+*   \param iNumberSamples - samples per channel, at dGetSampleRate()
+*   \param pfSamples - loaded with [channel * iNumberSamples + sample]; NaN where a file has no data
+*   \return Status of operation (the first file that failed; its channels are NaN).
+*/
+
+CReadEDF::edfStatus_E CAlignEDF::eReadSamples( double dStartSeconds, int iNumberSamples, float *pfSamples )
+{
+	if( !bReadyStatus() )
+	{
+		return( m_eStaticStatus );
+	}
+
+	if( iNumberSamples <= 0 || pfSamples == NULL )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	vector<CReadEDF::edfStatus_E> aeStatus( m_asFiles.size(), CReadEDF::EDF_SUCCESS );
+
+	vRunParallel( (int)m_asFiles.size(), [&]( int iFile ) { aeStatus[iFile] = eReadFile( iFile, dStartSeconds, iNumberSamples, pfSamples ); } );
+
+	for( size_t iFile = 0; iFile < aeStatus.size(); iFile++ )
+	{
+		if( aeStatus[iFile] != CReadEDF::EDF_SUCCESS )
+		{
+			return( aeStatus[iFile] );
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Read the records of one file that cover a window and resample its channels onto the shared clock.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CAlignEDF::eReadFile( int iFile, double dStartSeconds, int iNumberSamples, float *pfSamples )
+{
+	file_S &sFile = m_asFiles[iFile];
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_SUCCESS;
+	const float fNaN = numeric_limits<float>::quiet_NaN();
+	double dLocalFirst = dStartSeconds - sFile.dOffset;
+	double dLocalLast = dLocalFirst + (iNumberSamples - 1) / m_dSampleRate;
+	double dEnd = dRecordOnset( sFile, sFile.llNumberRecords - 1 ) + sFile.dRecordDuration;
+	long long llFirstRecord = max( 0LL, llRecordAt( sFile, dLocalFirst ) );
+	long long llLastRecord = min( sFile.llNumberRecords - 1, llRecordAt( sFile, dLocalLast ) + 1 );	// + 1: interpolation across the record boundary
+	int iSamplesPerRecord = sFile.poEDF->iGetSamplesPerRecord();
+	bool bCovered = (sFile.llNumberRecords > 0 && dLocalLast >= 0.0 && dLocalFirst < dEnd && llFirstRecord <= llLastRecord);
+
+	if( bCovered )
+	{
+		sFile.asRecords.resize( (size_t)(llLastRecord - llFirstRecord + 1) * iSamplesPerRecord );
+		eEdfStatus = sFile.poEDF->eReadRecords( llFirstRecord, llLastRecord - llFirstRecord + 1, &sFile.asRecords[0] );
+	}
+
+	for( size_t iChannel = 0; iChannel < m_asChannels.size(); iChannel++ )
+	{
+		const channel_S &sChannel = m_asChannels[iChannel];
+		float *pfOut = pfSamples + iChannel * (size_t)iNumberSamples;
+
+		if( sChannel.iFile != iFile )
+		{
+			continue;
+		}
+
+		if( !bCovered || eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			fill( pfOut, pfOut + iNumberSamples, fNaN );
+			continue;
+		}
+
+		double dNativeRate = sChannel.iNumberSamples / sFile.dRecordDuration;
+
+		for( int iSample = 0; iSample < iNumberSamples; iSample++ )
+		{
+			double dLocal = dLocalFirst + iSample / m_dSampleRate;
+			long long llRecord = llRecordAt( sFile, dLocal );
+
+			pfOut[iSample] = fNaN;
+
+			if( llRecord < llFirstRecord || llRecord > llLastRecord )
+			{
+				continue;
+			}
+
+			double dRecordStart = dRecordOnset( sFile, llRecord );
+
+			// Inside an EDF+D gap:
+			if( dLocal >= dRecordStart + sFile.dRecordDuration )
+			{
+				continue;
+			}
+
+			double dPosition = (dLocal - dRecordStart) * dNativeRate;
+			int iIndex = min( (int)dPosition, sChannel.iNumberSamples - 1 );
+			double dFraction = dPosition - iIndex;
+			const short int *psRecord = &sFile.asRecords[(size_t)(llRecord - llFirstRecord) * iSamplesPerRecord + sChannel.iSignalOffset];
+			double dValue = psRecord[iIndex];
+			double dNext = dValue;
+
+			if( iIndex + 1 < sChannel.iNumberSamples )
+			{
+				dNext = psRecord[iIndex + 1];
+			}
+			else if( llRecord < llLastRecord && fabs( dRecordOnset( sFile, llRecord + 1 ) - dRecordStart - sFile.dRecordDuration ) < 1e-6 )
+			{
+				dNext = psRecord[iSamplesPerRecord];		// first sample of the next (contiguous) record
+			}
+
+			pfOut[iSample] = (float)(sChannel.dGain * (dValue + dFraction * (dNext - dValue)) + sChannel.dOffset);
+		}
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Run fnItem for items 0 .. iNumberItems - 1 on up to m_iNumberThreads threads (the calling thread included).
+*/
+
+void CAlignEDF::vRunParallel( int iNumberItems, const function<void ( int iItem )> &fnItem )
+{
+	atomic<int> iNextItem( 0 );
+	int iNumberThreads = max( 1, min( m_iNumberThreads, iNumberItems ) );
+	vector<thread> aoThreads;
+
+	auto fnWorker = [&]( void )
+	{
+		for( int iItem = iNextItem++; iItem < iNumberItems; iItem = iNextItem++ )
+		{
+			fnItem( iItem );
+		}
+	};
+
+	for( int iThread = 1; iThread < iNumberThreads; iThread++ )
+	{
+		aoThreads.push_back( thread( fnWorker ) );
+	}
+
+	fnWorker();
+
+	for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+	{
+		aoThreads[iThread].join();
+	}
+}
+
+/*!
+*   \brief Return the (trimmed) signal label of a channel, NULL if invalid.
+*/
+
+const char *CAlignEDF::pszGetChannelLabel( int iChannel )
+{
+	return( (iChannel >= 0 && iChannel < (int)m_asChannels.size()) ? m_asChannels[iChannel].sLabel.c_str() : NULL );
+}
+
+//! \brief Return the file index of a channel (-1 if invalid).
+int CAlignEDF::iGetChannelFile( int iChannel )
+{
+	return( (iChannel >= 0 && iChannel < (int)m_asChannels.size()) ? m_asChannels[iChannel].iFile : -1 );
+}
+
+//! \brief Return the signal number of a channel within its file (-1 if invalid).
+int CAlignEDF::iGetChannelSignal( int iChannel )
+{
+	return( (iChannel >= 0 && iChannel < (int)m_asChannels.size()) ? m_asChannels[iChannel].iSignal : -1 );
+}
+
+/*!
+*   \brief Return the start of a file in seconds after time 0 of the virtual recording (NaN if invalid).
+*/
+
+double CAlignEDF::dGetFileOffset( int iFile )
+{
+	return( (bReadyStatus() && iFile >= 0 && iFile < (int)m_asFiles.size()) ? m_asFiles[iFile].dOffset : numeric_limits<double>::quiet_NaN() );
+}
+
+/*!
+*   \brief Return the length of the virtual recording: time 0 to the end of the last file to end.
+*/
+
+double CAlignEDF::dGetDuration( void )
+{
+	double dDuration = 0.0;
+
+	for( size_t iFile = 0; bReadyStatus() && iFile < m_asFiles.size(); iFile++ )
+	{
+		const file_S &sFile = m_asFiles[iFile];
+
+		if( sFile.llNumberRecords > 0 )
+		{
+			dDuration = max( dDuration, sFile.dOffset + dRecordOnset( sFile, sFile.llNumberRecords - 1 ) + sFile.dRecordDuration );
+		}
+	}
+
+	return( dDuration );
+}
+
+/*!
+*   \brief Get time 0 of the virtual recording (the earliest file start).
+*   \param pllSeconds - loaded with whole seconds since 1970-01-01 00:00:00
+*   \param pdFraction - loaded with the fraction of a second if not null
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CAlignEDF::eGetStartSeconds( long long *pllSeconds, double *pdFraction )
+{
+	if( !bReadyStatus() )
+	{
+		return( m_eStaticStatus );
+	}
+
+	if( pllSeconds != NULL )
+	{
+		*pllSeconds = m_llOriginSeconds;
+	}
+
+	if( pdFraction != NULL )
+	{
+		*pdFraction = m_dOriginFraction;
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
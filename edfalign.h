@@ -0,0 +1,129 @@
+#ifndef EDFALIGN_H
+#define EDFALIGN_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for a time-aligned virtual recording over several EDF files.
+*/
+
+/*! \class CAlignEDF
+    \brief Presents several recordings (e.g. a PSG and a separate ECG or actigraphy file) as one recording on a shared clock.
+
+	Each file's start is taken from its header date and time (CReadEDF::eGetStartSeconds(), with
+	the EDF+ 4 digit year rules) plus, for EDF+ files, the sub-second onset of the time keeping
+	annotation of the first data record. The earliest start is time 0 of the virtual recording and
+	every file gets its offset from there. EDF+D files are scanned once when opened for the onset
+	of every data record, so their gaps are known.
+
+	The channels are all ordinary signals of all files, in file order ("EDF Annotations" signals
+	are left out). eReadSamples() reads a window at the shared sample rate: the files are read in
+	parallel (one reader per file), and each channel is calibrated and resampled onto the shared
+	clock with linear interpolation (no low-pass filter, as in CTensorEDF). Points a file does not
+	cover - before its start, after its end, or in an EDF+D gap - are NaN.
+
+	\code
+	char *apszFiles[] = { pszPsg, pszEcg };
+	CAlignEDF oAligned( apszFiles, 2, 256.0 );
+	vector<float> afWindow( oAligned.iGetNumberChannels() * 7680 );
+	oAligned.eReadSamples( 3600.0, 7680, &afWindow[0] );
+	\endcode
+
+	One eReadSamples() call at a time: the file readers are shared by all calls.
+*/
+
+class CAlignEDF
+{
+	public:
+
+	enum alignConstants_E
+	{
+		SCAN_RECORDS = 64,					///< data records per read while scanning EDF+D record onsets
+	};
+
+	CAlignEDF( char **apszInputFiles, int iNumberFiles, double dSampleRate = 0.0, int iNumberThreads = 0 );
+	~CAlignEDF( void );
+
+	//! \brief Return true if every file was opened and its start time is valid.
+	bool bReadyStatus( CReadEDF::edfStatus_E *peEdfStatus = NULL )
+	{
+		if( peEdfStatus != NULL )
+		{
+			*peEdfStatus = m_eStaticStatus;
+		}
+
+		return( m_eStaticStatus == CReadEDF::EDF_SUCCESS );
+	};
+
+	//! \brief Return the shared sample rate (the highest native rate if 0 was given).
+	double dGetSampleRate( void )
+	{
+		return( m_dSampleRate );
+	};
+
+	int iGetNumberChannels( void )
+	{
+		return( (int)m_asChannels.size() );
+	};
+
+	const char *pszGetChannelLabel( int iChannel );
+	int iGetChannelFile( int iChannel );
+	int iGetChannelSignal( int iChannel );
+
+	double dGetFileOffset( int iFile );
+	double dGetDuration( void );
+	CReadEDF::edfStatus_E eGetStartSeconds( long long *pllSeconds, double *pdFraction = NULL );
+
+	CReadEDF::edfStatus_E eReadSamples( double dStartSeconds, int iNumberSamples, float *pfSamples );
+
+	private:
+
+	//! \brief One input file and its place on the shared clock.
+	struct file_S
+	{
+		CReadEDF *poEDF;
+		CReadEDF::edfStatus_E eEdfStatus;
+		long long llHeaderSeconds;			///< header start, seconds since 1970
+		double dFirstOnset;					///< onset of the first data record after the header start (EDF+)
+		double dOffset;						///< start after time 0 of the virtual recording
+		double dRecordDuration;
+		long long llNumberRecords;
+		int iAnnotationSignal;				///< -1 if none
+		vector<double> adRecordOnsets;		///< EDF+D only: onset of every record after the first one's
+		vector<short int> asRecords;		///< read buffer
+	};
+
+	//! \brief One channel of the virtual recording.
+	struct channel_S
+	{
+		int iFile;
+		int iSignal;
+		int iNumberSamples;					///< samples per data record
+		int iSignalOffset;					///< sample offset within a data record
+		double dGain;
+		double dOffset;
+		string sLabel;
+	};
+
+	void vOpenFile( file_S &sFile, char *pszInputFile );
+	bool bReadOnset( file_S &sFile, const short int *psRecord, double *pdOnset );
+	long long llRecordAt( const file_S &sFile, double dLocalSeconds );
+	double dRecordOnset( const file_S &sFile, long long llRecord );
+	CReadEDF::edfStatus_E eReadFile( int iFile, double dStartSeconds, int iNumberSamples, float *pfSamples );
+	void vRunParallel( int iNumberItems, const function<void ( int iItem )> &fnItem );
+
+	vector<file_S> m_asFiles;
+	vector<channel_S> m_asChannels;
+	CReadEDF::edfStatus_E m_eStaticStatus;
+	double m_dSampleRate;
+	int m_iNumberThreads;
+	long long m_llOriginSeconds;			///< whole seconds of time 0 since 1970
+	double m_dOriginFraction;				///< fraction of a second of time 0
+}; //class CAlignEDF
+
+#endif // EDFALIGN_H
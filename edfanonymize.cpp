@@ -0,0 +1,437 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for header (and EDF+ annotation) de-identification of EDF files without copying data.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include "edfanonymize.h"
+#include "edfedit.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+using namespace std;
+
+/*!
+*   \brief Create pszOutputFile as a copy of pszInputFile, sharing extents (reflink) where the file system can.
+*   \return true if copied.
+*/
+
+bool CAnonymizeEDF::bCloneFile( const char *pszInputFile, const char *pszOutputFile )
+{
+	struct stat sStat;
+
+	if( stat( pszInputFile, &sStat ) != 0 )
+	{
+		return( false );
+	}
+
+#if defined(__linux__) && defined(FICLONE)
+	int iInput = open( pszInputFile, O_RDONLY );
+	int iOutput = open( pszOutputFile, O_WRONLY | O_CREAT | O_TRUNC, sStat.st_mode & 0777 );
+	bool bCloned = (iInput >= 0 && iOutput >= 0 && ioctl( iOutput, FICLONE, iInput ) == 0);
+
+	if( iInput >= 0 )
+	{
+		close( iInput );
+	}
+
+	if( iOutput >= 0 )
+	{
+		close( iOutput );
+	}
+
+	if( bCloned )
+	{
+		return( true );
+	}
+#endif
+
+	// No reflinks here: copy_file_range() / sendfile() / stream copy:
+	{
+		ofstream oOutput( pszOutputFile, ios::out | ios::binary | ios::trunc );
+
+		if( oOutput.fail() )
+		{
+			return( false );
+		}
+	}
+
+	return( CEditEDF::eCopyBytes( pszInputFile, 0, pszOutputFile, 0, (long long)sStat.st_size ) == CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Store a left-justified, space padded ASCII header field.
+*/
+
+void CAnonymizeEDF::vSetField( char *pacField, size_t iSize, const char *pszValue )
+{
+	size_t iLength = min( strlen( pszValue ), iSize );
+
+	memset( pacField, ' ', iSize );
+	memcpy( pacField, pszValue, iLength );
+}
+
+/*!
+*   \brief Rewrite the TALs of one annotation signal area: onsets and durations kept, texts replaced by "X"
+*	       unless kept; the area is re-packed and zero padded, so it never grows.
+*   \param acArea - annotation bytes of one data record (in/out)
+*   \param fnKeep - optional callback; texts it accepts are kept
+*   \param pbChanged - loaded with true if any byte changed
+*   \return false if the area is not valid TAL data (acArea is then unchanged).
+*/
+
+bool CAnonymizeEDF::bScrubAnnotations( vector<char> &acArea, const keepAnnotation_F &fnKeep, bool *pbChanged )
+{
+	size_t iSize = acArea.size();
+	size_t i = 0;
+	string sOut;
+
+	*pbChanged = false;
+
+	// TALs follow each other until the zero padding: "+Onset[\x15Duration]\x14[Text\x14]...\0"
+	while( i < iSize && acArea[i] != '\0' )
+	{
+		size_t iEnd = i;
+
+		while( iEnd < iSize && acArea[iEnd] != '\x14' )
+		{
+			iEnd++;
+		}
+
+		if( iEnd >= iSize || (acArea[i] != '+' && acArea[i] != '-') )
+		{
+			return( false );
+		}
+
+		sOut.append( &acArea[i], iEnd + 1 - i );		// onset, duration and the first \x14
+		i = iEnd + 1;
+
+		while( i < iSize && acArea[i] != '\0' )
+		{
+			iEnd = i;
+
+			while( iEnd < iSize && acArea[iEnd] != '\x14' )
+			{
+				iEnd++;
+			}
+
+			if( iEnd >= iSize )
+			{
+				return( false );
+			}
+
+			string sText( &acArea[i], iEnd - i );
+
+			// Empty texts (record time keeping) stay empty:
+			if( !sText.empty() && !(fnKeep && fnKeep( sText.c_str() )) )
+			{
+				sText = "X";
+			}
+
+			sOut += sText;
+			sOut += '\x14';
+			i = iEnd + 1;
+		}
+
+		if( i >= iSize )
+		{
+			return( false );		// TAL not terminated
+		}
+
+		sOut += '\0';
+		i++;
+	}
+
+	if( sOut.size() > iSize )
+	{
+		return( false );
+	}
+
+	sOut.resize( iSize, '\0' );
+
+	if( memcmp( sOut.data(), &acArea[0], iSize ) != 0 )
+	{
+		memcpy( &acArea[0], sOut.data(), iSize );
+		*pbChanged = true;
+	}
+
+	return( true );
+}
+
+/*!
+*   \brief Blank the identifying header fields (and annotation texts) of a file, writing only those bytes.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CAnonymizeEDF::ePatchFile( const char *pszFile, bool bScrubAnnotations, const keepAnnotation_F &fnKeep,
+	int iHeaderBytes, int iRecordSize, long long llNumberRecords, const vector<annotationRange_S> &asRanges )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	fstream oFile( pszFile, ios::in | ios::out | ios::binary );
+	CReadEDF::headerFixedLength_S sHeader;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( oFile.fail() )
+		{
+			break;
+		}
+
+		oFile.read( (char *)&sHeader, sizeof(sHeader) );
+		if( oFile.fail() )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		bool bEdfPlus = (memcmp( sHeader.acReserved44, "EDF+", 4 ) == 0);
+
+		vSetField( sHeader.acLocalPatientID, sizeof(sHeader.acLocalPatientID), bEdfPlus ? "X X X X" : "X" );
+		vSetField( sHeader.acLocalRecordingID, sizeof(sHeader.acLocalRecordingID), bEdfPlus ? "Startdate X X X X" : "X" );
+		vSetField( (char *)&sHeader.acStartDate, sizeof(sHeader.acStartDate), "01.01.85" );		// EDF+ "unknown date" (any year 1985 and later is valid)
+
+		oFile.seekp( 0 );
+		oFile.write( (const char *)&sHeader, sizeof(sHeader) );
+		if( oFile.fail() )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+		if( !bScrubAnnotations )
+		{
+			break;
+		}
+
+		vector<char> acArea;
+
+		for( long long llRecord = 0; llRecord < llNumberRecords && eEdfStatus == CReadEDF::EDF_SUCCESS; llRecord++ )
+		{
+			for( size_t iRange = 0; iRange < asRanges.size(); iRange++ )
+			{
+				streamoff llOffset = (streamoff)iHeaderBytes + (streamoff)llRecord * iRecordSize + asRanges[iRange].iOffset;
+				bool bChanged = false;
+
+				acArea.resize( asRanges[iRange].iBytes );
+				oFile.seekg( llOffset );
+				oFile.read( &acArea[0], acArea.size() );
+
+				if( oFile.fail() || !CAnonymizeEDF::bScrubAnnotations( acArea, fnKeep, &bChanged ) )
+				{
+					eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+					break;
+				}
+
+				if( bChanged )
+				{
+					oFile.seekp( llOffset );
+					oFile.write( &acArea[0], acArea.size() );
+				}
+			}
+		}
+
+		oFile.close();
+		if( oFile.fail() && eEdfStatus == CReadEDF::EDF_SUCCESS )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+		}
+	} //for()
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief De-identify one EDF file.
+*   \param pszInputFile - EDF or EDF+ file
+*   \param pszOutputFile - NULL to modify the input in place; otherwise the result file (may equal
+*	       the input), written as a patched clone and renamed into place
+*   \param iFlags - ANONYMIZE_HEADER, optionally | ANONYMIZE_ANNOTATIONS
+*   \param fnKeep - optional callback selecting annotation texts to keep
+*   \return Status of operation (on failure an output file is left untouched).
+*/
+
+CReadEDF::edfStatus_E CAnonymizeEDF::eAnonymize( char *pszInputFile, const char *pszOutputFile, unsigned int iFlags, keepAnnotation_F fnKeep )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	vector<annotationRange_S> asRanges;
+	long long llNumberRecords = 0;
+	int iHeaderBytes = 0;
+	int iRecordSize = 0;
+
+	// Use the reader only to validate the file and find the annotation signals; close it before writing:
+	{
+		CReadEDF oEDF( pszInputFile, &eEdfStatus );
+		int iNumberSignals = 0;
+
+		if( !oEDF.bReadyStatus( &eEdfStatus ) )
+		{
+			return( eEdfStatus );
+		}
+
+		oEDF.eGetNumberSignals( &iNumberSignals );
+		oEDF.eGetNumberRecords( &llNumberRecords );
+		iHeaderBytes = oEDF.iGetHeaderBytes();
+		iRecordSize = oEDF.iGetRecordSize();
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			const char *pszLabel = oEDF.pszGetSignalLabel( iThisSignal );
+
+			if( strncmp( pszLabel, "EDF Annotations", 15 ) == 0 )
+			{
+				annotationRange_S sRange;
+
+				sRange.iOffset = oEDF.iGetSignalOffset( iThisSignal ) * (int)sizeof(short int);
+				sRange.iBytes = oEDF.iGetNumberSamples( iThisSignal ) * (int)sizeof(short int);
+				asRanges.push_back( sRange );
+			}
+		}
+	}
+
+	// Unknown number of records (-1): whatever the file holds:
+	if( llNumberRecords < 0 && iRecordSize > 0 )
+	{
+		struct stat sStat;
+
+		llNumberRecords = (stat( pszInputFile, &sStat ) == 0) ? max( 0LL, ((long long)sStat.st_size - iHeaderBytes) / iRecordSize ) : 0;
+	}
+
+	bool bScrub = (iFlags & ANONYMIZE_ANNOTATIONS) != 0;
+
+	if( pszOutputFile == NULL )
+	{
+		return( ePatchFile( pszInputFile, bScrub, fnKeep, iHeaderBytes, iRecordSize, llNumberRecords, asRanges ) );
+	}
+
+	// Patch a clone in the output directory, then rename it over the output (atomic on POSIX):
+	string sTemporaryFile = string( pszOutputFile ) + ".anonymize.tmp";
+
+	if( !bCloneFile( pszInputFile, sTemporaryFile.c_str() ) )
+	{
+		remove( sTemporaryFile.c_str() );
+		return( CReadEDF::EDF_FILE_OPEN_ERROR );
+	}
+
+	eEdfStatus = ePatchFile( sTemporaryFile.c_str(), bScrub, fnKeep, iHeaderBytes, iRecordSize, llNumberRecords, asRanges );
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS && rename( sTemporaryFile.c_str(), pszOutputFile ) != 0 )
+	{
+		eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	}
+
+	if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		remove( sTemporaryFile.c_str() );
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief De-identify many files concurrently.
+*   \param apszInputFiles - input files
+*   \param iNumberFiles - number of input files
+*   \param pszOutputDirectory - NULL to modify every input in place; otherwise results are written
+*	       there under the input file names (atomically, see eAnonymize())
+*	\note Files that would share an output (the same name from different directories, or the same
+*	       input twice in place) are all left untouched with EDF_INVALID_PARAMETER.
+*   \param iFlags - ANONYMIZE_HEADER, optionally | ANONYMIZE_ANNOTATIONS
+*   \param paeStatus - loaded with the status of every file if not null
+*   \param iNumberThreads - concurrent files (0 = four per hardware thread, the work is mostly waiting on I/O)
+*   \param fnKeep - optional callback selecting annotation texts to keep (called from several threads)
+*   \return Number of files de-identified successfully.
+*/
+
+int CAnonymizeEDF::iAnonymizeBatch( char **apszInputFiles, int iNumberFiles, const char *pszOutputDirectory, unsigned int iFlags,
+	vector<CReadEDF::edfStatus_E> *paeStatus, int iNumberThreads, keepAnnotation_F fnKeep )
+{
+	vector<CReadEDF::edfStatus_E> aeStatus( max( iNumberFiles, 0 ), CReadEDF::EDF_VOID );
+	atomic<int> iNextFile( 0 );
+	atomic<int> iSucceeded( 0 );
+
+	vector<string> asOutputFiles( aeStatus.size() );
+	map<string, int> aiOutputUses;
+
+	// Two tasks writing one output would race on its temporary file, so both are refused up front:
+	for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+	{
+		string sInput( apszInputFiles[iFile] );
+
+		if( pszOutputDirectory != NULL )
+		{
+			size_t iSlash = sInput.find_last_of( "/\\" );
+
+			asOutputFiles[iFile] = string( pszOutputDirectory ) + "/" + ((iSlash == string::npos) ? sInput : sInput.substr( iSlash + 1 ));
+		}
+
+		aiOutputUses[(pszOutputDirectory != NULL) ? asOutputFiles[iFile] : sInput]++;
+	}
+
+	for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+	{
+		if( aiOutputUses[(pszOutputDirectory != NULL) ? asOutputFiles[iFile] : string( apszInputFiles[iFile] )] > 1 )
+		{
+			aeStatus[iFile] = CReadEDF::EDF_INVALID_PARAMETER;
+		}
+	}
+
+	iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : 4 * (int)thread::hardware_concurrency();
+	iNumberThreads = max( 1, min( iNumberThreads, iNumberFiles ) );
+
+	auto fnWorker = [&]( void )
+	{
+		for( int iFile = iNextFile++; iFile < iNumberFiles; iFile = iNextFile++ )
+		{
+			if( aeStatus[iFile] != CReadEDF::EDF_VOID )
+			{
+				continue;
+			}
+
+			const string &sOutputFile = asOutputFiles[iFile];
+
+			aeStatus[iFile] = eAnonymize( apszInputFiles[iFile], (pszOutputDirectory != NULL) ? sOutputFile.c_str() : NULL, iFlags, fnKeep );
+
+			if( aeStatus[iFile] == CReadEDF::EDF_SUCCESS )
+			{
+				iSucceeded++;
+			}
+		}
+	};
+
+	vector<thread> aoThreads;
+
+	for( int iThread = 1; iThread < iNumberThreads; iThread++ )
+	{
+		aoThreads.push_back( thread( fnWorker ) );
+	}
+
+	fnWorker();
+
+	for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+	{
+		aoThreads[iThread].join();
+	}
+
+	if( paeStatus != NULL )
+	{
+		paeStatus->swap( aeStatus );
+	}
+
+	return( iSucceeded );
+}
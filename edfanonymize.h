@@ -0,0 +1,68 @@
+#ifndef EDFANONYMIZE_H
+#define EDFANONYMIZE_H
+
+#include <functional>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for header (and EDF+ annotation) de-identification of EDF files without copying data.
+*/
+
+/*! \class CAnonymizeEDF
+    \brief Blanks the patient, recording and start date fields of EDF files, rewriting only the bytes involved.
+
+	The 256 byte fixed header is read into CReadEDF::headerFixedLength_S, the identifying fields
+	are overwritten (EDF+ files keep the structure the EDF+ spec asks for: "X X X X",
+	"Startdate X X X X", start date 01.01.85) and it is written back; the start time and all
+	other fields are unchanged. With ANONYMIZE_ANNOTATIONS the "EDF Annotations" signal bytes of
+	every data record are also rewritten: onsets and durations stay, every annotation text becomes
+	"X" unless the keep callback accepts it (e.g. sleep stages). Other signals are never read.
+
+	Without an output file the input is modified in place (fast, but not atomic: a crash part way
+	through annotation scrubbing leaves a partly scrubbed file). With an output file - which may be
+	the input file itself - the input is cloned next to the output (a reflink on Btrfs/XFS, so no
+	data is copied there; a kernel side copy elsewhere), the clone is patched and then renamed over
+	the output, so readers see either the old or the finished file.
+
+	iAnonymizeBatch() runs many files concurrently on a pool of threads (the work is I/O bound).
+*/
+
+class CAnonymizeEDF
+{
+	public:
+
+	enum anonymizeFlags_E
+	{
+		ANONYMIZE_HEADER = 0,				///< patient, recording and start date only
+		ANONYMIZE_ANNOTATIONS = 1,			///< also scrub EDF+ annotation texts
+	};
+
+	//! \brief Return true to keep an annotation text verbatim.
+	typedef function<bool ( const char *pszText )> keepAnnotation_F;
+
+	static CReadEDF::edfStatus_E eAnonymize( char *pszInputFile, const char *pszOutputFile = NULL, unsigned int iFlags = ANONYMIZE_HEADER,
+		keepAnnotation_F fnKeep = keepAnnotation_F() );
+
+	static int iAnonymizeBatch( char **apszInputFiles, int iNumberFiles, const char *pszOutputDirectory, unsigned int iFlags,
+		vector<CReadEDF::edfStatus_E> *paeStatus = NULL, int iNumberThreads = 0, keepAnnotation_F fnKeep = keepAnnotation_F() );
+
+	private:
+
+	//! \brief Byte range of an annotation signal within a data record.
+	struct annotationRange_S
+	{
+		int iOffset;
+		int iBytes;
+	};
+
+	static bool bCloneFile( const char *pszInputFile, const char *pszOutputFile );
+	static void vSetField( char *pacField, size_t iSize, const char *pszValue );
+	static bool bScrubAnnotations( vector<char> &acArea, const keepAnnotation_F &fnKeep, bool *pbChanged );
+	static CReadEDF::edfStatus_E ePatchFile( const char *pszFile, bool bScrubAnnotations, const keepAnnotation_F &fnKeep,
+		int iHeaderBytes, int iRecordSize, long long llNumberRecords, const vector<annotationRange_S> &asRanges );
+}; //class CAnonymizeEDF
+
+#endif // EDFANONYMIZE_H
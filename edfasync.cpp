@@ -0,0 +1,342 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementations for the C++20 coroutine (awaitable) EDF read API.
+*/
+
+#include <errno.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include "edfasync.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*!
+*   \brief Constructor - start the I/O threads.
+*   \param iNumberIoThreads - dedicated I/O threads
+*   \param bResumeOnIoThread - resume coroutines on the I/O thread instead of in iPollCompletions()
+*/
+
+CIoEngineEDF::CIoEngineEDF( int iNumberIoThreads, bool bResumeOnIoThread )
+{
+	m_bResumeOnIoThread = bResumeOnIoThread;
+	m_bStopping = false;
+	m_iPending = 0;
+
+	for( int iThread = 0; iThread < max( iNumberIoThreads, 1 ); iThread++ )
+	{
+		m_aoIoThreads.push_back( thread( &CIoEngineEDF::vIoThread, this ) );
+	}
+}
+
+/*!
+*   \brief Destructor - finish the queued requests and stop the I/O threads.
+*	\note Completed coroutines that were never polled are not resumed.
+*/
+
+CIoEngineEDF::~CIoEngineEDF( void )
+{
+	{
+		lock_guard<mutex> oLock( m_oMutex );
+		m_bStopping = true;
+	}
+
+	m_oRequestReady.notify_all();
+
+	for( size_t iThread = 0; iThread < m_aoIoThreads.size(); iThread++ )
+	{
+		m_aoIoThreads[iThread].join();
+	}
+}
+
+/*!
+*   \brief Queue blocking work for an I/O thread; hWaiter is resumed when it is done.
+*   \param fnWork - blocking work (runs on an I/O thread)
+*   \param hWaiter - suspended coroutine waiting for the work
+*/
+
+void CIoEngineEDF::vSubmit( function<void ( void )> fnWork, coroutine_handle<> hWaiter )
+{
+	request_S sRequest;
+
+	sRequest.fnWork = fnWork;
+	sRequest.hWaiter = hWaiter;
+
+	{
+		lock_guard<mutex> oLock( m_oMutex );
+		m_asRequests.push_back( sRequest );
+		m_iPending++;
+	}
+
+	m_oRequestReady.notify_one();
+}
+
+/*!
+*   \brief I/O thread: run queued work and post (or resume) the waiting coroutines.
+*/
+
+void CIoEngineEDF::vIoThread( void )
+{
+	for( ;; )
+	{
+		request_S sRequest;
+
+		{
+			unique_lock<mutex> oLock( m_oMutex );
+			m_oRequestReady.wait( oLock, [this]( void ) { return( m_bStopping || !m_asRequests.empty() ); } );
+
+			if( m_asRequests.empty() )
+			{
+				break;			// stopping and drained
+			}
+
+			sRequest = m_asRequests.front();
+			m_asRequests.pop_front();
+		}
+
+		sRequest.fnWork();
+
+		if( m_bResumeOnIoThread )
+		{
+			{
+				lock_guard<mutex> oLock( m_oMutex );
+				m_iPending--;
+			}
+
+			sRequest.hWaiter.resume();
+		}
+		else
+		{
+			{
+				lock_guard<mutex> oLock( m_oMutex );
+				m_ahCompletions.push_back( sRequest.hWaiter );
+			}
+
+			m_oCompletionReady.notify_one();
+		}
+	}
+}
+
+/*!
+*   \brief Resume coroutines whose I/O has completed (call from the event loop thread).
+*   \param iMaxCompletions - maximum to resume in this call (-1 = all that are ready)
+*   \return Number of coroutines resumed.
+*/
+
+int CIoEngineEDF::iPollCompletions( int iMaxCompletions )
+{
+	int iResumed = 0;
+
+	while( iMaxCompletions < 0 || iResumed < iMaxCompletions )
+	{
+		coroutine_handle<> hWaiter;
+
+		{
+			lock_guard<mutex> oLock( m_oMutex );
+
+			if( m_ahCompletions.empty() )
+			{
+				break;
+			}
+
+			hWaiter = m_ahCompletions.front();
+			m_ahCompletions.pop_front();
+			m_iPending--;
+		}
+
+		hWaiter.resume();		// may submit new requests
+		iResumed++;
+	}
+
+	return( iResumed );
+}
+
+/*!
+*   \brief Block until at least one completion is ready (for event loops with nothing else to do).
+*   \param iTimeoutMilliseconds - maximum wait
+*   \return true if completions are ready.
+*/
+
+bool CIoEngineEDF::bWaitCompletions( int iTimeoutMilliseconds )
+{
+	unique_lock<mutex> oLock( m_oMutex );
+
+	return( m_oCompletionReady.wait_for( oLock, chrono::milliseconds( iTimeoutMilliseconds ),
+		[this]( void ) { return( !m_ahCompletions.empty() ); } ) );
+}
+
+/*!
+*   \brief Constructor - open the file and parse the header.
+*   \param poEngine - I/O engine (must outlive the reader)
+*   \param pszInputFile - input file
+*   \param peEdfStatus - loaded with the open status if not null
+*/
+
+CAsyncReadEDF::CAsyncReadEDF( CIoEngineEDF *poEngine, char *pszInputFile, CReadEDF::edfStatus_E *peEdfStatus )
+{
+	m_poEngine = poEngine;
+	m_poEDF = new CReadEDF( pszInputFile, peEdfStatus );
+	m_sInputFile = pszInputFile;
+	m_iFile = -1;
+	m_llNumberRecords = 0;
+	m_iHeaderBytes = 0;
+	m_iRecordSize = 0;
+	m_iSamplesPerRecord = 0;
+
+	if( m_poEDF->bReadyStatus( &m_eStaticStatus ) )
+	{
+		m_poEDF->eGetNumberRecords( &m_llNumberRecords );
+		m_iHeaderBytes = m_poEDF->iGetHeaderBytes();
+		m_iRecordSize = m_poEDF->iGetRecordSize();
+		m_iSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+
+#if defined(__linux__)
+		m_iFile = open( pszInputFile, O_RDONLY | O_CLOEXEC );
+		if( m_iFile < 0 )
+		{
+			m_eStaticStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+		}
+#endif
+	}
+
+	if( peEdfStatus != NULL )
+	{
+		*peEdfStatus = m_eStaticStatus;
+	}
+}
+
+/*!
+*   \brief Destructor
+*	\note All reads on this file must have completed.
+*/
+
+CAsyncReadEDF::~CAsyncReadEDF( void )
+{
+#if defined(__linux__)
+	if( m_iFile >= 0 )
+	{
+		close( m_iFile );
+	}
+#endif
+
+	delete m_poEDF;
+}
+
+/*!
+*   \brief Blocking read of one record block (runs on an I/O thread, concurrently with other reads of the same file).
+*   \param sBlock - llFirstRecord/llNumberRecords in, samples and status out
+*/
+
+void CAsyncReadEDF::vReadBlock( recordBlock_S &sBlock )
+{
+	sBlock.eEdfStatus = m_eStaticStatus;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_eStaticStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		// A negative number of data records means "unknown", so then rely on the read to fail:
+		if( sBlock.llFirstRecord < 0 || sBlock.llNumberRecords <= 0
+			|| (m_llNumberRecords >= 0 && sBlock.llFirstRecord + sBlock.llNumberRecords > m_llNumberRecords) )
+		{
+			sBlock.eEdfStatus = CReadEDF::EDF_INVALID_RECORD_REQUESTED;
+			break;
+		}
+
+		sBlock.asSamples.resize( (size_t)(sBlock.llNumberRecords * m_iSamplesPerRecord) );
+
+		char *pcData = reinterpret_cast<char *>( sBlock.asSamples.data() );
+		long long llOffset = m_iHeaderBytes + sBlock.llFirstRecord * m_iRecordSize;
+		long long llBytes = sBlock.llNumberRecords * m_iRecordSize;
+
+		sBlock.eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+#if defined(__linux__)
+		while( llBytes > 0 )
+		{
+			ssize_t iRead = pread( m_iFile, pcData, (size_t)min( llBytes, 1LL << 30 ), (off_t)llOffset );
+
+			if( iRead < 0 && errno == EINTR )
+			{
+				continue;
+			}
+
+			if( iRead <= 0 )
+			{
+				sBlock.eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;		// error or end of file
+				break;
+			}
+
+			pcData += iRead;
+			llOffset += iRead;
+			llBytes -= iRead;
+		}
+#else
+		// No positional reads here: a private stream per request keeps the reads independent:
+		ifstream oFile( m_sInputFile.c_str(), ios::in | ios::binary );
+
+		oFile.seekg( (streamoff)llOffset );
+		oFile.read( pcData, (streamsize)llBytes );
+
+		if( oFile.fail() )
+		{
+			sBlock.eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+		}
+#endif
+	} //for()
+}
+
+/*!
+*   \brief Awaitable read of consecutive data records.
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \return Awaitable; co_await yields a recordBlock_S.
+*/
+
+CAsyncReadEDF::readRecords_S CAsyncReadEDF::oReadRecords( long long llFirstRecord, long long llNumberRecords )
+{
+	readRecords_S sRead;
+
+	sRead.poReader = this;
+	sRead.sBlock.eEdfStatus = CReadEDF::EDF_VOID;
+	sRead.sBlock.llFirstRecord = llFirstRecord;
+	sRead.sBlock.llNumberRecords = llNumberRecords;
+
+	return( sRead );
+}
+
+/*!
+*   \brief Async generator over a record range in blocks of llBlockRecords.
+*	\note Stops after the first block that fails (that block is still yielded with its status).
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \param llBlockRecords - data records per yielded block
+*   \return Generator; co_await psNext() for each block.
+*/
+
+CRecordGeneratorEDF CAsyncReadEDF::oRecordBlocks( long long llFirstRecord, long long llNumberRecords, long long llBlockRecords )
+{
+	llBlockRecords = max( llBlockRecords, 1LL );
+
+	for( long long llDone = 0; llDone < llNumberRecords; llDone += llBlockRecords )
+	{
+		recordBlock_S sBlock = co_await oReadRecords( llFirstRecord + llDone, min( llBlockRecords, llNumberRecords - llDone ) );
+
+		co_yield sBlock;
+
+		if( sBlock.eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+	}
+}
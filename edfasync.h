@@ -0,0 +1,277 @@
+#ifndef EDFASYNC_H
+#define EDFASYNC_H
+
+#include <coroutine>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definitions for the C++20 coroutine (awaitable) EDF read API.
+	\note This header needs C++20 (/std:c++20, -std=c++20); the rest of the library does not.
+*/
+
+//! \brief A block of consecutive data records (all signals, record layout as CReadEDF::eReadRecords()).
+struct recordBlock_S
+{
+	CReadEDF::edfStatus_E eEdfStatus;
+	long long llFirstRecord;
+	long long llNumberRecords;
+	vector<short int> asSamples;
+};
+
+/*! \class CIoEngineEDF
+    \brief Non-blocking I/O engine: a few dedicated I/O threads and a completion queue.
+
+	Coroutines that co_await a read are suspended and their request is queued; an I/O thread
+	performs the blocking ifstream work and puts the coroutine on the completion queue. The
+	event loop calls iPollCompletions() (or bWaitCompletions() when it has nothing else to do)
+	and the coroutines resume there, on the event loop thread, so thousands of reads in flight
+	only ever occupy the I/O threads. With bResumeOnIoThread the coroutines resume directly on
+	the I/O thread instead (no event loop needed, but the continuation then runs there).
+*/
+
+class CIoEngineEDF
+{
+	public:
+
+	CIoEngineEDF( int iNumberIoThreads = 2, bool bResumeOnIoThread = false );
+	~CIoEngineEDF( void );
+
+	void vSubmit( function<void ( void )> fnWork, coroutine_handle<> hWaiter );
+
+	int iPollCompletions( int iMaxCompletions = -1 );
+	bool bWaitCompletions( int iTimeoutMilliseconds );
+
+	//! \brief Return the number of requests submitted but not yet resumed.
+	int iGetPending( void )
+	{
+		lock_guard<mutex> oLock( m_oMutex );
+		return( m_iPending );
+	};
+
+	private:
+
+	struct request_S
+	{
+		function<void ( void )> fnWork;
+		coroutine_handle<> hWaiter;
+	};
+
+	void vIoThread( void );
+
+	bool m_bResumeOnIoThread;
+	bool m_bStopping;
+	int m_iPending;
+	mutex m_oMutex;
+	condition_variable m_oRequestReady;
+	condition_variable m_oCompletionReady;
+	deque<request_S> m_asRequests;
+	deque< coroutine_handle<> > m_ahCompletions;
+	vector<thread> m_aoIoThreads;
+}; //class CIoEngineEDF
+
+/*! \class CRecordGeneratorEDF
+    \brief Async generator of record blocks; the consumer loops on co_await oGenerator.psNext().
+
+	\code
+	CRecordGeneratorEDF oBlocks = oReader.oRecordBlocks( 0, llNumberRecords, 30 );
+	while( recordBlock_S *psBlock = co_await oBlocks.psNext() )
+	{
+		// ... psBlock->asSamples ...
+	}
+	\endcode
+*/
+
+class CRecordGeneratorEDF
+{
+	public:
+
+	struct promise_type;
+
+	//! \brief Suspends the generator and transfers control straight back to the consumer.
+	struct toConsumer_S
+	{
+		bool await_ready( void ) noexcept
+		{
+			return( false );
+		};
+
+		coroutine_handle<> await_suspend( coroutine_handle<promise_type> hGenerator ) noexcept
+		{
+			return( hGenerator.promise().hConsumer );
+		};
+
+		void await_resume( void ) noexcept
+		{
+		};
+	};
+
+	struct promise_type
+	{
+		recordBlock_S *psCurrent = NULL;
+		coroutine_handle<> hConsumer;
+
+		CRecordGeneratorEDF get_return_object( void )
+		{
+			return( CRecordGeneratorEDF( coroutine_handle<promise_type>::from_promise( *this ) ) );
+		};
+
+		suspend_always initial_suspend( void ) noexcept
+		{
+			return( suspend_always() );
+		};
+
+		toConsumer_S final_suspend( void ) noexcept
+		{
+			return( toConsumer_S() );
+		};
+
+		toConsumer_S yield_value( recordBlock_S &sBlock ) noexcept
+		{
+			psCurrent = &sBlock;
+			return( toConsumer_S() );
+		};
+
+		void return_void( void )
+		{
+			psCurrent = NULL;
+		};
+
+		void unhandled_exception( void )
+		{
+			terminate();
+		};
+	};
+
+	//! \brief Resumes the generator until its next co_yield (or its end).
+	struct next_S
+	{
+		coroutine_handle<promise_type> hGenerator;
+
+		bool await_ready( void )
+		{
+			return( !hGenerator || hGenerator.done() );
+		};
+
+		coroutine_handle<> await_suspend( coroutine_handle<> hConsumer )
+		{
+			hGenerator.promise().hConsumer = hConsumer;
+			return( hGenerator );
+		};
+
+		recordBlock_S *await_resume( void )
+		{
+			return( (hGenerator && !hGenerator.done()) ? hGenerator.promise().psCurrent : NULL );
+		};
+	};
+
+	explicit CRecordGeneratorEDF( coroutine_handle<promise_type> hGenerator ) : m_hGenerator( hGenerator )
+	{
+	};
+
+	CRecordGeneratorEDF( CRecordGeneratorEDF &&oOther ) noexcept : m_hGenerator( oOther.m_hGenerator )
+	{
+		oOther.m_hGenerator = NULL;
+	};
+
+	CRecordGeneratorEDF( const CRecordGeneratorEDF & ) = delete;
+	CRecordGeneratorEDF &operator=( const CRecordGeneratorEDF & ) = delete;
+
+	~CRecordGeneratorEDF( void )
+	{
+		if( m_hGenerator )
+		{
+			m_hGenerator.destroy();
+		}
+	};
+
+	//! \brief co_await the next block; NULL when the range is exhausted.
+	next_S psNext( void )
+	{
+		next_S sNext = { m_hGenerator };
+		return( sNext );
+	};
+
+	private:
+	coroutine_handle<promise_type> m_hGenerator;
+}; //class CRecordGeneratorEDF
+
+/*! \class CAsyncReadEDF
+    \brief Awaitable reads on one EDF file, executed by a CIoEngineEDF.
+
+	\code
+	recordBlock_S sBlock = co_await oReader.oReadRecords( 100, 30 );
+	\endcode
+
+	The header is parsed by the constructor, which also keeps the data record layout. Reads are
+	positional (pread() on a descriptor owned by this object; elsewhere a stream opened per
+	request), so they share no stream state: requests on one file and on different files all run
+	concurrently on the engine's I/O threads, and no I/O thread waits on another's read. Reads
+	never touch the CReadEDF instance returned by poGetReader().
+*/
+
+class CAsyncReadEDF
+{
+	public:
+
+	//! \brief Awaitable for one record range; lives in the awaiting coroutine frame while suspended.
+	struct readRecords_S
+	{
+		CAsyncReadEDF *poReader;
+		recordBlock_S sBlock;
+
+		bool await_ready( void )
+		{
+			return( false );
+		};
+
+		void await_suspend( coroutine_handle<> hWaiter )
+		{
+			poReader->m_poEngine->vSubmit( [this]( void ) { poReader->vReadBlock( sBlock ); }, hWaiter );
+		};
+
+		recordBlock_S await_resume( void )
+		{
+			return( move( sBlock ) );
+		};
+	};
+
+	CAsyncReadEDF( CIoEngineEDF *poEngine, char *pszInputFile, CReadEDF::edfStatus_E *peEdfStatus = NULL );
+	~CAsyncReadEDF( void );
+
+	//! \brief Header access (in memory, so it does not block). I/O threads never use this reader, so it may be
+	//!        used while reads are in flight, but from one thread only (its getters share a value buffer).
+	CReadEDF *poGetReader( void )
+	{
+		return( m_poEDF );
+	};
+
+	readRecords_S oReadRecords( long long llFirstRecord, long long llNumberRecords );
+	CRecordGeneratorEDF oRecordBlocks( long long llFirstRecord, long long llNumberRecords, long long llBlockRecords );
+
+	private:
+	void vReadBlock( recordBlock_S &sBlock );
+
+	CIoEngineEDF *m_poEngine;
+	CReadEDF *m_poEDF;
+	string m_sInputFile;
+	int m_iFile;								///< read only descriptor for pread() (-1 if not open)
+
+	// Data record layout, copied from the header at open time (read only afterwards):
+	CReadEDF::edfStatus_E m_eStaticStatus;
+	long long m_llNumberRecords;				///< -1 if unknown
+	int m_iHeaderBytes;
+	int m_iRecordSize;
+	int m_iSamplesPerRecord;
+}; //class CAsyncReadEDF
+
+#endif // EDFASYNC_H
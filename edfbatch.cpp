@@ -0,0 +1,610 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for a work-stealing batch scheduler running a per-file analysis over many EDF files.
+*/
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <thread>
+#include "edfbatch.h"
+
+using namespace std;
+
+/*!
+*   \brief Constructor for the CBatchEDF class.
+*   \param apszInputFiles - input files
+*   \param iNumberFiles - number of input files
+*   \param iNumberThreads - worker threads (0 = one per hardware thread)
+*/
+
+CBatchEDF::CBatchEDF( char **apszInputFiles, int iNumberFiles, int iNumberThreads )
+{
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+	m_llTaskBytes = (long long)TASK_MBYTES * 1024 * 1024;
+	m_llMemoryLimit = (long long)MEMORY_MBYTES * 1024 * 1024;
+	m_iOpenFileLimit = OPEN_FILES;
+	m_dProgressInterval = 1.0;
+	m_llQueued = 0;
+	m_llPending = 0;
+	m_iOpenReaders = 0;
+	m_llBytesInFlight = 0;
+	m_dLastProgress = 0.0;
+	m_sProgress = progress_S();
+
+	// File sizes order the initial deal and give the progress total; the headers are read lazily by the workers:
+	for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+	{
+		struct stat sStat;
+
+		m_asInputFiles.push_back( apszInputFiles[iFile] );
+		m_allFileBytes.push_back( (stat( apszInputFiles[iFile], &sStat ) == 0) ? (long long)sStat.st_size : 0 );
+		m_sProgress.llTotalBytes += m_allFileBytes.back();
+	}
+
+	m_sProgress.iNumberFiles = (int)m_asInputFiles.size();
+}
+
+/*!
+*   \brief Destructor for the CBatchEDF class.
+*/
+
+CBatchEDF::~CBatchEDF( void )
+{
+	for( list<idleReader_S>::iterator poReader = m_asIdleReaders.begin(); poReader != m_asIdleReaders.end(); poReader++ )
+	{
+		delete poReader->poEDF;
+	}
+}
+
+/*!
+*   \brief Set the data bytes per task; files with more data are split into record-range tasks.
+*/
+
+void CBatchEDF::vSetTaskBytes( long long llTaskBytes )
+{
+	m_llTaskBytes = max( llTaskBytes, 1LL );
+}
+
+/*!
+*   \brief Set the cap on the data bytes (records * record size) of the tasks running at once.
+*/
+
+void CBatchEDF::vSetMemoryLimit( long long llMemoryBytes )
+{
+	m_llMemoryLimit = max( llMemoryBytes, 1LL );
+}
+
+/*!
+*   \brief Set the cap on open readers (each holds one file descriptor).
+*/
+
+void CBatchEDF::vSetOpenFileLimit( int iOpenFiles )
+{
+	m_iOpenFileLimit = max( iOpenFiles, 1 );
+}
+
+/*!
+*   \brief Set a callback for files whose tasks have all finished (called from the worker threads).
+*/
+
+void CBatchEDF::vSetFileCallback( fileCallback_F fnFileDone )
+{
+	m_fnFileDone = fnFileDone;
+}
+
+/*!
+*   \brief Set a progress callback, called at most every dIntervalSeconds and once at the end (never concurrently).
+*/
+
+void CBatchEDF::vSetProgressCallback( progressCallback_F fnProgress, double dIntervalSeconds )
+{
+	m_fnProgress = fnProgress;
+	m_dProgressInterval = dIntervalSeconds;
+}
+
+/*!
+*   \brief Run fnTask over every file (or record range of a large file) on the worker threads.
+*   \param fnTask - called with an open reader for each task; may run concurrently for one file
+*   \return EDF_SUCCESS if every task succeeded, else the status of the first failed file.
+*/
+
+CReadEDF::edfStatus_E CBatchEDF::eRun( taskCallback_F fnTask )
+{
+	int iNumberFiles = (int)m_asInputFiles.size();
+
+	if( !fnTask )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	m_fnTask = fnTask;
+	m_aeFileStatus.assign( iNumberFiles, CReadEDF::EDF_SUCCESS );
+	m_aiTasksLeft.assign( iNumberFiles, 1 );
+	m_asTimings.clear();
+	m_apsWorkers.clear();
+
+	m_sProgress.iFilesDone = 0;
+	m_sProgress.llTasksDone = 0;
+	m_sProgress.llTasksKnown = iNumberFiles;
+	m_sProgress.llBytesDone = 0;
+	m_sProgress.iFailedFiles = 0;
+	m_sProgress.dElapsedSeconds = 0.0;
+	m_dLastProgress = 0.0;
+
+	for( int iWorker = 0; iWorker < m_iNumberThreads; iWorker++ )
+	{
+		m_apsWorkers.push_back( unique_ptr<worker_S>( new worker_S ) );
+	}
+
+	// Deal the files largest first, round robin; each worker takes its own work from the back of its deque:
+	vector<int> aiOrder( iNumberFiles );
+
+	for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+	{
+		aiOrder[iFile] = iFile;
+	}
+
+	stable_sort( aiOrder.begin(), aiOrder.end(), [&]( int iFirst, int iSecond ) { return( m_allFileBytes[iFirst] > m_allFileBytes[iSecond] ); } );
+
+	for( int iOrder = 0; iOrder < iNumberFiles; iOrder++ )
+	{
+		task_S sTask;
+
+		sTask.iFile = aiOrder[iOrder];
+		sTask.llFirstRecord = 0;
+		sTask.llNumberRecords = -1;				// not known before the header is read
+		sTask.llFileRecords = -1;
+		sTask.bWholeFile = true;
+		m_apsWorkers[iOrder % m_iNumberThreads]->asTasks.push_front( sTask );
+	}
+
+	m_llQueued = iNumberFiles;
+	m_llPending = iNumberFiles;
+	m_oStartTime = chrono::steady_clock::now();
+
+	vector<thread> aoThreads;
+
+	for( int iWorker = 1; iWorker < m_iNumberThreads; iWorker++ )
+	{
+		aoThreads.push_back( thread( &CBatchEDF::vWorker, this, iWorker ) );
+	}
+
+	vWorker( 0 );
+
+	for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+	{
+		aoThreads[iThread].join();
+	}
+
+	for( int iWorker = 0; iWorker < m_iNumberThreads; iWorker++ )
+	{
+		vector<taskTiming_S> &asTimings = m_apsWorkers[iWorker]->asTimings;
+
+		m_asTimings.insert( m_asTimings.end(), asTimings.begin(), asTimings.end() );
+	}
+
+	sort( m_asTimings.begin(), m_asTimings.end(), []( const taskTiming_S &sFirst, const taskTiming_S &sSecond ) { return( sFirst.dStartSeconds < sSecond.dStartSeconds ); } );
+	m_apsWorkers.clear();
+	m_fnTask = taskCallback_F();
+
+	vReportProgress( true );
+
+	for( int iFile = 0; iFile < iNumberFiles; iFile++ )
+	{
+		if( m_aeFileStatus[iFile] != CReadEDF::EDF_SUCCESS )
+		{
+			return( m_aeFileStatus[iFile] );
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Worker loop: run own and stolen tasks until no task is queued or running.
+*/
+
+void CBatchEDF::vWorker( int iWorker )
+{
+	task_S sTask;
+	bool bStolen = false;
+
+	for( ;; )
+	{
+		if( bNextTask( iWorker, &sTask, &bStolen ) )
+		{
+			eRunTask( iWorker, sTask, bStolen );
+			continue;
+		}
+
+		// Nothing to take; tasks still running may split a file and queue more:
+		unique_lock<mutex> oLock( m_oWorkMutex );
+
+		m_oWorkReady.wait( oLock, [&]( void ) { return( m_llPending == 0 || m_llQueued > 0 ); } );
+
+		if( m_llPending == 0 )
+		{
+			break;
+		}
+	}
+}
+
+/*!
+*   \brief Take a task from the back of the own deque, else steal one from the front of another worker's deque.
+*   \return true if psTask was loaded.
+*/
+
+bool CBatchEDF::bNextTask( int iWorker, task_S *psTask, bool *pbStolen )
+{
+	for( int iVictim = 0; iVictim < m_iNumberThreads; iVictim++ )
+	{
+		worker_S &sWorker = *m_apsWorkers[(iWorker + iVictim) % m_iNumberThreads];
+		bool bFound = false;
+
+		{
+			lock_guard<mutex> oLock( sWorker.oMutex );
+
+			if( !sWorker.asTasks.empty() )
+			{
+				if( iVictim == 0 )
+				{
+					*psTask = sWorker.asTasks.back();
+					sWorker.asTasks.pop_back();
+				}
+				else
+				{
+					*psTask = sWorker.asTasks.front();
+					sWorker.asTasks.pop_front();
+				}
+
+				bFound = true;
+			}
+		}
+
+		if( bFound )
+		{
+			lock_guard<mutex> oLock( m_oWorkMutex );
+
+			m_llQueued--;
+			*pbStolen = (iVictim != 0);
+			return( true );
+		}
+	}
+
+	return( false );
+}
+
+/*!
+*   \brief Queue tasks on the back of a worker's deque (the first task ends up at the back) and wake idle workers.
+*/
+
+void CBatchEDF::vPushTasks( int iWorker, const vector<task_S> &asTasks )
+{
+	{
+		lock_guard<mutex> oLock( m_apsWorkers[iWorker]->oMutex );
+
+		for( size_t iTask = asTasks.size(); iTask-- > 0; )
+		{
+			m_apsWorkers[iWorker]->asTasks.push_back( asTasks[iTask] );
+		}
+	}
+
+	{
+		lock_guard<mutex> oLock( m_oWorkMutex );
+
+		m_llQueued += (long long)asTasks.size();
+		m_llPending += (long long)asTasks.size();
+	}
+
+	m_oWorkReady.notify_all();
+}
+
+/*!
+*   \brief Run one task: open (or reuse) a reader, split a large whole file, then call the task callback.
+*   \return Status of the task.
+*/
+
+CReadEDF::edfStatus_E CBatchEDF::eRunTask( int iWorker, task_S sTask, bool bStolen )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	CReadEDF *poEDF = poAcquireReader( sTask.iFile, &eEdfStatus );
+	long long llRecordSize = (poEDF != NULL) ? poEDF->iGetRecordSize() : 0;
+	long long llBytes = 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( poEDF == NULL )
+		{
+			break;
+		}
+
+		// First task of a file: size it, and split it if it is large:
+		if( sTask.llFileRecords < 0 )
+		{
+			long long llNumberRecords = -1;
+
+			poEDF->eGetNumberRecords( &llNumberRecords );
+
+			// Unknown number of records (-1): whatever the file holds:
+			if( llNumberRecords < 0 && llRecordSize > 0 )
+			{
+				llNumberRecords = max( 0LL, (m_allFileBytes[sTask.iFile] - poEDF->iGetHeaderBytes()) / llRecordSize );
+			}
+
+			sTask.llFileRecords = max( llNumberRecords, 0LL );
+			sTask.llNumberRecords = sTask.llFileRecords;
+
+			long long llTaskRecords = (llRecordSize > 0) ? max( 1LL, m_llTaskBytes / llRecordSize ) : sTask.llFileRecords;
+
+			if( sTask.llFileRecords > llTaskRecords )
+			{
+				vector<task_S> asSplit;
+
+				sTask.bWholeFile = false;
+				sTask.llNumberRecords = llTaskRecords;
+
+				for( long long llFirst = llTaskRecords; llFirst < sTask.llFileRecords; llFirst += llTaskRecords )
+				{
+					task_S sRange = sTask;
+
+					sRange.llFirstRecord = llFirst;
+					sRange.llNumberRecords = min( llTaskRecords, sTask.llFileRecords - llFirst );
+					asSplit.push_back( sRange );
+				}
+
+				{
+					lock_guard<mutex> oLock( m_oProgressMutex );
+
+					m_aiTasksLeft[sTask.iFile] += (int)asSplit.size();
+					m_sProgress.llTasksKnown += (long long)asSplit.size();
+				}
+
+				vPushTasks( iWorker, asSplit );
+			}
+		}
+
+		llBytes = sTask.llNumberRecords * llRecordSize;
+		vAcquireMemory( llBytes );
+
+		taskTiming_S sTiming;
+
+		sTiming.iFile = sTask.iFile;
+		sTiming.llFirstRecord = sTask.llFirstRecord;
+		sTiming.llNumberRecords = sTask.llNumberRecords;
+		sTiming.iWorker = iWorker;
+		sTiming.bStolen = bStolen;
+		sTiming.dStartSeconds = dElapsedSeconds();
+
+		eEdfStatus = m_fnTask( poEDF, sTask, iWorker );
+
+		sTiming.dSeconds = dElapsedSeconds() - sTiming.dStartSeconds;
+		sTiming.eEdfStatus = eEdfStatus;
+		m_apsWorkers[iWorker]->asTimings.push_back( sTiming );
+
+		vReleaseMemory( llBytes );
+		vReleaseReader( sTask.iFile, poEDF );
+	} //for()
+
+	vFinishTask( sTask, eEdfStatus, llBytes );
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Return an idle reader of the file, or open one within the open file limit (closing the least recently used idle reader if needed).
+*   \return Reader, or NULL if the file can not be opened (status in *peEdfStatus).
+*/
+
+CReadEDF *CBatchEDF::poAcquireReader( int iFile, CReadEDF::edfStatus_E *peEdfStatus )
+{
+	{
+		unique_lock<mutex> oLock( m_oResourceMutex );
+
+		for( ;; )
+		{
+			for( list<idleReader_S>::iterator poReader = m_asIdleReaders.begin(); poReader != m_asIdleReaders.end(); poReader++ )
+			{
+				if( poReader->iFile == iFile )
+				{
+					CReadEDF *poEDF = poReader->poEDF;
+
+					m_asIdleReaders.erase( poReader );
+					*peEdfStatus = CReadEDF::EDF_SUCCESS;
+					return( poEDF );
+				}
+			}
+
+			if( m_iOpenReaders < m_iOpenFileLimit )
+			{
+				break;
+			}
+
+			if( !m_asIdleReaders.empty() )
+			{
+				delete m_asIdleReaders.back().poEDF;
+				m_asIdleReaders.pop_back();
+				m_iOpenReaders--;
+				continue;
+			}
+
+			m_oResourceFreed.wait( oLock );
+		}
+
+		m_iOpenReaders++;
+	}
+
+	CReadEDF *poEDF = new CReadEDF( (char *)m_asInputFiles[iFile].c_str(), peEdfStatus );
+
+	if( !poEDF->bReadyStatus( peEdfStatus ) )
+	{
+		delete poEDF;
+
+		{
+			lock_guard<mutex> oLock( m_oResourceMutex );
+
+			m_iOpenReaders--;
+		}
+
+		m_oResourceFreed.notify_all();
+		return( NULL );
+	}
+
+	return( poEDF );
+}
+
+/*!
+*   \brief Return a reader to the idle pool (most recently used first).
+*/
+
+void CBatchEDF::vReleaseReader( int iFile, CReadEDF *poEDF )
+{
+	idleReader_S sReader;
+
+	sReader.iFile = iFile;
+	sReader.poEDF = poEDF;
+
+	{
+		lock_guard<mutex> oLock( m_oResourceMutex );
+
+		m_asIdleReaders.push_front( sReader );
+	}
+
+	m_oResourceFreed.notify_all();
+}
+
+/*!
+*   \brief Close the idle readers of a finished file.
+*/
+
+void CBatchEDF::vCloseReaders( int iFile )
+{
+	{
+		lock_guard<mutex> oLock( m_oResourceMutex );
+
+		for( list<idleReader_S>::iterator poReader = m_asIdleReaders.begin(); poReader != m_asIdleReaders.end(); )
+		{
+			if( poReader->iFile == iFile )
+			{
+				delete poReader->poEDF;
+				poReader = m_asIdleReaders.erase( poReader );
+				m_iOpenReaders--;
+			}
+			else
+			{
+				poReader++;
+			}
+		}
+	}
+
+	m_oResourceFreed.notify_all();
+}
+
+/*!
+*   \brief Wait until llBytes fit under the memory limit (or nothing else is running).
+*/
+
+void CBatchEDF::vAcquireMemory( long long llBytes )
+{
+	unique_lock<mutex> oLock( m_oResourceMutex );
+
+	m_oResourceFreed.wait( oLock, [&]( void ) { return( m_llBytesInFlight == 0 || m_llBytesInFlight + llBytes <= m_llMemoryLimit ); } );
+	m_llBytesInFlight += llBytes;
+}
+
+void CBatchEDF::vReleaseMemory( long long llBytes )
+{
+	{
+		lock_guard<mutex> oLock( m_oResourceMutex );
+
+		m_llBytesInFlight -= llBytes;
+	}
+
+	m_oResourceFreed.notify_all();
+}
+
+/*!
+*   \brief Book a finished task: file status, file completion, progress, and the pending count.
+*/
+
+void CBatchEDF::vFinishTask( const task_S &sTask, CReadEDF::edfStatus_E eEdfStatus, long long llBytes )
+{
+	bool bFileDone = false;
+	CReadEDF::edfStatus_E eFileStatus = CReadEDF::EDF_SUCCESS;
+
+	{
+		lock_guard<mutex> oLock( m_oProgressMutex );
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS && m_aeFileStatus[sTask.iFile] == CReadEDF::EDF_SUCCESS )
+		{
+			m_aeFileStatus[sTask.iFile] = eEdfStatus;
+		}
+
+		m_sProgress.llTasksDone++;
+		m_sProgress.llBytesDone += llBytes;
+
+		if( --m_aiTasksLeft[sTask.iFile] == 0 )
+		{
+			bFileDone = true;
+			eFileStatus = m_aeFileStatus[sTask.iFile];
+			m_sProgress.iFilesDone++;
+			m_sProgress.iFailedFiles += (eFileStatus != CReadEDF::EDF_SUCCESS) ? 1 : 0;
+		}
+	}
+
+	if( bFileDone )
+	{
+		vCloseReaders( sTask.iFile );
+
+		if( m_fnFileDone )
+		{
+			m_fnFileDone( sTask.iFile, eFileStatus );
+		}
+	}
+
+	vReportProgress( false );
+
+	bool bAllDone = false;
+
+	{
+		lock_guard<mutex> oLock( m_oWorkMutex );
+
+		bAllDone = (--m_llPending == 0);
+	}
+
+	if( bAllDone )
+	{
+		m_oWorkReady.notify_all();
+	}
+}
+
+/*!
+*   \brief Call the progress callback if the progress interval has passed (always if bFinal).
+*/
+
+void CBatchEDF::vReportProgress( bool bFinal )
+{
+	if( !m_fnProgress )
+	{
+		return;
+	}
+
+	lock_guard<mutex> oLock( m_oProgressMutex );
+	double dNow = dElapsedSeconds();
+
+	if( !bFinal && dNow - m_dLastProgress < m_dProgressInterval )
+	{
+		return;
+	}
+
+	m_dLastProgress = dNow;
+	m_sProgress.dElapsedSeconds = dNow;
+	m_fnProgress( m_sProgress );
+}
+
+double CBatchEDF::dElapsedSeconds( void )
+{
+	return( chrono::duration<double>( chrono::steady_clock::now() - m_oStartTime ).count() );
+}
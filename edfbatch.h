@@ -0,0 +1,189 @@
+#ifndef EDFBATCH_H
+#define EDFBATCH_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for a work-stealing batch scheduler running a per-file analysis over many EDF files.
+*/
+
+/*! \class CBatchEDF
+    \brief Runs a task callback over whole archives of EDF files on a pool of work-stealing threads.
+
+	Every file starts as one whole-file task. Files are sorted by size (largest first) and dealt
+	round robin onto per-worker deques. When a worker opens a file larger than the task size it
+	splits it into record-range tasks, keeps the first and pushes the rest onto its own deque.
+	A worker takes its own tasks from the back of its deque; an idle worker steals from the front
+	of the others', so a 20 GB file is shared by all workers while small files never pay for the
+	split.
+
+	Resources are capped across the pool: CReadEDF readers (one file descriptor each) are kept
+	in an LRU pool of at most the open file limit and reused between tasks of the same file, and
+	the data bytes of running tasks (records * record size) are kept under the memory limit (a
+	task larger than the limit still runs, alone).
+
+	The task callback gets a reader positioned on nothing in particular, the task's file and record
+	range and the worker number; it may be called concurrently for ranges of the same file.
+	Progress is reported at most once per progress interval (and once at the end), and the
+	duration of every task is recorded.
+
+	\code
+	CBatchEDF oBatch( apszFiles, iNumberFiles );
+	oBatch.eRun( [&]( CReadEDF *poEDF, const CBatchEDF::task_S &sTask, int iWorker )
+	{
+		...poEDF->eReadRecords( sTask.llFirstRecord, ... )...
+		return( CReadEDF::EDF_SUCCESS );
+	} );
+	\endcode
+*/
+
+class CBatchEDF
+{
+	public:
+
+	enum batchConstants_E
+	{
+		TASK_MBYTES = 64,					///< default data bytes per record-range task (files above are split)
+		MEMORY_MBYTES = 2048,				///< default cap on data bytes of the tasks running at once
+		OPEN_FILES = 256,					///< default cap on open readers (file descriptors)
+	};
+
+	//! \brief One unit of work: a record range of one file.
+	struct task_S
+	{
+		int iFile;							///< index into the input file list
+		long long llFirstRecord;
+		long long llNumberRecords;
+		long long llFileRecords;			///< data records in the whole file
+		bool bWholeFile;					///< true if the file was not split
+	};
+
+	//! \brief Timing of one finished task.
+	struct taskTiming_S
+	{
+		int iFile;
+		long long llFirstRecord;
+		long long llNumberRecords;
+		int iWorker;
+		bool bStolen;						///< run by a worker that stole it from another one
+		double dStartSeconds;				///< from the start of the run
+		double dSeconds;					///< callback duration
+		CReadEDF::edfStatus_E eEdfStatus;
+	};
+
+	//! \brief Snapshot of the progress of a run.
+	struct progress_S
+	{
+		int iFilesDone;
+		int iNumberFiles;
+		long long llTasksDone;
+		long long llTasksKnown;				///< grows while large files are split
+		long long llBytesDone;				///< data bytes of the finished tasks
+		long long llTotalBytes;				///< size of all input files
+		int iFailedFiles;
+		double dElapsedSeconds;
+	};
+
+	typedef function<CReadEDF::edfStatus_E ( CReadEDF *poEDF, const task_S &sTask, int iWorker )> taskCallback_F;
+	typedef function<void ( int iFile, CReadEDF::edfStatus_E eEdfStatus )> fileCallback_F;
+	typedef function<void ( const progress_S &sProgress )> progressCallback_F;
+
+	CBatchEDF( char **apszInputFiles, int iNumberFiles, int iNumberThreads = 0 );
+	~CBatchEDF( void );
+
+	void vSetTaskBytes( long long llTaskBytes );
+	void vSetMemoryLimit( long long llMemoryBytes );
+	void vSetOpenFileLimit( int iOpenFiles );
+	void vSetFileCallback( fileCallback_F fnFileDone );
+	void vSetProgressCallback( progressCallback_F fnProgress, double dIntervalSeconds = 1.0 );
+
+	CReadEDF::edfStatus_E eRun( taskCallback_F fnTask );
+
+	//! \brief Return the status of a file after eRun() (the first failure of any of its tasks).
+	CReadEDF::edfStatus_E eGetFileStatus( int iFile )
+	{
+		return( (iFile >= 0 && iFile < (int)m_aeFileStatus.size()) ? m_aeFileStatus[iFile] : CReadEDF::EDF_INVALID_PARAMETER );
+	};
+
+	//! \brief Return the timings of all tasks of the last run, in start order.
+	const vector<taskTiming_S> &asGetTimings( void )
+	{
+		return( m_asTimings );
+	};
+
+	private:
+
+	//! \brief Task deque of one worker; the owner uses the back, thieves the front.
+	struct worker_S
+	{
+		mutex oMutex;
+		deque<task_S> asTasks;
+		vector<taskTiming_S> asTimings;
+	};
+
+	//! \brief Idle reader kept open for later tasks of the same file.
+	struct idleReader_S
+	{
+		int iFile;
+		CReadEDF *poEDF;
+	};
+
+	void vWorker( int iWorker );
+	bool bNextTask( int iWorker, task_S *psTask, bool *pbStolen );
+	void vPushTasks( int iWorker, const vector<task_S> &asTasks );
+	CReadEDF::edfStatus_E eRunTask( int iWorker, task_S sTask, bool bStolen );
+	CReadEDF *poAcquireReader( int iFile, CReadEDF::edfStatus_E *peEdfStatus );
+	void vReleaseReader( int iFile, CReadEDF *poEDF );
+	void vCloseReaders( int iFile );
+	void vAcquireMemory( long long llBytes );
+	void vReleaseMemory( long long llBytes );
+	void vFinishTask( const task_S &sTask, CReadEDF::edfStatus_E eEdfStatus, long long llBytes );
+	void vReportProgress( bool bFinal );
+	double dElapsedSeconds( void );
+
+	vector<string> m_asInputFiles;
+	vector<long long> m_allFileBytes;
+	int m_iNumberThreads;
+	long long m_llTaskBytes;
+	long long m_llMemoryLimit;
+	int m_iOpenFileLimit;
+	fileCallback_F m_fnFileDone;
+	progressCallback_F m_fnProgress;
+	double m_dProgressInterval;
+
+	// State of one run (eRun()):
+	taskCallback_F m_fnTask;
+	vector< unique_ptr<worker_S> > m_apsWorkers;
+	vector<CReadEDF::edfStatus_E> m_aeFileStatus;
+	vector<int> m_aiTasksLeft;				///< per file: tasks not yet finished
+	vector<taskTiming_S> m_asTimings;
+	chrono::steady_clock::time_point m_oStartTime;
+
+	mutex m_oWorkMutex;						///< guards m_llQueued/m_llPending waits
+	condition_variable m_oWorkReady;
+	long long m_llQueued;					///< tasks in deques
+	long long m_llPending;					///< tasks queued or running
+
+	mutex m_oResourceMutex;					///< guards readers and memory in flight
+	condition_variable m_oResourceFreed;
+	list<idleReader_S> m_asIdleReaders;		///< most recently used first
+	int m_iOpenReaders;
+	long long m_llBytesInFlight;
+
+	mutex m_oProgressMutex;					///< guards per-file bookkeeping and progress
+	progress_S m_sProgress;
+	double m_dLastProgress;
+}; //class CBatchEDF
+
+#endif // EDFBATCH_H
@@ -0,0 +1,911 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementations for reading gzip and zstd compressed EDF files with random access.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "edfcompressed.h"
+
+#if defined(EDF_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(EDF_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+/*!
+*   \brief Constructor
+*   \param pszInputFile - compressed file
+*   \param iNumberThreads - decoding threads for large reads (0 = one per hardware thread)
+*/
+
+CCompressedBufEDF::CCompressedBufEDF( const char *pszInputFile, int iNumberThreads )
+	: m_oInput( pszInputFile, ios::in | ios::binary )
+{
+	m_sInputFile = pszInputFile;
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+	m_llSize = 0;
+	m_llPosition = 0;
+	m_llFrameBase = 0;
+
+	setg( NULL, NULL, NULL );
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CCompressedBufEDF::~CCompressedBufEDF( void )
+{
+}
+
+/*!
+*   \brief Return the frame holding an uncompressed offset (offset must be below m_llSize).
+*/
+
+size_t CCompressedBufEDF::iFindFrame( long long llOffset )
+{
+	size_t iLow = 0;
+	size_t iHigh = m_asFrames.size();
+
+	// Last frame with llOut <= llOffset:
+	while( iHigh - iLow > 1 )
+	{
+		size_t iMiddle = (iLow + iHigh) / 2;
+
+		if( m_asFrames[iMiddle].llOut <= llOffset )
+		{
+			iLow = iMiddle;
+		}
+		else
+		{
+			iHigh = iMiddle;
+		}
+	}
+
+	return( iLow );
+}
+
+/*!
+*   \brief Make a frame the get area (from the cache, or decoded).
+*   \return false if the frame can not be decoded.
+*/
+
+bool CCompressedBufEDF::bLoadFrame( size_t iFrame )
+{
+	size_t iCached = 0;
+
+	for( ; iCached < m_asCache.size() && m_asCache[iCached].iFrame != iFrame; iCached++ )
+	{
+	}
+
+	if( iCached < m_asCache.size() )
+	{
+		rotate( m_asCache.begin() + iCached, m_asCache.begin() + iCached + 1, m_asCache.end() );	// most recently used last
+	}
+	else
+	{
+		cachedFrame_S sEntry;
+
+		if( m_asCache.size() >= FRAME_CACHE )
+		{
+			sEntry.acData.swap( m_asCache.front().acData );		// reuse the least recently used buffer
+			m_asCache.erase( m_asCache.begin() );
+		}
+
+		sEntry.iFrame = iFrame;
+		sEntry.acData.resize( (size_t)max( m_asFrames[iFrame].llOutSize, 1LL ) );
+
+		if( !bDecodeFrame( m_oInput, iFrame, &sEntry.acData[0] ) )
+		{
+			setg( NULL, NULL, NULL );
+			return( false );
+		}
+
+		m_asCache.push_back( cachedFrame_S() );
+		m_asCache.back().iFrame = iFrame;
+		m_asCache.back().acData.swap( sEntry.acData );
+	}
+
+	char *pcData = &m_asCache.back().acData[0];
+
+	m_llFrameBase = m_asFrames[iFrame].llOut;
+	setg( pcData, pcData, pcData + m_asFrames[iFrame].llOutSize );
+
+	return( true );
+}
+
+/*!
+*   \brief Decode consecutive whole frames straight into the caller's buffer, spread across threads.
+*   \return false if any frame can not be decoded.
+*/
+
+bool CCompressedBufEDF::bDecodeParallel( size_t iFirstFrame, size_t iNumberFrames, char *pcOut )
+{
+	atomic<size_t> iNextFrame( 0 );
+	atomic<bool> bFailed( false );
+	long long llBase = m_asFrames[iFirstFrame].llOut;
+
+	auto fnDecode = [&]( void )
+	{
+		ifstream oInput( m_sInputFile.c_str(), ios::in | ios::binary );
+
+		for( size_t i = iNextFrame++; i < iNumberFrames && !bFailed; i = iNextFrame++ )
+		{
+			const frame_S &sFrame = m_asFrames[iFirstFrame + i];
+
+			if( oInput.fail() || !bDecodeFrame( oInput, iFirstFrame + i, pcOut + (sFrame.llOut - llBase) ) )
+			{
+				bFailed = true;
+			}
+		}
+	};
+
+	vector<thread> aoThreads;
+	int iNumberThreads = (int)min( (size_t)m_iNumberThreads, iNumberFrames );
+
+	for( int iThread = 1; iThread < iNumberThreads; iThread++ )
+	{
+		aoThreads.push_back( thread( fnDecode ) );
+	}
+
+	fnDecode();
+
+	for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+	{
+		aoThreads[iThread].join();
+	}
+
+	return( !bFailed );
+}
+
+/*!
+*   \brief streambuf: refill the get area with the frame holding the current position.
+*/
+
+CCompressedBufEDF::int_type CCompressedBufEDF::underflow( void )
+{
+	if( gptr() < egptr() )
+	{
+		return( traits_type::to_int_type( *gptr() ) );
+	}
+
+	long long llPosition = (eback() != NULL) ? m_llFrameBase + (egptr() - eback()) : m_llPosition;
+
+	if( llPosition >= m_llSize )
+	{
+		setg( NULL, NULL, NULL );
+		m_llPosition = llPosition;
+		return( traits_type::eof() );
+	}
+
+	size_t iFrame = iFindFrame( llPosition );
+
+	if( !bLoadFrame( iFrame ) )
+	{
+		m_llPosition = llPosition;
+		return( traits_type::eof() );
+	}
+
+	setg( eback(), eback() + (llPosition - m_llFrameBase), egptr() );
+
+	return( traits_type::to_int_type( *gptr() ) );
+}
+
+/*!
+*   \brief streambuf: bulk read; runs of whole frames are decoded in parallel into pcOut.
+*/
+
+streamsize CCompressedBufEDF::xsgetn( char *pcOut, streamsize iCount )
+{
+	streamsize iDone = 0;
+
+	while( iDone < iCount )
+	{
+		if( gptr() < egptr() )
+		{
+			streamsize iCopy = min( (streamsize)(egptr() - gptr()), iCount - iDone );
+
+			memcpy( pcOut + iDone, gptr(), (size_t)iCopy );
+			gbump( (int)iCopy );
+			iDone += iCopy;
+			continue;
+		}
+
+		long long llPosition = (eback() != NULL) ? m_llFrameBase + (egptr() - eback()) : m_llPosition;
+
+		if( llPosition >= m_llSize )
+		{
+			break;
+		}
+
+		size_t iFrame = iFindFrame( llPosition );
+		size_t iWholeFrames = 0;
+		long long llWholeBytes = 0;
+
+		if( m_iNumberThreads > 1 && m_asFrames[iFrame].llOut == llPosition )
+		{
+			for( size_t i = iFrame; i < m_asFrames.size() && llWholeBytes + m_asFrames[i].llOutSize <= iCount - iDone; i++ )
+			{
+				llWholeBytes += m_asFrames[i].llOutSize;
+				iWholeFrames++;
+			}
+		}
+
+		if( iWholeFrames >= PARALLEL_FRAMES )
+		{
+			if( !bDecodeParallel( iFrame, iWholeFrames, pcOut + iDone ) )
+			{
+				break;
+			}
+
+			iDone += (streamsize)llWholeBytes;
+			setg( NULL, NULL, NULL );
+			m_llPosition = llPosition + llWholeBytes;
+			continue;
+		}
+
+		if( traits_type::eq_int_type( underflow(), traits_type::eof() ) )
+		{
+			break;
+		}
+	}
+
+	return( iDone );
+}
+
+/*!
+*   \brief streambuf: seek (only records the position unless it is inside the current frame).
+*/
+
+CCompressedBufEDF::pos_type CCompressedBufEDF::seekoff( off_type llOffset, ios_base::seekdir eDirection, ios_base::openmode eMode )
+{
+	long long llCurrent = (eback() != NULL) ? m_llFrameBase + (gptr() - eback()) : m_llPosition;
+	long long llTarget = llOffset;
+
+	if( eDirection == ios_base::cur )
+	{
+		llTarget += llCurrent;
+	}
+	else if( eDirection == ios_base::end )
+	{
+		llTarget += m_llSize;
+	}
+
+	if( !(eMode & ios_base::in) || llTarget < 0 || llTarget > m_llSize )
+	{
+		return( pos_type( off_type( -1 ) ) );
+	}
+
+	if( eback() != NULL && llTarget >= m_llFrameBase && llTarget < m_llFrameBase + (egptr() - eback()) )
+	{
+		setg( eback(), eback() + (llTarget - m_llFrameBase), egptr() );
+	}
+	else
+	{
+		setg( NULL, NULL, NULL );
+		m_llPosition = llTarget;
+	}
+
+	return( pos_type( off_type( llTarget ) ) );
+}
+
+/*!
+*   \brief streambuf: absolute seek.
+*/
+
+CCompressedBufEDF::pos_type CCompressedBufEDF::seekpos( pos_type llPosition, ios_base::openmode eMode )
+{
+	return( seekoff( off_type( llPosition ), ios_base::beg, eMode ) );
+}
+
+#if defined(EDF_WITH_ZLIB)
+
+/*!
+*   \brief Constructor - load the access point index from the sidecar, or build (and save) it.
+*   \param pszInputFile - .gz file
+*   \param iNumberThreads - decoding threads for large reads (0 = one per hardware thread)
+*   \param peEdfStatus - loaded with the status if not null
+*/
+
+CGzipBufEDF::CGzipBufEDF( const char *pszInputFile, int iNumberThreads, CReadEDF::edfStatus_E *peEdfStatus )
+	: CCompressedBufEDF( pszInputFile, iNumberThreads )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	struct stat sStat;
+
+	if( !m_oInput.fail() && stat( pszInputFile, &sStat ) == 0 )
+	{
+		string sIndexFile = m_sInputFile + ".gzi";
+
+		eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+		if( !bLoadIndex( sIndexFile, (long long)sStat.st_size, (long long)sStat.st_mtime ) )
+		{
+			if( bBuildIndex() )
+			{
+				vSaveIndex( sIndexFile, (long long)sStat.st_size, (long long)sStat.st_mtime );
+			}
+			else
+			{
+				eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			}
+		}
+	}
+
+	if( peEdfStatus != NULL )
+	{
+		*peEdfStatus = eEdfStatus;
+	}
+}
+
+/*!
+*   \brief One inflate pass over the whole file, recording an access point every INDEX_SPAN bytes
+*	       (and at the start of every gzip member, so no frame spans two members).
+*   \return false if the file is not valid gzip/zlib data.
+*/
+
+bool CGzipBufEDF::bBuildIndex( void )
+{
+	vector<unsigned char> acInput( 1 << 16 );
+	vector<unsigned char> acWindow( WINDOW_SIZE );
+	long long llTotalIn = 0;
+	long long llTotalOut = 0;
+	long long llLastPoint = 0;
+	bool bNewMember = true;
+	int iResult = Z_OK;
+	z_stream sStream;
+
+	memset( &sStream, 0, sizeof(sStream) );
+	if( inflateInit2( &sStream, 47 ) != Z_OK )		// 32 + 15: gzip or zlib header, 32 KiB window
+	{
+		return( false );
+	}
+
+	m_asFrames.clear();
+	m_oInput.clear();
+	m_oInput.seekg( 0 );
+
+	sStream.avail_out = 0;
+
+	for( bool bInputDone = false; !bInputDone && iResult != Z_DATA_ERROR && iResult != Z_MEM_ERROR; )
+	{
+		if( sStream.avail_in == 0 )
+		{
+			m_oInput.read( (char *)&acInput[0], acInput.size() );
+			sStream.avail_in = (uInt)m_oInput.gcount();
+			sStream.next_in = &acInput[0];
+
+			if( sStream.avail_in == 0 )
+			{
+				break;
+			}
+		}
+
+		while( sStream.avail_in > 0 )
+		{
+			if( sStream.avail_out == 0 )
+			{
+				sStream.avail_out = WINDOW_SIZE;
+				sStream.next_out = &acWindow[0];
+			}
+
+			llTotalIn += sStream.avail_in;
+			llTotalOut += sStream.avail_out;
+			iResult = inflate( &sStream, Z_BLOCK );
+			llTotalIn -= sStream.avail_in;
+			llTotalOut -= sStream.avail_out;
+
+			if( iResult == Z_NEED_DICT || iResult == Z_DATA_ERROR || iResult == Z_MEM_ERROR || iResult == Z_BUF_ERROR )
+			{
+				iResult = (iResult == Z_MEM_ERROR) ? Z_MEM_ERROR : Z_DATA_ERROR;
+				break;
+			}
+
+			if( iResult == Z_STREAM_END )
+			{
+				// Another gzip member follows (pigz, bgzip, cat a.gz b.gz); anything else is trailing junk:
+				int iNext = (sStream.avail_in > 0) ? sStream.next_in[0] : m_oInput.peek();
+
+				if( iNext != 0x1f )
+				{
+					bInputDone = true;
+					break;
+				}
+
+				inflateReset( &sStream );
+				bNewMember = true;
+				continue;
+			}
+
+			// At a deflate block boundary (not after the last block): maybe add an access point:
+			if( (sStream.data_type & 128) && !(sStream.data_type & 64) && (bNewMember || llTotalOut - llLastPoint > INDEX_SPAN) )
+			{
+				frame_S sFrame;
+				size_t iWritePosition = WINDOW_SIZE - sStream.avail_out;
+				size_t iHave = bNewMember ? 0 : (size_t)min( llTotalOut, (long long)WINDOW_SIZE );
+
+				sFrame.llOut = llTotalOut;
+				sFrame.llOutSize = 0;
+				sFrame.llIn = llTotalIn;
+				sFrame.llInSize = 0;
+				sFrame.iBits = sStream.data_type & 7;
+
+				// Last iHave output bytes, oldest first, from the circular window:
+				sFrame.acWindow.resize( iHave );
+				if( iHave > iWritePosition )
+				{
+					memcpy( &sFrame.acWindow[0], &acWindow[WINDOW_SIZE - (iHave - iWritePosition)], iHave - iWritePosition );
+				}
+
+				if( iHave > 0 )
+				{
+					size_t iRecent = min( iHave, iWritePosition );
+					memcpy( &sFrame.acWindow[iHave - iRecent], &acWindow[iWritePosition - iRecent], iRecent );
+				}
+
+				m_asFrames.push_back( sFrame );
+				llLastPoint = llTotalOut;
+				bNewMember = false;
+			}
+		}
+	}
+
+	inflateEnd( &sStream );
+
+	if( iResult != Z_STREAM_END || m_asFrames.empty() )
+	{
+		m_asFrames.clear();
+		return( false );
+	}
+
+	for( size_t iFrame = 0; iFrame < m_asFrames.size(); iFrame++ )
+	{
+		long long llEnd = (iFrame + 1 < m_asFrames.size()) ? m_asFrames[iFrame + 1].llOut : llTotalOut;
+		m_asFrames[iFrame].llOutSize = llEnd - m_asFrames[iFrame].llOut;
+	}
+
+	// Empty members produce empty frames; drop them:
+	m_asFrames.erase( remove_if( m_asFrames.begin(), m_asFrames.end(),
+		[]( const frame_S &sFrame ) { return( sFrame.llOutSize == 0 ); } ), m_asFrames.end() );
+
+	m_llSize = llTotalOut;
+
+	return( !m_asFrames.empty() );
+}
+
+//! \brief Sidecar index file header ("<file>.gzi").
+struct gzipIndexHeader_S
+{
+	char acMagic[8];					///< "EDFGZI01"
+	long long llSourceSize;				///< .gz size when the index was built
+	long long llSourceTime;				///< .gz modification time when the index was built
+	long long llUncompressedSize;
+	long long llNumberFrames;
+};
+
+//! \brief Sidecar index file entry (followed by iWindowSize window bytes).
+struct gzipIndexEntry_S
+{
+	long long llOut;
+	long long llIn;
+	int iBits;
+	int iWindowSize;
+};
+
+/*!
+*   \brief Load the access point index from the sidecar file.
+*   \return false if it is missing, stale or damaged.
+*/
+
+bool CGzipBufEDF::bLoadIndex( const string &sIndexFile, long long llSourceSize, long long llSourceTime )
+{
+	ifstream oIndex( sIndexFile.c_str(), ios::in | ios::binary );
+	gzipIndexHeader_S sHeader;
+
+	oIndex.read( (char *)&sHeader, sizeof(sHeader) );
+
+	if( oIndex.fail() || memcmp( sHeader.acMagic, "EDFGZI01", 8 ) != 0 || sHeader.llSourceSize != llSourceSize
+		|| sHeader.llSourceTime != llSourceTime || sHeader.llNumberFrames <= 0 || sHeader.llNumberFrames > llSourceSize )
+	{
+		return( false );
+	}
+
+	m_asFrames.resize( (size_t)sHeader.llNumberFrames );
+
+	for( size_t iFrame = 0; iFrame < m_asFrames.size(); iFrame++ )
+	{
+		frame_S &sFrame = m_asFrames[iFrame];
+		gzipIndexEntry_S sEntry;
+
+		oIndex.read( (char *)&sEntry, sizeof(sEntry) );
+
+		if( oIndex.fail() || sEntry.iWindowSize < 0 || sEntry.iWindowSize > WINDOW_SIZE || sEntry.iBits < 0 || sEntry.iBits > 7
+			|| sEntry.llOut < 0 || sEntry.llOut >= sHeader.llUncompressedSize || (iFrame > 0 && sEntry.llOut <= m_asFrames[iFrame - 1].llOut) )
+		{
+			m_asFrames.clear();
+			return( false );
+		}
+
+		sFrame.llOut = sEntry.llOut;
+		sFrame.llIn = sEntry.llIn;
+		sFrame.llInSize = 0;
+		sFrame.iBits = sEntry.iBits;
+		sFrame.acWindow.resize( sEntry.iWindowSize );
+
+		if( sEntry.iWindowSize > 0 )
+		{
+			oIndex.read( (char *)&sFrame.acWindow[0], sEntry.iWindowSize );
+		}
+	}
+
+	if( oIndex.fail() || m_asFrames[0].llOut != 0 )
+	{
+		m_asFrames.clear();
+		return( false );
+	}
+
+	for( size_t iFrame = 0; iFrame < m_asFrames.size(); iFrame++ )
+	{
+		long long llEnd = (iFrame + 1 < m_asFrames.size()) ? m_asFrames[iFrame + 1].llOut : sHeader.llUncompressedSize;
+		m_asFrames[iFrame].llOutSize = llEnd - m_asFrames[iFrame].llOut;
+	}
+
+	m_llSize = sHeader.llUncompressedSize;
+
+	return( true );
+}
+
+/*!
+*   \brief Save the access point index next to the .gz (best effort; written to a temporary name, then renamed).
+*/
+
+void CGzipBufEDF::vSaveIndex( const string &sIndexFile, long long llSourceSize, long long llSourceTime )
+{
+	string sTemporaryFile = sIndexFile + ".tmp";
+	ofstream oIndex( sTemporaryFile.c_str(), ios::out | ios::binary | ios::trunc );
+	gzipIndexHeader_S sHeader;
+
+	if( oIndex.fail() )
+	{
+		return;			// read-only directory: the index is rebuilt on the next open
+	}
+
+	memcpy( sHeader.acMagic, "EDFGZI01", 8 );
+	sHeader.llSourceSize = llSourceSize;
+	sHeader.llSourceTime = llSourceTime;
+	sHeader.llUncompressedSize = m_llSize;
+	sHeader.llNumberFrames = (long long)m_asFrames.size();
+	oIndex.write( (const char *)&sHeader, sizeof(sHeader) );
+
+	for( size_t iFrame = 0; iFrame < m_asFrames.size(); iFrame++ )
+	{
+		const frame_S &sFrame = m_asFrames[iFrame];
+		gzipIndexEntry_S sEntry;
+
+		memset( &sEntry, 0, sizeof(sEntry) );
+		sEntry.llOut = sFrame.llOut;
+		sEntry.llIn = sFrame.llIn;
+		sEntry.iBits = sFrame.iBits;
+		sEntry.iWindowSize = (int)sFrame.acWindow.size();
+		oIndex.write( (const char *)&sEntry, sizeof(sEntry) );
+
+		if( !sFrame.acWindow.empty() )
+		{
+			oIndex.write( (const char *)&sFrame.acWindow[0], sFrame.acWindow.size() );
+		}
+	}
+
+	oIndex.close();
+
+	if( oIndex.fail() || rename( sTemporaryFile.c_str(), sIndexFile.c_str() ) != 0 )
+	{
+		remove( sTemporaryFile.c_str() );
+	}
+}
+
+/*!
+*   \brief Inflate one frame: raw deflate from its access point, primed with the leftover bits and the window.
+*/
+
+bool CGzipBufEDF::bDecodeFrame( ifstream &oInput, size_t iFrame, char *pcOut )
+{
+	const frame_S &sFrame = m_asFrames[iFrame];
+	unsigned char acInput[1 << 14];
+	bool bDecoded = false;
+	z_stream sStream;
+
+	memset( &sStream, 0, sizeof(sStream) );
+	if( inflateInit2( &sStream, -15 ) != Z_OK )
+	{
+		return( false );
+	}
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		oInput.clear();
+		oInput.seekg( (streamoff)(sFrame.llIn - (sFrame.iBits ? 1 : 0)) );
+
+		if( sFrame.iBits )
+		{
+			int iByte = oInput.get();
+
+			if( iByte == EOF )
+			{
+				break;
+			}
+
+			inflatePrime( &sStream, sFrame.iBits, iByte >> (8 - sFrame.iBits) );
+		}
+
+		if( !sFrame.acWindow.empty() )
+		{
+			inflateSetDictionary( &sStream, &sFrame.acWindow[0], (uInt)sFrame.acWindow.size() );
+		}
+
+		sStream.next_out = (Bytef *)pcOut;
+		sStream.avail_out = (uInt)sFrame.llOutSize;
+
+		int iResult = Z_OK;
+
+		while( sStream.avail_out > 0 && iResult == Z_OK )
+		{
+			if( sStream.avail_in == 0 )
+			{
+				oInput.read( (char *)acInput, sizeof(acInput) );
+				sStream.avail_in = (uInt)oInput.gcount();
+				sStream.next_in = acInput;
+
+				if( sStream.avail_in == 0 )
+				{
+					break;
+				}
+			}
+
+			iResult = inflate( &sStream, Z_NO_FLUSH );
+		}
+
+		bDecoded = (sStream.avail_out == 0);
+	} //for()
+
+	inflateEnd( &sStream );
+
+	return( bDecoded );
+}
+
+#endif // EDF_WITH_ZLIB
+
+#if defined(EDF_WITH_ZSTD)
+
+//! \brief Little endian 32 bit value.
+static unsigned int iReadLittleEndian32( const unsigned char *pcBytes )
+{
+	return( pcBytes[0] | (pcBytes[1] << 8) | (pcBytes[2] << 16) | ((unsigned int)pcBytes[3] << 24) );
+}
+
+/*!
+*   \brief Constructor - read the seek table.
+*   \param pszInputFile - seekable .zst file
+*   \param iNumberThreads - decoding threads for large reads (0 = one per hardware thread)
+*   \param peEdfStatus - loaded with the status if not null
+*/
+
+CZstdBufEDF::CZstdBufEDF( const char *pszInputFile, int iNumberThreads, CReadEDF::edfStatus_E *peEdfStatus )
+	: CCompressedBufEDF( pszInputFile, iNumberThreads )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+
+	if( !m_oInput.fail() )
+	{
+		eEdfStatus = bReadSeekTable() ? CReadEDF::EDF_SUCCESS : CReadEDF::EDF_FILE_CONTENTS_ERROR;
+	}
+
+	if( peEdfStatus != NULL )
+	{
+		*peEdfStatus = eEdfStatus;
+	}
+}
+
+/*!
+*   \brief Read the seek table (a skippable frame at the end of the file) into frames.
+*   \return false if the file has no valid seek table.
+*/
+
+bool CZstdBufEDF::bReadSeekTable( void )
+{
+	enum
+	{
+		SEEK_TABLE_MAGIC = 0x8F92EAB1,
+		SKIPPABLE_MAGIC = 0x184D2A5E,
+		FOOTER_SIZE = 9,
+		SKIPPABLE_HEADER_SIZE = 8,
+	};
+
+	unsigned char acFooter[FOOTER_SIZE];
+	long long llFileSize;
+
+	m_oInput.clear();
+	m_oInput.seekg( 0, ios::end );
+	llFileSize = (long long)m_oInput.tellg();
+
+	if( llFileSize < FOOTER_SIZE + SKIPPABLE_HEADER_SIZE )
+	{
+		return( false );
+	}
+
+	m_oInput.seekg( (streamoff)(llFileSize - FOOTER_SIZE) );
+	m_oInput.read( (char *)acFooter, FOOTER_SIZE );
+
+	if( m_oInput.fail() || iReadLittleEndian32( &acFooter[5] ) != SEEK_TABLE_MAGIC || (acFooter[4] & 0x7C) != 0 )
+	{
+		return( false );
+	}
+
+	long long llNumberFrames = iReadLittleEndian32( &acFooter[0] );
+	int iEntrySize = (acFooter[4] & 0x80) ? 12 : 8;		// with or without a checksum per entry
+	long long llTableSize = llNumberFrames * iEntrySize;
+	long long llTableStart = llFileSize - FOOTER_SIZE - llTableSize;
+
+	if( llNumberFrames == 0 || llTableStart - SKIPPABLE_HEADER_SIZE < 0 )
+	{
+		return( false );
+	}
+
+	vector<unsigned char> acTable( (size_t)(SKIPPABLE_HEADER_SIZE + llTableSize) );
+
+	m_oInput.seekg( (streamoff)(llTableStart - SKIPPABLE_HEADER_SIZE) );
+	m_oInput.read( (char *)&acTable[0], acTable.size() );
+
+	if( m_oInput.fail() || iReadLittleEndian32( &acTable[0] ) != SKIPPABLE_MAGIC
+		|| iReadLittleEndian32( &acTable[4] ) != llTableSize + FOOTER_SIZE )
+	{
+		return( false );
+	}
+
+	long long llIn = 0;
+	long long llOut = 0;
+
+	m_asFrames.resize( (size_t)llNumberFrames );
+
+	for( size_t iFrame = 0; iFrame < m_asFrames.size(); iFrame++ )
+	{
+		const unsigned char *pcEntry = &acTable[SKIPPABLE_HEADER_SIZE + iFrame * iEntrySize];
+		frame_S &sFrame = m_asFrames[iFrame];
+
+		sFrame.llIn = llIn;
+		sFrame.llInSize = iReadLittleEndian32( &pcEntry[0] );
+		sFrame.llOut = llOut;
+		sFrame.llOutSize = iReadLittleEndian32( &pcEntry[4] );
+		sFrame.iBits = 0;
+
+		llIn += sFrame.llInSize;
+		llOut += sFrame.llOutSize;
+	}
+
+	// Zero length frames can not be found by offset; drop them:
+	m_asFrames.erase( remove_if( m_asFrames.begin(), m_asFrames.end(),
+		[]( const frame_S &sFrame ) { return( sFrame.llOutSize == 0 ); } ), m_asFrames.end() );
+
+	m_llSize = llOut;
+
+	return( llIn <= llTableStart - SKIPPABLE_HEADER_SIZE && !m_asFrames.empty() );
+}
+
+/*!
+*   \brief Decompress one zstd frame.
+*/
+
+bool CZstdBufEDF::bDecodeFrame( ifstream &oInput, size_t iFrame, char *pcOut )
+{
+	const frame_S &sFrame = m_asFrames[iFrame];
+	vector<char> acInput( (size_t)sFrame.llInSize );
+
+	oInput.clear();
+	oInput.seekg( (streamoff)sFrame.llIn );
+	oInput.read( &acInput[0], acInput.size() );
+
+	if( oInput.fail() )
+	{
+		return( false );
+	}
+
+	ZSTD_DCtx *psContext = ZSTD_createDCtx();
+	size_t iResult = ZSTD_decompressDCtx( psContext, pcOut, (size_t)sFrame.llOutSize, &acInput[0], acInput.size() );
+	ZSTD_freeDCtx( psContext );
+
+	return( !ZSTD_isError( iResult ) && iResult == (size_t)sFrame.llOutSize );
+}
+
+#endif // EDF_WITH_ZSTD
+
+/*!
+*   \brief Constructor - the stream takes ownership of the buffer.
+*/
+
+CCompressedStreamEDF::CCompressedStreamEDF( CCompressedBufEDF *poBuffer ) : istream( poBuffer )
+{
+	m_poBuffer = poBuffer;
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CCompressedStreamEDF::~CCompressedStreamEDF( void )
+{
+	delete m_poBuffer;
+}
+
+/*!
+*   \brief Open a plain, gzip or zstd EDF file (detected from its first bytes) for CReadEDF access.
+*   \param pszInputFile - input file
+*   \param peEdfStatus - loaded with the open status if not null
+*   \param iNumberThreads - decoding threads for large reads of compressed files (0 = one per hardware thread)
+*   \return Reader (delete when done); check bReadyStatus() before use.
+*/
+
+CReadEDF *CCompressedStreamEDF::poOpenEDF( const char *pszInputFile, CReadEDF::edfStatus_E *peEdfStatus, int iNumberThreads )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	CCompressedBufEDF *poBuffer = NULL;
+	unsigned char acMagic[4] = { 0, 0, 0, 0 };
+	string sInputFile( (pszInputFile != NULL) ? pszInputFile : "" );
+
+	{
+		ifstream oInput( sInputFile.c_str(), ios::in | ios::binary );
+		oInput.read( (char *)acMagic, sizeof(acMagic) );
+	}
+
+	bool bGzip = (acMagic[0] == 0x1f && acMagic[1] == 0x8b);
+	bool bZstd = (acMagic[0] == 0x28 && acMagic[1] == 0xb5 && acMagic[2] == 0x2f && acMagic[3] == 0xfd);
+
+	if( !bGzip && !bZstd )
+	{
+		return( new CReadEDF( &sInputFile[0], peEdfStatus ) );
+	}
+
+#if defined(EDF_WITH_ZLIB)
+	if( bGzip )
+	{
+		poBuffer = new CGzipBufEDF( sInputFile.c_str(), iNumberThreads, &eEdfStatus );
+	}
+#endif
+
+#if defined(EDF_WITH_ZSTD)
+	if( bZstd )
+	{
+		poBuffer = new CZstdBufEDF( sInputFile.c_str(), iNumberThreads, &eEdfStatus );
+	}
+#endif
+
+#if !defined(EDF_WITH_ZLIB) && !defined(EDF_WITH_ZSTD)
+	(void)iNumberThreads;			// no decoder built in: compressed files fail below
+#endif
+
+	if( poBuffer == NULL || eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		delete poBuffer;
+
+		CReadEDF *poEDF = new CReadEDF( (istream *)NULL );	// not ready
+
+		if( peEdfStatus != NULL )
+		{
+			*peEdfStatus = eEdfStatus;
+		}
+
+		return( poEDF );
+	}
+
+	return( new CReadEDF( new CCompressedStreamEDF( poBuffer ), peEdfStatus, true ) );
+}
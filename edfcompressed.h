@@ -0,0 +1,180 @@
+#ifndef EDFCOMPRESSED_H
+#define EDFCOMPRESSED_H
+
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definitions for reading gzip and zstd compressed EDF files with random access.
+	\note Build with EDF_WITH_ZLIB (link zlib) for .edf.gz and EDF_WITH_ZSTD (link libzstd) for .edf.zst;
+	      without them, compressed files are reported as EDF_FILE_OPEN_ERROR and plain files still open.
+*/
+
+/*! \class CCompressedBufEDF
+    \brief Seekable read-only stream buffer over a compressed file split into independently decodable frames.
+
+	A frame is a range of the uncompressed file that can be decoded on its own: the data between
+	two gzip access points (zran style: compressed bit offset plus the preceding 32 KiB window), or
+	one zstd frame of a seekable zstd file. A seek only records the target; the frame holding it is
+	decoded when data is read, so a random sample read decodes one frame. The last FRAME_CACHE
+	frames are kept. Reads that cover several whole frames decode them in parallel, straight into
+	the caller's buffer, with one input file handle per thread.
+*/
+
+class CCompressedBufEDF : public streambuf
+{
+	public:
+
+	enum compressedConstants_E
+	{
+		FRAME_CACHE = 4,				///< decoded frames kept for re-reads
+		PARALLEL_FRAMES = 2,			///< whole frames a read must cover before it is decoded in parallel
+	};
+
+	CCompressedBufEDF( const char *pszInputFile, int iNumberThreads );
+	virtual ~CCompressedBufEDF( void );
+
+	//! \brief Return the uncompressed size in bytes.
+	long long llGetSize( void )
+	{
+		return( m_llSize );
+	};
+
+	//! \brief Return the number of independently decodable frames.
+	size_t iGetNumberFrames( void )
+	{
+		return( m_asFrames.size() );
+	};
+
+	protected:
+
+	//! \brief One independently decodable range of the uncompressed data.
+	struct frame_S
+	{
+		long long llOut;				///< uncompressed offset
+		long long llOutSize;			///< uncompressed bytes
+		long long llIn;					///< compressed offset (gzip: byte holding the first bit)
+		long long llInSize;				///< compressed bytes (zstd only)
+		int iBits;						///< gzip: bits of the byte at llIn that belong to the previous block
+		vector<unsigned char> acWindow;	///< gzip: dictionary (up to 32 KiB of preceding output)
+	};
+
+	//! \brief Decode frame iFrame (exactly llOutSize bytes) into pcOut; must be thread safe.
+	virtual bool bDecodeFrame( ifstream &oInput, size_t iFrame, char *pcOut ) = 0;
+
+	// streambuf interface:
+	virtual int_type underflow( void );
+	virtual streamsize xsgetn( char *pcOut, streamsize iCount );
+	virtual pos_type seekoff( off_type llOffset, ios_base::seekdir eDirection, ios_base::openmode eMode );
+	virtual pos_type seekpos( pos_type llPosition, ios_base::openmode eMode );
+
+	string m_sInputFile;
+	ifstream m_oInput;					///< used by the single threaded path (underflow)
+	int m_iNumberThreads;
+	long long m_llSize;
+	vector<frame_S> m_asFrames;			///< in uncompressed order, contiguous
+
+	private:
+
+	struct cachedFrame_S
+	{
+		size_t iFrame;
+		vector<char> acData;
+	};
+
+	size_t iFindFrame( long long llOffset );
+	bool bLoadFrame( size_t iFrame );
+	bool bDecodeParallel( size_t iFirstFrame, size_t iNumberFrames, char *pcOut );
+
+	long long m_llPosition;				///< position when the get area is empty
+	long long m_llFrameBase;			///< uncompressed offset of the get area
+	vector<cachedFrame_S> m_asCache;	///< most recently used last
+}; //class CCompressedBufEDF
+
+#if defined(EDF_WITH_ZLIB)
+
+/*! \class CGzipBufEDF
+    \brief gzip (and zlib, multi-member gzip) input with an access point index.
+
+	The index is built by one inflate pass on the first open and saved next to the file as
+	"<file>.gzi" (ignored and rebuilt when the .gz size or modification time changes; not saved if
+	the directory is read-only). Access points are INDEX_SPAN uncompressed bytes apart.
+*/
+
+class CGzipBufEDF : public CCompressedBufEDF
+{
+	public:
+
+	enum gzipConstants_E
+	{
+		INDEX_SPAN = 1 << 20,			///< uncompressed bytes between access points
+		WINDOW_SIZE = 32768,			///< deflate window (dictionary) size
+	};
+
+	CGzipBufEDF( const char *pszInputFile, int iNumberThreads, CReadEDF::edfStatus_E *peEdfStatus = NULL );
+
+	protected:
+	virtual bool bDecodeFrame( ifstream &oInput, size_t iFrame, char *pcOut );
+
+	private:
+	bool bLoadIndex( const string &sIndexFile, long long llSourceSize, long long llSourceTime );
+	void vSaveIndex( const string &sIndexFile, long long llSourceSize, long long llSourceTime );
+	bool bBuildIndex( void );
+}; //class CGzipBufEDF
+
+#endif // EDF_WITH_ZLIB
+
+#if defined(EDF_WITH_ZSTD)
+
+/*! \class CZstdBufEDF
+    \brief zstd input in the seekable format (independent frames plus a trailing seek table).
+
+	Files written by the zstd seekable format tools (contrib/seekable_format) carry the table; a
+	plain single-stream .zst has none and is reported as EDF_FILE_CONTENTS_ERROR.
+*/
+
+class CZstdBufEDF : public CCompressedBufEDF
+{
+	public:
+
+	CZstdBufEDF( const char *pszInputFile, int iNumberThreads, CReadEDF::edfStatus_E *peEdfStatus = NULL );
+
+	protected:
+	virtual bool bDecodeFrame( ifstream &oInput, size_t iFrame, char *pcOut );
+
+	private:
+	bool bReadSeekTable( void );
+}; //class CZstdBufEDF
+
+#endif // EDF_WITH_ZSTD
+
+/*! \class CCompressedStreamEDF
+    \brief istream that owns its CCompressedBufEDF; poOpenEDF() opens plain or compressed EDF files alike.
+
+	\code
+	CReadEDF *poEDF = CCompressedStreamEDF::poOpenEDF( "night.edf.gz", &eEdfStatus );
+	poEDF->eReadRecords( 1000, 30, psRecords );		// decodes only the frames holding records 1000..1029
+	delete poEDF;
+	\endcode
+*/
+
+class CCompressedStreamEDF : public istream
+{
+	public:
+
+	CCompressedStreamEDF( CCompressedBufEDF *poBuffer );
+	virtual ~CCompressedStreamEDF( void );
+
+	static CReadEDF *poOpenEDF( const char *pszInputFile, CReadEDF::edfStatus_E *peEdfStatus = NULL, int iNumberThreads = 0 );
+
+	private:
+	CCompressedBufEDF *m_poBuffer;
+}; //class CCompressedStreamEDF
+
+#endif // EDFCOMPRESSED_H
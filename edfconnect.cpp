@@ -0,0 +1,725 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for epoch-wise channel-by-channel connectivity (correlation and coherence) of EDF data.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <thread>
+#include "edfconnect.h"
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EDF_CONNECT_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*!
+*   \brief Micro kernel: the 4 x 2 dot products of rows A0..A3 with rows B0, B1 over iLength values.
+*	\note afSums is [row * 2 + column]; every loaded value is used two (A) or four (B) times.
+*/
+
+static void vDot4x2( const float *pfA0, const float *pfA1, const float *pfA2, const float *pfA3,
+					 const float *pfB0, const float *pfB1, int iLength, float afSums[8] )
+{
+	int i = 0;
+
+#ifdef EDF_CONNECT_SSE2
+	__m128 x00 = _mm_setzero_ps(), x01 = _mm_setzero_ps();
+	__m128 x10 = _mm_setzero_ps(), x11 = _mm_setzero_ps();
+	__m128 x20 = _mm_setzero_ps(), x21 = _mm_setzero_ps();
+	__m128 x30 = _mm_setzero_ps(), x31 = _mm_setzero_ps();
+
+	for( ; i + 4 <= iLength; i += 4 )
+	{
+		__m128 xB0 = _mm_loadu_ps( &pfB0[i] );
+		__m128 xB1 = _mm_loadu_ps( &pfB1[i] );
+		__m128 xA = _mm_loadu_ps( &pfA0[i] );
+
+		x00 = _mm_add_ps( x00, _mm_mul_ps( xA, xB0 ) );
+		x01 = _mm_add_ps( x01, _mm_mul_ps( xA, xB1 ) );
+		xA = _mm_loadu_ps( &pfA1[i] );
+		x10 = _mm_add_ps( x10, _mm_mul_ps( xA, xB0 ) );
+		x11 = _mm_add_ps( x11, _mm_mul_ps( xA, xB1 ) );
+		xA = _mm_loadu_ps( &pfA2[i] );
+		x20 = _mm_add_ps( x20, _mm_mul_ps( xA, xB0 ) );
+		x21 = _mm_add_ps( x21, _mm_mul_ps( xA, xB1 ) );
+		xA = _mm_loadu_ps( &pfA3[i] );
+		x30 = _mm_add_ps( x30, _mm_mul_ps( xA, xB0 ) );
+		x31 = _mm_add_ps( x31, _mm_mul_ps( xA, xB1 ) );
+	}
+
+	__m128 axSums[8] = { x00, x01, x10, x11, x20, x21, x30, x31 };
+
+	for( int k = 0; k < 8; k++ )
+	{
+		float afLanes[4];
+
+		_mm_storeu_ps( afLanes, axSums[k] );
+		afSums[k] = (afLanes[0] + afLanes[1]) + (afLanes[2] + afLanes[3]);
+	}
+#else
+	fill( afSums, afSums + 8, 0.0f );
+#endif
+
+	for( ; i < iLength; i++ )
+	{
+		afSums[0] += pfA0[i] * pfB0[i];
+		afSums[1] += pfA0[i] * pfB1[i];
+		afSums[2] += pfA1[i] * pfB0[i];
+		afSums[3] += pfA1[i] * pfB1[i];
+		afSums[4] += pfA2[i] * pfB0[i];
+		afSums[5] += pfA2[i] * pfB1[i];
+		afSums[6] += pfA3[i] * pfB0[i];
+		afSums[7] += pfA3[i] * pfB1[i];
+	}
+}
+
+/*!
+*   \brief Accumulate all dot products between rows [iRow0, iRow1) and [iColumn0, iColumn1) of two row
+*	       sets over values [iFirst, iFirst + iLength), TIME_BLOCK values at a time.
+*	\note adSums is [(row - iRow0) * TILE_CHANNELS + (column - iColumn0)]; only columns >= rows are
+*	      needed when both tiles are the same (bSymmetric).
+*/
+
+static void vAccumulateTile( const float *pfRows, const float *pfColumns, int iStride, int iRow0, int iRow1,
+							 int iColumn0, int iColumn1, int iFirst, int iLength, bool bSymmetric, double *adSums )
+{
+	const int iTile = CConnectivityEDF::TILE_CHANNELS;
+
+	for( int iBlock = iFirst; iBlock < iFirst + iLength; iBlock += CConnectivityEDF::TIME_BLOCK )
+	{
+		int iBlockLength = min( (int)CConnectivityEDF::TIME_BLOCK, iFirst + iLength - iBlock );
+
+		for( int iRow = iRow0; iRow < iRow1; iRow += 4 )
+		{
+			// Short row groups repeat their last row; the duplicate sums are dropped:
+			const float *apfA[4];
+
+			for( int k = 0; k < 4; k++ )
+			{
+				apfA[k] = &pfRows[(size_t)min( iRow + k, iRow1 - 1 ) * iStride + iBlock];
+			}
+
+			int iStartColumn = bSymmetric ? iColumn0 + ((iRow - iRow0) & ~1) : iColumn0;
+
+			for( int iColumn = iStartColumn; iColumn < iColumn1; iColumn += 2 )
+			{
+				const float *pfB0 = &pfColumns[(size_t)iColumn * iStride + iBlock];
+				const float *pfB1 = &pfColumns[(size_t)min( iColumn + 1, iColumn1 - 1 ) * iStride + iBlock];
+				float afSums[8];
+
+				vDot4x2( apfA[0], apfA[1], apfA[2], apfA[3], pfB0, pfB1, iBlockLength, afSums );
+
+				for( int k = 0; k < 4 && iRow + k < iRow1; k++ )
+				{
+					double *pdRow = &adSums[(size_t)(iRow + k - iRow0) * iTile + (iColumn - iColumn0)];
+
+					pdRow[0] += afSums[2 * k];
+					if( iColumn + 1 < iColumn1 )
+					{
+						pdRow[1] += afSums[2 * k + 1];
+					}
+				}
+			}
+		}
+	}
+}
+
+/*!
+*   \brief Constructor - read the header; by default the channels are the signals sharing the most
+*	       common number of samples per record (e.g. all EEG channels of a PSG).
+*	\note Epochs are rounded to a whole number of data records; a partial last epoch is dropped.
+*   \param pszInputFile - input file (each worker thread opens its own reader on it)
+*   \param dEpochSeconds - epoch length in seconds
+*   \param dSegmentSeconds - coherence segment length in seconds (rounded down to a power of two samples)
+*   \param iNumberThreads - worker threads (0 = one per hardware thread)
+*/
+
+CConnectivityEDF::CConnectivityEDF( char *pszInputFile, double dEpochSeconds, double dSegmentSeconds, int iNumberThreads )
+{
+	m_pszInputFile = new char[strlen( pszInputFile ) + 1];
+	strcpy( m_pszInputFile, pszInputFile );
+
+	m_dEpochSeconds = dEpochSeconds;
+	m_dSegmentSeconds = dSegmentSeconds;
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+	m_iRecordsPerEpoch = 0;
+	m_iNumberEpochs = 0;
+	m_iEpochSamples = 0;
+	m_iSeriesStride = 0;
+	m_iSegmentSize = 0;
+	m_iNumberSegments = 0;
+	m_iSpectrumStride = 0;
+
+	m_poEDF = new CReadEDF( m_pszInputFile );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		long long llNumberRecords = 0;
+		int iNumberSignals = 0;
+
+		if( !m_poEDF->bReadyStatus() || m_poEDF->dGetRecordDuration() <= 0.0 )
+		{
+			break;
+		}
+
+		m_poEDF->eGetNumberSignals( &iNumberSignals );
+		m_poEDF->eGetNumberRecords( &llNumberRecords );
+
+		m_iRecordsPerEpoch = max( 1, (int)floor( dEpochSeconds / m_poEDF->dGetRecordDuration() + 0.5 ) );
+		m_iNumberEpochs = (int)max( 0LL, llNumberRecords / m_iRecordsPerEpoch );
+
+		map<int, int> oCounts;
+		int iBestSamples = 0;
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			int iSamples = m_poEDF->iGetNumberSamples( iThisSignal );
+			int iCount = ++oCounts[iSamples];
+
+			if( iSamples > 1 && (iCount > oCounts[iBestSamples] || (iCount == oCounts[iBestSamples] && iSamples > iBestSamples)) )
+			{
+				iBestSamples = iSamples;
+			}
+		}
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals && iBestSamples > 0; iThisSignal++ )
+		{
+			if( m_poEDF->iGetNumberSamples( iThisSignal ) == iBestSamples )
+			{
+				m_aiSignals.push_back( iThisSignal );
+			}
+		}
+	} //for()
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CConnectivityEDF::~CConnectivityEDF( void )
+{
+	delete m_poEDF;
+	delete [] m_pszInputFile;
+}
+
+/*!
+*   \brief Choose the matrix channels (all must have the same sample rate).
+*   \param piSignals - signal numbers, in matrix row order
+*   \param iNumberSignals - number of signals
+*   \return Status of operation (the selection is unchanged on failure).
+*/
+
+CReadEDF::edfStatus_E CConnectivityEDF::eSelectSignals( const int *piSignals, int iNumberSignals )
+{
+	int iNumberFileSignals = 0;
+
+	if( !m_poEDF->bReadyStatus() )
+	{
+		return( CReadEDF::EDF_FILE_CONTENTS_ERROR );
+	}
+
+	if( piSignals == NULL || iNumberSignals <= 0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	m_poEDF->eGetNumberSignals( &iNumberFileSignals );
+
+	for( int i = 0; i < iNumberSignals; i++ )
+	{
+		if( piSignals[i] < 0 || piSignals[i] >= iNumberFileSignals )
+		{
+			return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+		}
+
+		if( m_poEDF->iGetNumberSamples( piSignals[i] ) != m_poEDF->iGetNumberSamples( piSignals[0] ) )
+		{
+			return( CReadEDF::EDF_INVALID_PARAMETER );
+		}
+	}
+
+	m_aiSignals.assign( piSignals, piSignals + iNumberSignals );
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add a frequency band for the coherence results.
+*	\note Without any added bands eRun() uses delta, theta, alpha and beta (0.5-4-8-13-30 Hz).
+*   \param dLow - lower band edge in Hz (inclusive)
+*   \param dHigh - upper band edge in Hz (exclusive)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CConnectivityEDF::eAddBand( double dLow, double dHigh )
+{
+	if( dLow < 0.0 || dHigh <= dLow )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	CSpectralEDF::band_S sBand = { dLow, dHigh };
+	m_asBands.push_back( sBand );
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Lay out the epoch rows: series stride, segment size, window and packed band bins.
+*/
+
+void CConnectivityEDF::vPlanRun( void )
+{
+	double dSampleRate = m_poEDF->dGetSampleRate( m_aiSignals[0] );
+
+	m_iEpochSamples = m_poEDF->iGetNumberSamples( m_aiSignals[0] ) * m_iRecordsPerEpoch;
+	m_iSeriesStride = (m_iEpochSamples + 15) & ~15;
+
+	// Largest power of two that fits both the segment length and the epoch:
+	m_iSegmentSize = 1;
+	while( m_iSegmentSize * 2 <= dSampleRate * m_dSegmentSeconds && m_iSegmentSize * 2 <= m_iEpochSamples )
+	{
+		m_iSegmentSize *= 2;
+	}
+
+	int iHop = max( 1, m_iSegmentSize / 2 );
+	double dBinWidth = dSampleRate / m_iSegmentSize;
+
+	m_iNumberSegments = (m_iEpochSamples >= m_iSegmentSize) ? (m_iEpochSamples - m_iSegmentSize) / iHop + 1 : 0;
+
+	m_aoPlans.clear();
+	m_aoPlans.push_back( CFftPlan( m_iSegmentSize ) );
+
+	// Periodic Hann window:
+	m_adWindow.resize( m_iSegmentSize );
+	for( int i = 0; i < m_iSegmentSize; i++ )
+	{
+		m_adWindow[i] = 0.5 - 0.5 * cos( 2.0 * M_PI * i / m_iSegmentSize );
+	}
+
+	// Bins of every band, packed one band after the other, segment by segment:
+	int iOffset = 0;
+
+	m_aiBandFirstBins.resize( m_asBands.size() );
+	m_aiBandNumberBins.resize( m_asBands.size() );
+	m_aiBandOffsets.resize( m_asBands.size() );
+
+	for( size_t iBand = 0; iBand < m_asBands.size(); iBand++ )
+	{
+		int iFirst = (int)ceil( m_asBands[iBand].dLow / dBinWidth );
+		int iEnd = iFirst;
+
+		while( iEnd <= m_iSegmentSize / 2 && iEnd * dBinWidth < m_asBands[iBand].dHigh )
+		{
+			iEnd++;
+		}
+
+		m_aiBandFirstBins[iBand] = iFirst;
+		m_aiBandNumberBins[iBand] = max( 0, iEnd - iFirst );
+		m_aiBandOffsets[iBand] = iOffset;
+		iOffset += m_aiBandNumberBins[iBand] * m_iNumberSegments;
+	}
+
+	m_iSpectrumStride = (iOffset + 15) & ~15;
+}
+
+/*!
+*   \brief Read one epoch and prepare its rows: z-scored series and packed band spectra of every channel.
+*   \param sWorker - reader and scratch of the calling thread
+*   \param sData - loaded with the epoch rows
+*   \param sResult - loaded with the epoch number, start time and read status; matrices set to NaN
+*   \param iEpoch - epoch number
+*   \param bCoherence - also prepare the spectra
+*/
+
+void CConnectivityEDF::vPrepareEpoch( worker_S &sWorker, epochData_S &sData, epochResult_S &sResult, int iEpoch, bool bCoherence )
+{
+	int iNumberChannels = (int)m_aiSignals.size();
+	int iNumberBands = (int)m_asBands.size();
+	int iSamplesPerRecord = sWorker.poEDF->iGetSamplesPerRecord();
+	int iNumberSamples = sWorker.poEDF->iGetNumberSamples( m_aiSignals[0] );
+	float fNaN = numeric_limits<float>::quiet_NaN();
+
+	sResult.iEpoch = iEpoch;
+	sResult.dStartTime = (double)iEpoch * m_iRecordsPerEpoch * sWorker.poEDF->dGetRecordDuration();
+	sResult.afCorrelation.assign( (size_t)iNumberChannels * iNumberChannels, fNaN );
+	sResult.afCoherence.assign( bCoherence ? (size_t)iNumberBands * iNumberChannels * iNumberChannels : 0, fNaN );
+
+	sResult.eEdfStatus = sWorker.poEDF->eReadRecords( (long long)iEpoch * m_iRecordsPerEpoch, m_iRecordsPerEpoch, &sWorker.asRecords[0] );
+	if( sResult.eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		return;
+	}
+
+	sData.afSeries.resize( (size_t)iNumberChannels * m_iSeriesStride );
+	sData.abValid.resize( iNumberChannels );
+
+	if( bCoherence )
+	{
+		sData.afReal.resize( (size_t)iNumberChannels * m_iSpectrumStride );
+		sData.afImaginary.resize( (size_t)iNumberChannels * m_iSpectrumStride );
+		sData.adAutoSpectra.assign( (size_t)iNumberChannels * iNumberBands, 0.0 );
+	}
+
+	for( int iChannel = 0; iChannel < iNumberChannels; iChannel++ )
+	{
+		int iSignal = m_aiSignals[iChannel];
+		int iOffset = sWorker.poEDF->iGetSignalOffset( iSignal );
+		double dGain = 1.0;
+		double dOffset = 0.0;
+		double *pdSignal = &sWorker.adSignal[0];
+		float *pfSeries = &sData.afSeries[(size_t)iChannel * m_iSeriesStride];
+
+		sWorker.poEDF->eGetCalibration( iSignal, &dGain, &dOffset );
+
+		// Gather the calibrated samples of this channel from all records of the epoch:
+		for( int iRecord = 0; iRecord < m_iRecordsPerEpoch; iRecord++ )
+		{
+			const short int *psSegment = &sWorker.asRecords[(size_t)iRecord * iSamplesPerRecord + iOffset];
+
+			for( int i = 0; i < iNumberSamples; i++ )
+			{
+				pdSignal[iRecord * iNumberSamples + i] = dGain * psSegment[i] + dOffset;
+			}
+		}
+
+		// Z-score to unit length, so a row dot product is the Pearson correlation:
+		double dMean = 0.0;
+		double dSumSquares = 0.0;
+		bool bFlat = true;
+
+		for( int i = 0; i < m_iEpochSamples; i++ )
+		{
+			dMean += pdSignal[i];
+			bFlat = bFlat && (pdSignal[i] == pdSignal[0]);
+		}
+		dMean /= m_iEpochSamples;
+
+		for( int i = 0; i < m_iEpochSamples; i++ )
+		{
+			dSumSquares += (pdSignal[i] - dMean) * (pdSignal[i] - dMean);
+		}
+
+		// A constant channel has no correlation or coherence (its rounding residue is not a signal):
+		double dScale = (!bFlat && dSumSquares > 0.0) ? 1.0 / sqrt( dSumSquares ) : 0.0;
+
+		sData.abValid[iChannel] = (dScale > 0.0);
+
+		for( int i = 0; i < m_iEpochSamples; i++ )
+		{
+			pfSeries[i] = (float)((pdSignal[i] - dMean) * dScale);
+		}
+
+		fill( pfSeries + m_iEpochSamples, pfSeries + m_iSeriesStride, 0.0f );
+
+		if( !bCoherence )
+		{
+			continue;
+		}
+
+		float *pfReal = &sData.afReal[(size_t)iChannel * m_iSpectrumStride];
+		float *pfImaginary = &sData.afImaginary[(size_t)iChannel * m_iSpectrumStride];
+		double *pdAutoSpectra = &sData.adAutoSpectra[(size_t)iChannel * iNumberBands];
+		int iHop = max( 1, m_iSegmentSize / 2 );
+
+		fill( pfReal, pfReal + m_iSpectrumStride, 0.0f );
+		fill( pfImaginary, pfImaginary + m_iSpectrumStride, 0.0f );
+
+		for( int iSegment = 0; iSegment < m_iNumberSegments; iSegment++ )
+		{
+			const double *pdSegment = &pdSignal[iSegment * iHop];
+			double dSegmentMean = 0.0;
+
+			for( int i = 0; i < m_iSegmentSize; i++ )
+			{
+				dSegmentMean += pdSegment[i];
+			}
+			dSegmentMean /= m_iSegmentSize;
+
+			for( int i = 0; i < m_iSegmentSize; i++ )
+			{
+				sWorker.adReal[i] = (pdSegment[i] - dSegmentMean) * m_adWindow[i];
+				sWorker.adImaginary[i] = 0.0;
+			}
+
+			m_aoPlans[0].vForward( &sWorker.adReal[0], &sWorker.adImaginary[0] );
+
+			for( int iBand = 0; iBand < iNumberBands; iBand++ )
+			{
+				int iPacked = m_aiBandOffsets[iBand] + iSegment * m_aiBandNumberBins[iBand];
+
+				for( int k = 0; k < m_aiBandNumberBins[iBand]; k++ )
+				{
+					double dReal = sWorker.adReal[m_aiBandFirstBins[iBand] + k];
+					double dImaginary = sWorker.adImaginary[m_aiBandFirstBins[iBand] + k];
+
+					pfReal[iPacked + k] = (float)dReal;
+					pfImaginary[iPacked + k] = (float)dImaginary;
+					pdAutoSpectra[iBand] += dReal * dReal + dImaginary * dImaginary;
+				}
+			}
+		}
+	}
+}
+
+/*!
+*   \brief Compute the correlation (and coherence) entries of one tile pair of one epoch.
+*	\note Tile pairs write disjoint matrix entries (both triangles), so they can run concurrently.
+*   \param sData - prepared epoch rows
+*   \param sResult - matrices to fill
+*   \param iRowTile - row tile number
+*   \param iColumnTile - column tile number (>= iRowTile)
+*   \param bCoherence - also compute the band coherence
+*/
+
+void CConnectivityEDF::vProcessTile( const epochData_S &sData, epochResult_S &sResult, int iRowTile, int iColumnTile, bool bCoherence )
+{
+	int iNumberChannels = (int)m_aiSignals.size();
+	int iRow0 = iRowTile * TILE_CHANNELS;
+	int iRow1 = min( iNumberChannels, iRow0 + TILE_CHANNELS );
+	int iColumn0 = iColumnTile * TILE_CHANNELS;
+	int iColumn1 = min( iNumberChannels, iColumn0 + TILE_CHANNELS );
+	bool bSymmetric = (iRowTile == iColumnTile);
+	vector<double> adSums( (size_t)TILE_CHANNELS * TILE_CHANNELS, 0.0 );
+
+	vAccumulateTile( &sData.afSeries[0], &sData.afSeries[0], m_iSeriesStride, iRow0, iRow1, iColumn0, iColumn1,
+					 0, m_iEpochSamples, bSymmetric, &adSums[0] );
+
+	for( int iRow = iRow0; iRow < iRow1; iRow++ )
+	{
+		for( int iColumn = bSymmetric ? iRow : iColumn0; iColumn < iColumn1; iColumn++ )
+		{
+			if( sData.abValid[iRow] && sData.abValid[iColumn] )
+			{
+				float fCorrelation = (float)max( -1.0, min( 1.0, adSums[(size_t)(iRow - iRow0) * TILE_CHANNELS + (iColumn - iColumn0)] ) );
+
+				sResult.afCorrelation[(size_t)iRow * iNumberChannels + iColumn] = fCorrelation;
+				sResult.afCorrelation[(size_t)iColumn * iNumberChannels + iRow] = fCorrelation;
+			}
+		}
+	}
+
+	if( !bCoherence )
+	{
+		return;
+	}
+
+	int iNumberBands = (int)m_asBands.size();
+	vector<double> adRealReal( (size_t)TILE_CHANNELS * TILE_CHANNELS );
+	vector<double> adImaginaryImaginary( (size_t)TILE_CHANNELS * TILE_CHANNELS );
+	vector<double> adImaginaryReal( (size_t)TILE_CHANNELS * TILE_CHANNELS );
+	vector<double> adRealImaginary( (size_t)TILE_CHANNELS * TILE_CHANNELS );
+
+	for( int iBand = 0; iBand < iNumberBands; iBand++ )
+	{
+		int iFirst = m_aiBandOffsets[iBand];
+		int iLength = m_aiBandNumberBins[iBand] * m_iNumberSegments;
+
+		fill( adRealReal.begin(), adRealReal.end(), 0.0 );
+		fill( adImaginaryImaginary.begin(), adImaginaryImaginary.end(), 0.0 );
+		fill( adImaginaryReal.begin(), adImaginaryReal.end(), 0.0 );
+		fill( adRealImaginary.begin(), adRealImaginary.end(), 0.0 );
+
+		// Sxy = sum X conj(Y): real = Xr.Yr + Xi.Yi, imaginary = Xi.Yr - Xr.Yi
+		// (the imaginary parts need both column orders, so no symmetric shortcut there):
+		vAccumulateTile( &sData.afReal[0], &sData.afReal[0], m_iSpectrumStride, iRow0, iRow1, iColumn0, iColumn1, iFirst, iLength, bSymmetric, &adRealReal[0] );
+		vAccumulateTile( &sData.afImaginary[0], &sData.afImaginary[0], m_iSpectrumStride, iRow0, iRow1, iColumn0, iColumn1, iFirst, iLength, bSymmetric, &adImaginaryImaginary[0] );
+		vAccumulateTile( &sData.afImaginary[0], &sData.afReal[0], m_iSpectrumStride, iRow0, iRow1, iColumn0, iColumn1, iFirst, iLength, false, &adImaginaryReal[0] );
+		vAccumulateTile( &sData.afReal[0], &sData.afImaginary[0], m_iSpectrumStride, iRow0, iRow1, iColumn0, iColumn1, iFirst, iLength, false, &adRealImaginary[0] );
+
+		float *pfCoherence = &sResult.afCoherence[(size_t)iBand * iNumberChannels * iNumberChannels];
+
+		for( int iRow = iRow0; iRow < iRow1; iRow++ )
+		{
+			for( int iColumn = bSymmetric ? iRow : iColumn0; iColumn < iColumn1; iColumn++ )
+			{
+				size_t iTile = (size_t)(iRow - iRow0) * TILE_CHANNELS + (iColumn - iColumn0);
+				double dAuto = sData.adAutoSpectra[(size_t)iRow * iNumberBands + iBand] * sData.adAutoSpectra[(size_t)iColumn * iNumberBands + iBand];
+
+				if( dAuto > 0.0 && sData.abValid[iRow] && sData.abValid[iColumn] )
+				{
+					double dReal = adRealReal[iTile] + adImaginaryImaginary[iTile];
+					double dImaginary = adImaginaryReal[iTile] - adRealImaginary[iTile];
+					float fCoherence = (float)min( 1.0, (dReal * dReal + dImaginary * dImaginary) / dAuto );
+
+					pfCoherence[(size_t)iRow * iNumberChannels + iColumn] = fCoherence;
+					pfCoherence[(size_t)iColumn * iNumberChannels + iRow] = fCoherence;
+				}
+			}
+		}
+	}
+}
+
+/*!
+*   \brief Compute the matrices of every epoch and hand them to a callback in epoch order.
+*   \param fnCallback - called once per epoch (on the calling thread)
+*   \param bCoherence - also compute the band coherence matrices
+*   \return Status of operation (last epoch error, if any).
+*/
+
+CReadEDF::edfStatus_E CConnectivityEDF::eRun( epochCallback_F fnCallback, bool bCoherence )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	vector<worker_S> asWorkers;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		if( m_iNumberEpochs == 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_RECORD_REQUESTED;
+			break;
+		}
+
+		if( m_aiSignals.empty() )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;
+			break;
+		}
+
+		if( m_asBands.empty() )
+		{
+			eAddBand( 0.5, 4.0 );			// delta
+			eAddBand( 4.0, 8.0 );			// theta
+			eAddBand( 8.0, 13.0 );			// alpha
+			eAddBand( 13.0, 30.0 );			// beta
+		}
+
+		vPlanRun();
+
+		asWorkers.resize( m_iNumberThreads );
+
+		for( int iWorker = 0; iWorker < m_iNumberThreads; iWorker++ )
+		{
+			worker_S &sWorker = asWorkers[iWorker];
+
+			sWorker.poEDF = new CReadEDF( m_pszInputFile );
+			if( !sWorker.poEDF->bReadyStatus( &eEdfStatus ) )
+			{
+				break;
+			}
+
+			sWorker.asRecords.resize( (size_t)m_iRecordsPerEpoch * sWorker.poEDF->iGetSamplesPerRecord() );
+			sWorker.adSignal.resize( m_iEpochSamples );
+			sWorker.adReal.resize( m_iSegmentSize );
+			sWorker.adImaginary.resize( m_iSegmentSize );
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		// Upper triangle tile pairs:
+		int iNumberTiles = ((int)m_aiSignals.size() + TILE_CHANNELS - 1) / TILE_CHANNELS;
+		vector< pair<int, int> > aoTilePairs;
+
+		for( int iRowTile = 0; iRowTile < iNumberTiles; iRowTile++ )
+		{
+			for( int iColumnTile = iRowTile; iColumnTile < iNumberTiles; iColumnTile++ )
+			{
+				aoTilePairs.push_back( make_pair( iRowTile, iColumnTile ) );
+			}
+		}
+
+		int iBatchSize = m_iNumberThreads * EPOCHS_PER_THREAD;
+		int iNumberPairs = (int)aoTilePairs.size();
+		vector<epochData_S> asData( iBatchSize );
+		vector<epochResult_S> asResults( iBatchSize );
+
+		for( int iBatchStart = 0; iBatchStart < m_iNumberEpochs; iBatchStart += iBatchSize )
+		{
+			int iBatchEpochs = min( iBatchSize, m_iNumberEpochs - iBatchStart );
+			atomic<int> iNextEpoch( 0 );
+			atomic<int> iNextItem( 0 );
+
+			// Phase 1 (one epoch per item), then phase 2 (one epoch tile pair per item):
+			auto fnPrepare = [&]( int iWorker )
+			{
+				for( int i = iNextEpoch++; i < iBatchEpochs; i = iNextEpoch++ )
+				{
+					vPrepareEpoch( asWorkers[iWorker], asData[i], asResults[i], iBatchStart + i, bCoherence );
+				}
+			};
+
+			auto fnTiles = [&]( int iWorker )
+			{
+				(void)iWorker;
+
+				for( int iItem = iNextItem++; iItem < iBatchEpochs * iNumberPairs; iItem = iNextItem++ )
+				{
+					int i = iItem / iNumberPairs;
+					const pair<int, int> &oPair = aoTilePairs[iItem % iNumberPairs];
+
+					if( asResults[i].eEdfStatus == CReadEDF::EDF_SUCCESS )
+					{
+						vProcessTile( asData[i], asResults[i], oPair.first, oPair.second, bCoherence );
+					}
+				}
+			};
+
+			for( int iPhase = 0; iPhase < 2; iPhase++ )
+			{
+				function<void ( int )> fnWorker = (iPhase == 0) ? function<void ( int )>( fnPrepare ) : function<void ( int )>( fnTiles );
+
+				if( m_iNumberThreads == 1 )
+				{
+					fnWorker( 0 );
+				}
+				else
+				{
+					vector<thread> aoThreads;
+
+					for( int iWorker = 0; iWorker < m_iNumberThreads; iWorker++ )
+					{
+						aoThreads.push_back( thread( fnWorker, iWorker ) );
+					}
+
+					for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+					{
+						aoThreads[iThread].join();
+					}
+				}
+			}
+
+			// Stream the batch out in epoch order:
+			for( int i = 0; i < iBatchEpochs; i++ )
+			{
+				if( asResults[i].eEdfStatus != CReadEDF::EDF_SUCCESS )
+				{
+					eEdfStatus = asResults[i].eEdfStatus;
+				}
+
+				if( fnCallback )
+				{
+					fnCallback( asResults[i] );
+				}
+			}
+		}
+	} //for()
+
+	for( size_t iWorker = 0; iWorker < asWorkers.size(); iWorker++ )
+	{
+		delete asWorkers[iWorker].poEDF;
+	}
+
+	return( eEdfStatus );
+}
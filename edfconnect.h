@@ -0,0 +1,133 @@
+#ifndef EDFCONNECT_H
+#define EDFCONNECT_H
+
+#include <vector>
+#include <functional>
+#include "edfplus.h"
+#include "edfspectral.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for epoch-wise channel-by-channel connectivity (correlation and coherence) of EDF data.
+*/
+
+/*! \class CConnectivityEDF
+    \brief Parallel correlation and band coherence matrices per epoch over a whole EDF file.
+
+	Epochs are whole numbers of data records. For every epoch each channel is calibrated and
+	z-scored (so a dot product of two channels is their Pearson correlation), and, for coherence,
+	cut into Hann windowed, 50% overlapping power of two segments whose FFT bins inside the bands
+	are packed per channel. Both matrices are then plain dot products between channel rows:
+	correlation over time samples, cross-spectra over (segment, bin) pairs, where the magnitude
+	squared coherence of a band is |sum Sxy|^2 / (sum Sxx * sum Syy).
+
+	The dot products are computed GEMM style: the channel matrix is cut into TILE_CHANNELS square
+	tiles, each tile pair walks its rows in TIME_BLOCK chunks that stay in cache, and a 4 x 2
+	register micro kernel (SSE2 when available) reuses every load for several channel pairs.
+	Epochs are processed in batches like CSpectralEDF: the workers first prepare the epochs of a
+	batch (one epoch per work item), then share all (epoch, tile pair) items; results reach the
+	callback in epoch order, so memory stays bounded by the batch size, not by the recording.
+
+	\code
+	CConnectivityEDF oConnectivity( pszFile, 30.0, 2.0 );
+	oConnectivity.eRun( [&]( const CConnectivityEDF::epochResult_S &sResult ) { ... } );
+	\endcode
+*/
+
+class CConnectivityEDF
+{
+	public:
+
+	enum connectivityConstants_E
+	{
+		EPOCHS_PER_THREAD = 1,			///< epochs per worker thread in one batch
+		TILE_CHANNELS = 32,				///< channels per matrix tile (one work item is a tile pair)
+		TIME_BLOCK = 512,				///< values per channel row kept in cache while a tile pair is accumulated
+	};
+
+	//! \brief Connectivity results of one epoch (all selected channels).
+	struct epochResult_S
+	{
+		int iEpoch;
+		double dStartTime;							///< seconds from the start of the recording
+		CReadEDF::edfStatus_E eEdfStatus;
+		vector<float> afCorrelation;				///< [row * channels + column]; NaN for a flat channel
+		vector<float> afCoherence;					///< [(band * channels + row) * channels + column], if requested
+	};
+
+	typedef function<void ( const epochResult_S & )> epochCallback_F;
+
+	CConnectivityEDF( char *pszInputFile, double dEpochSeconds = 30.0, double dSegmentSeconds = 2.0, int iNumberThreads = 0 );
+	~CConnectivityEDF( void );
+
+	CReadEDF::edfStatus_E eSelectSignals( const int *piSignals, int iNumberSignals );
+	CReadEDF::edfStatus_E eAddBand( double dLow, double dHigh );
+	CReadEDF::edfStatus_E eRun( epochCallback_F fnCallback, bool bCoherence = true );
+
+	int iGetNumberEpochs( void )
+	{
+		return( m_iNumberEpochs );
+	};
+
+	int iGetNumberChannels( void )
+	{
+		return( (int)m_aiSignals.size() );
+	};
+
+	//! \brief Return the signal number of a matrix row/column (-1 if invalid).
+	int iGetChannelSignal( int iChannel )
+	{
+		return( (iChannel >= 0 && iChannel < (int)m_aiSignals.size()) ? m_aiSignals[iChannel] : -1 );
+	};
+
+	private:
+
+	//! \brief Prepared rows of one epoch (shared read-only by the tile work items).
+	struct epochData_S
+	{
+		vector<float> afSeries;				///< [channel * series stride + sample], z-scored
+		vector<float> afReal;				///< [channel * spectrum stride + packed band bin]
+		vector<float> afImaginary;
+		vector<double> adAutoSpectra;		///< [channel * bands + band]
+		vector<char> abValid;				///< [channel], false for a flat channel
+	};
+
+	//! \brief Per-thread reader and scratch, allocated once per run.
+	struct worker_S
+	{
+		CReadEDF *poEDF;
+		vector<short int> asRecords;
+		vector<double> adSignal;
+		vector<double> adReal;
+		vector<double> adImaginary;
+	};
+
+	void vPlanRun( void );
+	void vPrepareEpoch( worker_S &sWorker, epochData_S &sData, epochResult_S &sResult, int iEpoch, bool bCoherence );
+	void vProcessTile( const epochData_S &sData, epochResult_S &sResult, int iRowTile, int iColumnTile, bool bCoherence );
+
+	char *m_pszInputFile;
+	CReadEDF *m_poEDF;
+	double m_dEpochSeconds;
+	double m_dSegmentSeconds;
+	int m_iNumberThreads;
+	int m_iRecordsPerEpoch;
+	int m_iNumberEpochs;
+	vector<int> m_aiSignals;
+	vector<CSpectralEDF::band_S> m_asBands;
+
+	// Layout of one run (vPlanRun()):
+	int m_iEpochSamples;					///< samples per channel per epoch
+	int m_iSeriesStride;					///< m_iEpochSamples rounded up to a cache line of floats
+	int m_iSegmentSize;
+	int m_iNumberSegments;
+	int m_iSpectrumStride;
+	vector<int> m_aiBandFirstBins;
+	vector<int> m_aiBandNumberBins;
+	vector<int> m_aiBandOffsets;			///< packed offset of each band in a channel spectrum row
+	vector<double> m_adWindow;
+	vector<CFftPlan> m_aoPlans;				///< the plan for m_iSegmentSize (empty before a run)
+}; //class CConnectivityEDF
+
+#endif // EDFCONNECT_H
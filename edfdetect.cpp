@@ -0,0 +1,982 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for streaming event detection (threshold, spike, flat line, R-peak) on EDF data records.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "edfdetect.h"
+using namespace std;
+
+const double CDetectEDF::BASELINE_SECONDS = 10.0;
+const double CDetectEDF::LEARN_SECONDS = 2.0;
+
+/*!
+*   \brief Constructor
+*   \param poEDF - reader (must stay valid for the lifetime of the detector)
+*/
+
+CDetectEDF::CDetectEDF( CReadEDF *poEDF )
+{
+	m_poEDF = poEDF;
+	m_iNumberSignals = 0;
+	m_llNextRecord = -1;
+	m_iAnnotationSignal = -1;
+
+	if( m_poEDF != NULL && m_poEDF->bReadyStatus() )
+	{
+		m_poEDF->eGetNumberSignals( &m_iNumberSignals );
+
+		if( m_poEDF->bIsEdfPlus() )
+		{
+			m_iAnnotationSignal = m_poEDF->iFindSignal( "EDF Annotations" );
+		}
+	}
+
+	m_adGains.assign( m_iNumberSignals, 1.0 );
+	m_adOffsets.assign( m_iNumberSignals, 0.0 );
+	m_adSampleRates.assign( m_iNumberSignals, 0.0 );
+	m_allNextSamples.assign( m_iNumberSignals, 0 );
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		m_poEDF->eGetCalibration( iThisSignal, &m_adGains[iThisSignal], &m_adOffsets[iThisSignal] );
+		m_adSampleRates[iThisSignal] = m_poEDF->dGetSampleRate( iThisSignal );
+	}
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CDetectEDF::~CDetectEDF( void )
+{
+}
+
+/*!
+*   \brief Return a label without its surrounding spaces (EDF labels are space padded).
+*/
+
+static string sTrimLabel( const char *pszLabel )
+{
+	string sLabel( pszLabel != NULL ? pszLabel : "" );
+	size_t iFirst = sLabel.find_first_not_of( ' ' );
+
+	if( iFirst == string::npos )
+	{
+		return( string() );
+	}
+
+	return( sLabel.substr( iFirst, sLabel.find_last_not_of( ' ' ) - iFirst + 1 ) );
+}
+
+/*!
+*   \brief Add one detector per selected signal, converting times to samples at each signal's rate.
+*
+*	ALL_SIGNALS leaves out "EDF Annotations" signals. Every selected signal is checked before any
+*	detector is added, so a failure leaves the detector list unchanged.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CDetectEDF::eAddDetector( detectorType_E eType, int iSignalNumber, double dLow, double dHigh,
+												double dMinimumSeconds, double dRefractorySeconds, const char *pszName )
+{
+	if( iSignalNumber < ALL_SIGNALS || iSignalNumber >= m_iNumberSignals )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	vector<int> aiSignals;
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		if( iSignalNumber != ALL_SIGNALS && iSignalNumber != iThisSignal )
+		{
+			continue;
+		}
+
+		if( strncmp( m_poEDF->pszGetSignalLabel( iThisSignal ), "EDF Annotations", 15 ) == 0 )
+		{
+			if( iSignalNumber != ALL_SIGNALS )
+			{
+				return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+			}
+
+			continue;
+		}
+
+		if( m_adSampleRates[iThisSignal] <= 0.0 )
+		{
+			return( CReadEDF::EDF_INVALID_PARAMETER );
+		}
+
+		aiSignals.push_back( iThisSignal );
+	}
+
+	for( size_t i = 0; i < aiSignals.size(); i++ )
+	{
+		int iThisSignal = aiSignals[i];
+		double dSampleRate = m_adSampleRates[iThisSignal];
+		detector_S sDetector;
+
+		sDetector.eType = eType;
+		sDetector.iSignal = iThisSignal;
+		sDetector.sLabel = string( pszName ) + " " + sTrimLabel( m_poEDF->pszGetSignalLabel( iThisSignal ) );
+		sDetector.dLow = dLow;
+		sDetector.dHigh = dHigh;
+		sDetector.llMinimumSamples = (long long)ceil( dMinimumSeconds * dSampleRate );
+		sDetector.llRefractorySamples = (long long)ceil( dRefractorySeconds * dSampleRate );
+		sDetector.iWindowSamples = max( 1, (int)(0.15 * dSampleRate + 0.5) );		// QRS width
+
+		vResetDetector( sDetector );
+		m_asDetectors.push_back( sDetector );
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add a threshold detector: physical value below dLow or above dHigh.
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param dLow - lower limit (physical units)
+*   \param dHigh - upper limit (physical units)
+*   \param dMinimumSeconds - shortest excursion reported
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CDetectEDF::eAddThreshold( int iSignalNumber, double dLow, double dHigh, double dMinimumSeconds )
+{
+	if( dLow > dHigh || dMinimumSeconds < 0.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	return( eAddDetector( DETECT_THRESHOLD, iSignalNumber, dLow, dHigh, dMinimumSeconds, 0.0, "Threshold" ) );
+}
+
+/*!
+*   \brief Add a spike candidate detector: nonlinear energy x[n]^2 - x[n-1] x[n+1] above dFactor
+*	       times its running mean (time constant BASELINE_SECONDS, adapted once per data record).
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param dFactor - threshold in multiples of the mean energy
+*   \param dRefractorySeconds - shortest time between two spikes
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CDetectEDF::eAddSpike( int iSignalNumber, double dFactor, double dRefractorySeconds )
+{
+	if( dFactor <= 0.0 || dRefractorySeconds < 0.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	return( eAddDetector( DETECT_SPIKE, iSignalNumber, 0.0, dFactor, 0.0, dRefractorySeconds, "Spike" ) );
+}
+
+/*!
+*   \brief Add a flat line (disconnection) detector: peak-to-peak range within dTolerance.
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param dTolerance - largest peak-to-peak range still considered flat (physical units)
+*   \param dMinimumSeconds - shortest flat run reported
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CDetectEDF::eAddFlatLine( int iSignalNumber, double dTolerance, double dMinimumSeconds )
+{
+	if( dTolerance < 0.0 || dMinimumSeconds <= 0.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	return( eAddDetector( DETECT_FLAT_LINE, iSignalNumber, 0.0, dTolerance, dMinimumSeconds, 0.0, "Flat line" ) );
+}
+
+/*!
+*   \brief Add an ECG R-peak detector (slope energy, 150 ms moving integration, adaptive threshold,
+*	       200 ms refractory period; the first LEARN_SECONDS train the threshold).
+*   \param iSignalNumber - ECG signal number (at least 50 samples per second)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CDetectEDF::eAddRPeak( int iSignalNumber )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( m_adSampleRates[iSignalNumber] < 50.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	return( eAddDetector( DETECT_R_PEAK, iSignalNumber, 0.0, 0.0, 0.0, 0.2, "R-peak" ) );
+}
+
+/*!
+*   \brief Return the annotation text of a detector (NULL if invalid).
+*/
+
+const char *CDetectEDF::pszGetDetectorLabel( int iDetector )
+{
+	if( iDetector < 0 || iDetector >= (int)m_asDetectors.size() )
+	{
+		return( NULL );
+	}
+
+	return( m_asDetectors[iDetector].sLabel.c_str() );
+}
+
+/*!
+*   \brief Clear the running state of one detector.
+*/
+
+void CDetectEDF::vResetDetector( detector_S &sDetector )
+{
+	sDetector.bActive = false;
+	sDetector.llStart = 0;
+	sDetector.llPeak = 0;
+	sDetector.dPeak = 0.0;
+	sDetector.dPeakValue = 0.0;
+	sDetector.dRunMinimum = 0.0;
+	sDetector.dRunMaximum = 0.0;
+	sDetector.dBaseline = 0.0;
+	sDetector.dSignalLevel = 0.0;
+	sDetector.dNoiseLevel = 0.0;
+	sDetector.dWindowSum = 0.0;
+	sDetector.iWindowPosition = 0;
+	sDetector.llLastDetection = -1;
+	sDetector.llLastDecay = 0;
+	sDetector.bPrimed = false;
+	sDetector.fPrevious1 = 0.0f;
+	sDetector.fPrevious2 = 0.0f;
+
+	if( sDetector.eType == DETECT_R_PEAK )
+	{
+		sDetector.afWindow.assign( sDetector.iWindowSamples, 0.0f );
+		sDetector.afRecent.assign( sDetector.iWindowSamples, 0.0f );
+	}
+}
+
+/*!
+*   \brief Clear all detector state (start of a new, unrelated record range); open events are dropped.
+*/
+
+void CDetectEDF::vReset( void )
+{
+	for( size_t iDetector = 0; iDetector < m_asDetectors.size(); iDetector++ )
+	{
+		vResetDetector( m_asDetectors[iDetector] );
+	}
+
+	m_llNextRecord = -1;
+}
+
+/*!
+*   \brief Append an event, converting sample numbers to seconds (from the record onset for EDF+).
+*/
+
+void CDetectEDF::vAddEvent( const detector_S &sDetector, int iDetector, long long llStart, long long llSamples, double dValue, vector<event_S> *pasEvents )
+{
+	double dSampleRate = m_adSampleRates[sDetector.iSignal];
+	long long llSamplesPerRecord = m_poEDF->iGetNumberSamples( sDetector.iSignal );
+	long long llRecord = llStart / llSamplesPerRecord;
+	event_S sEvent;
+
+	sEvent.dOnset = llStart / dSampleRate;
+
+	if( m_iAnnotationSignal >= 0 && llRecord < (long long)m_adRecordOnsets.size() && !isnan( m_adRecordOnsets[llRecord] ) )
+	{
+		sEvent.dOnset = m_adRecordOnsets[llRecord] + (llStart - llRecord * llSamplesPerRecord) / dSampleRate;
+	}
+
+	sEvent.dDuration = llSamples / dSampleRate;
+	sEvent.dValue = dValue;
+	sEvent.iSignal = sDetector.iSignal;
+	sEvent.iDetector = iDetector;
+
+	pasEvents->push_back( sEvent );
+}
+
+/*!
+*   \brief Parse the onset of the time keeping TAL ("+Onset\x14\x14") at the start of a record's annotation signal.
+*   \return true if pdOnset was loaded.
+*/
+
+bool CDetectEDF::bReadOnset( const short int *psRecord, double *pdOnset )
+{
+	const char *pacAnnotations = (const char *)(psRecord + m_poEDF->iGetSignalOffset( m_iAnnotationSignal ));
+	int iBytes = m_poEDF->iGetNumberSamples( m_iAnnotationSignal ) * (int)sizeof(short int);
+	char szOnset[32];
+	int iLength = 0;
+
+	while( iLength < iBytes && iLength < (int)sizeof(szOnset) - 1 && pacAnnotations[iLength] != '\x14' && pacAnnotations[iLength] != '\x15' )
+	{
+		szOnset[iLength] = pacAnnotations[iLength];
+		iLength++;
+	}
+
+	szOnset[iLength] = '\0';
+
+	if( iLength < 2 || (szOnset[0] != '+' && szOnset[0] != '-') || iLength >= iBytes || pacAnnotations[iLength] != '\x14' )
+	{
+		return( false );
+	}
+
+	char *pszEnd = NULL;
+
+	*pdOnset = strtod( szOnset, &pszEnd );
+	return( *pszEnd == '\0' );
+}
+
+/*!
+*   \brief Threshold detector on one segment (samples llBase...).
+*/
+
+void CDetectEDF::vRunThreshold( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents )
+{
+	float fLow = (float)sDetector.dLow;
+	float fHigh = (float)sDetector.dHigh;
+
+	if( !sDetector.bActive )
+	{
+		float fMinimum = pfData[0];
+		float fMaximum = pfData[0];
+
+		for( int i = 1; i < iNumberSamples; i++ )
+		{
+			fMinimum = min( fMinimum, pfData[i] );
+			fMaximum = max( fMaximum, pfData[i] );
+		}
+
+		if( fMinimum >= fLow && fMaximum <= fHigh )
+		{
+			return;			// nothing outside the limits
+		}
+	}
+
+	for( int i = 0; i < iNumberSamples; i++ )
+	{
+		float fValue = pfData[i];
+		double dExcess = (fValue < fLow) ? sDetector.dLow - fValue : fValue - sDetector.dHigh;
+
+		if( fValue < fLow || fValue > fHigh )
+		{
+			if( !sDetector.bActive )
+			{
+				sDetector.bActive = true;
+				sDetector.llStart = llBase + i;
+				sDetector.dPeak = -1.0;
+			}
+
+			if( dExcess > sDetector.dPeak )
+			{
+				sDetector.dPeak = dExcess;
+				sDetector.dPeakValue = fValue;
+			}
+		}
+		else if( sDetector.bActive )
+		{
+			long long llSamples = llBase + i - sDetector.llStart;
+
+			if( llSamples >= sDetector.llMinimumSamples )
+			{
+				vAddEvent( sDetector, iDetector, sDetector.llStart, llSamples, sDetector.dPeakValue, pasEvents );
+			}
+
+			sDetector.bActive = false;
+		}
+	}
+}
+
+/*!
+*   \brief Spike detector on one segment: nonlinear energy, then a scan only if it crosses the threshold.
+*/
+
+void CDetectEDF::vRunSpike( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents )
+{
+	if( !sDetector.bPrimed )
+	{
+		sDetector.fPrevious1 = pfData[0];
+		sDetector.fPrevious2 = pfData[0];
+	}
+
+	// Energy at the centre sample llBase + i - 1 (one sample of look-ahead):
+	float *pfEnergy = &m_afFeature[0];
+	float fPrevious1 = sDetector.fPrevious1;
+	float fPrevious2 = sDetector.fPrevious2;
+
+	pfEnergy[0] = fPrevious1 * fPrevious1 - fPrevious2 * pfData[0];
+	if( iNumberSamples > 1 )
+	{
+		pfEnergy[1] = pfData[0] * pfData[0] - fPrevious1 * pfData[1];
+	}
+
+	for( int i = 2; i < iNumberSamples; i++ )
+	{
+		pfEnergy[i] = pfData[i - 1] * pfData[i - 1] - pfData[i - 2] * pfData[i];
+	}
+
+	double dSum = 0.0;
+	float fMaximum = pfEnergy[0];
+
+	for( int i = 0; i < iNumberSamples; i++ )
+	{
+		dSum += pfEnergy[i];
+		fMaximum = max( fMaximum, pfEnergy[i] );
+	}
+
+	double dMean = dSum / iNumberSamples;
+
+	if( !sDetector.bPrimed )
+	{
+		sDetector.dBaseline = dMean;
+		sDetector.bPrimed = true;
+	}
+
+	// The threshold comes from the history, so a spike does not raise its own threshold:
+	double dThreshold = sDetector.dHigh * sDetector.dBaseline;
+
+	if( dThreshold > 0.0 && (sDetector.bActive || fMaximum > dThreshold) )
+	{
+		for( int i = 0; i < iNumberSamples; i++ )
+		{
+			long long llCentre = llBase + i - 1;
+
+			if( pfEnergy[i] > dThreshold )
+			{
+				float fCentre = (i == 0) ? fPrevious1 : pfData[i - 1];
+
+				if( !sDetector.bActive )
+				{
+					if( sDetector.llLastDetection < 0 || llCentre >= sDetector.llLastDetection + sDetector.llRefractorySamples )
+					{
+						sDetector.bActive = true;
+						sDetector.llPeak = llCentre;
+						sDetector.dPeak = pfEnergy[i];
+						sDetector.dPeakValue = fCentre;
+					}
+				}
+				else if( pfEnergy[i] > sDetector.dPeak )
+				{
+					sDetector.llPeak = llCentre;
+					sDetector.dPeak = pfEnergy[i];
+					sDetector.dPeakValue = fCentre;
+				}
+			}
+			else if( sDetector.bActive )
+			{
+				vAddEvent( sDetector, iDetector, sDetector.llPeak, 0, sDetector.dPeakValue, pasEvents );
+				sDetector.llLastDetection = sDetector.llPeak;
+				sDetector.bActive = false;
+			}
+		}
+	}
+
+	double dAlpha = min( 1.0, iNumberSamples / (m_adSampleRates[sDetector.iSignal] * BASELINE_SECONDS) );
+
+	sDetector.dBaseline += dAlpha * (dMean - sDetector.dBaseline);
+	sDetector.fPrevious2 = (iNumberSamples > 1) ? pfData[iNumberSamples - 2] : fPrevious1;
+	sDetector.fPrevious1 = pfData[iNumberSamples - 1];
+}
+
+/*!
+*   \brief Flat line detector on one segment: whole segments that stay flat extend the run without a
+*	       scan, and busy segments are skipped up to where the run still open at their end started.
+*/
+
+void CDetectEDF::vRunFlatLine( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents )
+{
+	double dTolerance = sDetector.dHigh;
+	int iScanFrom = 0;
+
+	if( !sDetector.bActive )
+	{
+		sDetector.bActive = true;
+		sDetector.llStart = llBase;
+		sDetector.dRunMinimum = pfData[0];
+		sDetector.dRunMaximum = pfData[0];
+	}
+
+	// A step between neighbours larger than the tolerance ends whatever run holds the first of them,
+	// so such a sample starts a new run regardless of the samples before it. On a busy signal the
+	// first and the last of these breaks are found within a few samples from either end:
+	int iFirstBreak = 1;
+	int iLastBreak = iNumberSamples - 1;
+
+	while( iFirstBreak < iNumberSamples && fabs( (double)pfData[iFirstBreak] - (double)pfData[iFirstBreak - 1] ) <= dTolerance )
+	{
+		iFirstBreak++;
+	}
+
+	while( iLastBreak > iFirstBreak && fabs( (double)pfData[iLastBreak] - (double)pfData[iLastBreak - 1] ) <= dTolerance )
+	{
+		iLastBreak--;
+	}
+
+	if( iFirstBreak < iNumberSamples )
+	{
+		// If neither the open run (ended by the first break) nor any run between the breaks can last
+		// long enough to be reported, skip to the last break: the run open at the end starts there.
+		if( iLastBreak - iFirstBreak < sDetector.llMinimumSamples
+			&& llBase + iFirstBreak - sDetector.llStart < sDetector.llMinimumSamples )
+		{
+			sDetector.llStart = llBase + iLastBreak;
+			sDetector.dRunMinimum = pfData[iLastBreak];
+			sDetector.dRunMaximum = pfData[iLastBreak];
+			iScanFrom = iLastBreak + 1;
+		}
+	}
+	else
+	{
+		float fMinimum = pfData[0];
+		float fMaximum = pfData[0];
+
+		for( int i = 1; i < iNumberSamples; i++ )
+		{
+			fMinimum = min( fMinimum, pfData[i] );
+			fMaximum = max( fMaximum, pfData[i] );
+		}
+
+		if( max( sDetector.dRunMaximum, (double)fMaximum ) - min( sDetector.dRunMinimum, (double)fMinimum ) <= dTolerance )
+		{
+			sDetector.dRunMinimum = min( sDetector.dRunMinimum, (double)fMinimum );
+			sDetector.dRunMaximum = max( sDetector.dRunMaximum, (double)fMaximum );
+			return;
+		}
+	}
+
+	for( int i = iScanFrom; i < iNumberSamples; i++ )
+	{
+		double dMinimum = min( sDetector.dRunMinimum, (double)pfData[i] );
+		double dMaximum = max( sDetector.dRunMaximum, (double)pfData[i] );
+
+		if( dMaximum - dMinimum > dTolerance )
+		{
+			long long llSamples = llBase + i - sDetector.llStart;
+
+			if( llSamples >= sDetector.llMinimumSamples )
+			{
+				vAddEvent( sDetector, iDetector, sDetector.llStart, llSamples, sDetector.dRunMinimum, pasEvents );
+			}
+
+			// A new run starts at the sample that broke the old one:
+			sDetector.llStart = llBase + i;
+			dMinimum = pfData[i];
+			dMaximum = pfData[i];
+		}
+
+		sDetector.dRunMinimum = dMinimum;
+		sDetector.dRunMaximum = dMaximum;
+	}
+}
+
+/*!
+*   \brief R-peak detector on one segment (squared slope, moving integration, adaptive threshold).
+*/
+
+void CDetectEDF::vRunRPeak( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents )
+{
+	double dSampleRate = m_adSampleRates[sDetector.iSignal];
+	int iWindow = sDetector.iWindowSamples;
+	long long llLearnSamples = (long long)(LEARN_SECONDS * dSampleRate);
+	double dBaselineAlpha = 1.0 / dSampleRate;		// ~1 s baseline
+
+	if( !sDetector.bPrimed )
+	{
+		sDetector.fPrevious1 = pfData[0];
+		sDetector.fPrevious2 = pfData[0];
+		sDetector.dBaseline = pfData[0];
+		sDetector.llStart = llBase;
+		sDetector.llLastDecay = llBase;
+		sDetector.bPrimed = true;
+	}
+
+	// Squared slope x[n] - x[n-2]:
+	float *pfSlope = &m_afFeature[0];
+
+	pfSlope[0] = (pfData[0] - sDetector.fPrevious2) * (pfData[0] - sDetector.fPrevious2);
+	if( iNumberSamples > 1 )
+	{
+		pfSlope[1] = (pfData[1] - sDetector.fPrevious1) * (pfData[1] - sDetector.fPrevious1);
+	}
+
+	for( int i = 2; i < iNumberSamples; i++ )
+	{
+		pfSlope[i] = (pfData[i] - pfData[i - 2]) * (pfData[i] - pfData[i - 2]);
+	}
+
+	for( int i = 0; i < iNumberSamples; i++ )
+	{
+		long long llSample = llBase + i;
+		int iPosition = sDetector.iWindowPosition;
+
+		sDetector.dBaseline += dBaselineAlpha * (pfData[i] - sDetector.dBaseline);
+		sDetector.dWindowSum += pfSlope[i] - sDetector.afWindow[iPosition];
+		sDetector.afWindow[iPosition] = pfSlope[i];
+		sDetector.afRecent[iPosition] = (float)(pfData[i] - sDetector.dBaseline);
+		sDetector.iWindowPosition = (iPosition + 1 == iWindow) ? 0 : iPosition + 1;
+
+		double dIntegrated = max( sDetector.dWindowSum, 0.0 ) / iWindow;
+
+		// Training: signal level from the largest peak, noise level from the mean:
+		if( llSample - sDetector.llStart < llLearnSamples )
+		{
+			sDetector.dSignalLevel = max( sDetector.dSignalLevel, dIntegrated );
+			sDetector.dNoiseLevel += dIntegrated;
+
+			if( llSample - sDetector.llStart == llLearnSamples - 1 )
+			{
+				sDetector.dSignalLevel /= 3.0;
+				sDetector.dNoiseLevel /= 2.0 * llLearnSamples;
+				sDetector.llLastDecay = llSample;
+			}
+			continue;
+		}
+
+		double dThreshold = sDetector.dNoiseLevel + 0.25 * (sDetector.dSignalLevel - sDetector.dNoiseLevel);
+
+		if( !sDetector.bActive )
+		{
+			if( dIntegrated > dThreshold )
+			{
+				// The integration lags the QRS: look for the R wave in the whole window so far:
+				sDetector.bActive = true;
+				sDetector.dPeak = dIntegrated;
+				sDetector.llPeak = llSample;
+				sDetector.dPeakValue = 0.0;
+
+				for( int k = 0; k < iWindow; k++ )
+				{
+					float fRecent = sDetector.afRecent[(sDetector.iWindowPosition + k) % iWindow];
+
+					if( fabs( fRecent ) > fabs( sDetector.dPeakValue ) )
+					{
+						sDetector.dPeakValue = fRecent;
+						sDetector.llPeak = llSample - (iWindow - 1) + k;
+					}
+				}
+			}
+			else if( llSample - max( sDetector.llLastDetection, sDetector.llLastDecay ) > 2 * dSampleRate )
+			{
+				// No beat for 2 s (amplitude drop, lead change): lower the signal level:
+				sDetector.dSignalLevel *= 0.5;
+				sDetector.llLastDecay = llSample;
+			}
+		}
+		else
+		{
+			float fRecent = sDetector.afRecent[iPosition];
+
+			sDetector.dPeak = max( sDetector.dPeak, dIntegrated );
+
+			if( fabs( fRecent ) > fabs( sDetector.dPeakValue ) )
+			{
+				sDetector.dPeakValue = fRecent;
+				sDetector.llPeak = llSample;
+			}
+
+			if( dIntegrated < 0.5 * dThreshold )
+			{
+				if( sDetector.llLastDetection < 0 || sDetector.llPeak - sDetector.llLastDetection >= sDetector.llRefractorySamples )
+				{
+					vAddEvent( sDetector, iDetector, sDetector.llPeak, 0, sDetector.dPeakValue + sDetector.dBaseline, pasEvents );
+					sDetector.llLastDetection = sDetector.llPeak;
+					sDetector.dSignalLevel = 0.125 * sDetector.dPeak + 0.875 * sDetector.dSignalLevel;
+				}
+				else
+				{
+					sDetector.dNoiseLevel = 0.125 * sDetector.dPeak + 0.875 * sDetector.dNoiseLevel;	// T wave or artifact
+				}
+
+				sDetector.bActive = false;
+			}
+		}
+	}
+
+	sDetector.fPrevious2 = (iNumberSamples > 1) ? pfData[iNumberSamples - 2] : sDetector.fPrevious1;
+	sDetector.fPrevious1 = pfData[iNumberSamples - 1];
+}
+
+/*!
+*   \brief Read consecutive data records and run every detector over them, carrying state across calls.
+*	\note Events still open at the end (an ongoing excursion or flat run) are reported by a later
+*	      call, or by vFlush() at the end of the recording. New events are appended in onset order.
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \param pasEvents - detections are appended here
+*   \return Status of operation (EDF_FILE_CONTENTS_ERROR for an EDF+ record without a time keeping TAL).
+*/
+
+CReadEDF::edfStatus_E CDetectEDF::eDetectRecords( long long llFirstRecord, long long llNumberRecords, vector<event_S> *pasEvents )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	size_t iFirstEvent = (pasEvents != NULL) ? pasEvents->size() : 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_poEDF == NULL || !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		if( pasEvents == NULL || llNumberRecords < 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		int iSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+
+		if( llFirstRecord != m_llNextRecord )
+		{
+			vReset();
+
+			for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+			{
+				m_allNextSamples[iThisSignal] = llFirstRecord * m_poEDF->iGetNumberSamples( iThisSignal );
+			}
+		}
+
+		m_asBlock.resize( (size_t)BLOCK_RECORDS * iSamplesPerRecord );
+		m_afSegment.resize( iSamplesPerRecord );
+		m_afFeature.resize( iSamplesPerRecord );
+
+		for( long long llDone = 0; llDone < llNumberRecords; llDone += BLOCK_RECORDS )
+		{
+			int iBlockRecords = (int)min( (long long)BLOCK_RECORDS, llNumberRecords - llDone );
+
+			eEdfStatus = m_poEDF->eReadRecords( llFirstRecord + llDone, iBlockRecords, &m_asBlock[0] );
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				m_llNextRecord = -1;
+				break;
+			}
+
+			for( int iRecord = 0; iRecord < iBlockRecords && eEdfStatus == CReadEDF::EDF_SUCCESS; iRecord++ )
+			{
+				const short int *psRecord = &m_asBlock[(size_t)iRecord * iSamplesPerRecord];
+				long long llRecord = llFirstRecord + llDone + iRecord;
+
+				if( m_iAnnotationSignal >= 0 )
+				{
+					double dOnset = 0.0;
+
+					if( !bReadOnset( psRecord, &dOnset ) )
+					{
+						eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+						break;
+					}
+
+					if( llRecord >= (long long)m_adRecordOnsets.size() )
+					{
+						m_adRecordOnsets.resize( (size_t)llRecord + 1, NAN );
+					}
+
+					m_adRecordOnsets[llRecord] = dOnset;
+
+					// EDF+D gap (onsets are decimal text, hence the tolerance): close open events and start over:
+					if( llRecord > 0 && !isnan( m_adRecordOnsets[llRecord - 1] )
+						&& fabs( dOnset - m_adRecordOnsets[llRecord - 1] - m_poEDF->dGetRecordDuration() ) > 1e-3 )
+					{
+						vFlush( pasEvents );
+
+						for( size_t iDetector = 0; iDetector < m_asDetectors.size(); iDetector++ )
+						{
+							vResetDetector( m_asDetectors[iDetector] );
+						}
+					}
+				}
+
+				for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+				{
+					int iOffset = m_poEDF->iGetSignalOffset( iThisSignal );
+					int iNumberSamples = m_poEDF->iGetNumberSamples( iThisSignal );
+					long long llBase = m_allNextSamples[iThisSignal];
+					bool bCalibrated = false;
+
+					m_allNextSamples[iThisSignal] += iNumberSamples;
+
+					if( iNumberSamples <= 0 )
+					{
+						continue;
+					}
+
+					for( size_t iDetector = 0; iDetector < m_asDetectors.size(); iDetector++ )
+					{
+						detector_S &sDetector = m_asDetectors[iDetector];
+
+						if( sDetector.iSignal != iThisSignal )
+						{
+							continue;
+						}
+
+						// Calibrate once per segment, shared by all detectors on this signal:
+						if( !bCalibrated )
+						{
+							float fGain = (float)m_adGains[iThisSignal];
+							float fOffset = (float)m_adOffsets[iThisSignal];
+							const short int *psSegment = &psRecord[iOffset];
+							float *pfSegment = &m_afSegment[0];
+
+							for( int i = 0; i < iNumberSamples; i++ )
+							{
+								pfSegment[i] = fGain * psSegment[i] + fOffset;
+							}
+
+							bCalibrated = true;
+						}
+
+						switch( sDetector.eType )
+						{
+							case DETECT_THRESHOLD:
+								vRunThreshold( sDetector, (int)iDetector, &m_afSegment[0], iNumberSamples, llBase, pasEvents );
+								break;
+
+							case DETECT_SPIKE:
+								vRunSpike( sDetector, (int)iDetector, &m_afSegment[0], iNumberSamples, llBase, pasEvents );
+								break;
+
+							case DETECT_FLAT_LINE:
+								vRunFlatLine( sDetector, (int)iDetector, &m_afSegment[0], iNumberSamples, llBase, pasEvents );
+								break;
+
+							case DETECT_R_PEAK:
+								vRunRPeak( sDetector, (int)iDetector, &m_afSegment[0], iNumberSamples, llBase, pasEvents );
+								break;
+						}
+					}
+				}
+			}
+
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				m_llNextRecord = -1;
+				break;
+			}
+
+			m_llNextRecord = llFirstRecord + llDone + iBlockRecords;
+		}
+
+		if( llNumberRecords == 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_SUCCESS;
+		}
+	} //for()
+
+	if( pasEvents != NULL )
+	{
+		stable_sort( pasEvents->begin() + iFirstEvent, pasEvents->end(),
+			[]( const event_S &sLeft, const event_S &sRight ) { return( sLeft.dOnset < sRight.dOnset ); } );
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Report events still open at the current position (end of recording) and close them.
+*   \param pasEvents - detections are appended here
+*/
+
+void CDetectEDF::vFlush( vector<event_S> *pasEvents )
+{
+	size_t iFirstEvent = pasEvents->size();
+
+	for( size_t iDetector = 0; iDetector < m_asDetectors.size(); iDetector++ )
+	{
+		detector_S &sDetector = m_asDetectors[iDetector];
+		long long llEnd = m_allNextSamples[sDetector.iSignal];
+
+		if( !sDetector.bActive )
+		{
+			continue;
+		}
+
+		switch( sDetector.eType )
+		{
+			case DETECT_THRESHOLD:
+			case DETECT_FLAT_LINE:
+				if( llEnd - sDetector.llStart >= sDetector.llMinimumSamples )
+				{
+					double dValue = (sDetector.eType == DETECT_THRESHOLD) ? sDetector.dPeakValue : sDetector.dRunMinimum;
+					vAddEvent( sDetector, (int)iDetector, sDetector.llStart, llEnd - sDetector.llStart, dValue, pasEvents );
+				}
+				break;
+
+			case DETECT_SPIKE:
+				vAddEvent( sDetector, (int)iDetector, sDetector.llPeak, 0, sDetector.dPeakValue, pasEvents );
+				break;
+
+			case DETECT_R_PEAK:
+				if( sDetector.llLastDetection < 0 || sDetector.llPeak - sDetector.llLastDetection >= sDetector.llRefractorySamples )
+				{
+					vAddEvent( sDetector, (int)iDetector, sDetector.llPeak, 0, sDetector.dPeakValue + sDetector.dBaseline, pasEvents );
+				}
+				break;
+		}
+
+		sDetector.bActive = false;
+	}
+
+	stable_sort( pasEvents->begin() + iFirstEvent, pasEvents->end(),
+		[]( const event_S &sLeft, const event_S &sRight ) { return( sLeft.dOnset < sRight.dOnset ); } );
+}
+
+/*!
+*   \brief Format a number for a TAL: fixed point, trailing zeros removed.
+*/
+
+static string sFormatSeconds( double dSeconds, bool bSigned )
+{
+	char szValue[64];
+
+	snprintf( szValue, sizeof(szValue), bSigned ? "%+.6f" : "%.6f", dSeconds );
+
+	string sValue( szValue );
+
+	sValue.erase( sValue.find_last_not_of( '0' ) + 1 );
+	if( sValue[sValue.size() - 1] == '.' )
+	{
+		sValue.erase( sValue.size() - 1 );
+	}
+
+	return( sValue );
+}
+
+/*!
+*   \brief Format events as EDF+ TALs: "+Onset\x15Duration\x14Text\x14\0" (duration left out for point events).
+*	\note Ready for an "EDF Annotations" signal; the time keeping TAL of each data record is not included.
+*   \param asEvents - detections
+*   \return Concatenated TALs (with embedded nul terminators).
+*/
+
+string CDetectEDF::sFormatAnnotations( const vector<event_S> &asEvents )
+{
+	string sAnnotations;
+
+	for( size_t iEvent = 0; iEvent < asEvents.size(); iEvent++ )
+	{
+		const event_S &sEvent = asEvents[iEvent];
+		const char *pszLabel = pszGetDetectorLabel( sEvent.iDetector );
+
+		sAnnotations += sFormatSeconds( sEvent.dOnset, true );
+
+		if( sEvent.dDuration > 0.0 )
+		{
+			sAnnotations += '\x15';
+			sAnnotations += sFormatSeconds( sEvent.dDuration, false );
+		}
+
+		sAnnotations += '\x14';
+		sAnnotations += (pszLabel != NULL) ? pszLabel : "";
+		sAnnotations += '\x14';
+		sAnnotations += '\0';
+	}
+
+	return( sAnnotations );
+}
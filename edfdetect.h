@@ -0,0 +1,158 @@
+#ifndef EDFDETECT_H
+#define EDFDETECT_H
+
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for streaming event detection (threshold, spike, flat line, R-peak) on EDF data records.
+*/
+
+/*! \class CDetectEDF
+    \brief Runs any number of per-signal detectors in one pass over the CReadEDF record read path.
+
+	Data records are read in blocks with CReadEDF::eReadRecords(); each signal segment that has
+	detectors is calibrated once and handed to all of them while it is still in cache. Detector
+	state (open excursions, running baselines, thresholds, refractory periods) is carried from one
+	record to the next, so consecutive eDetectRecords() calls behave like one uninterrupted
+	recording; a call that does not continue where the previous one stopped starts over (vReset()).
+	Each detector first checks a whole segment with a branch free (vectorizable) pass - minimum,
+	maximum or feature maximum - and only walks it sample by sample when something may happen.
+
+	Detections are time stamped in seconds from the start of the file and can be formatted as
+	EDF+ time-stamped annotation lists (TALs) with sFormatAnnotations(). For EDF+ files the onset
+	of every data record is taken from its time keeping TAL, so sub-second starts and EDF+D gaps
+	give valid annotation onsets; at a gap open events are closed and the detectors start over.
+
+	\code
+	CDetectEDF oDetect( poEDF );
+	oDetect.eAddRPeak( poEDF->iFindSignal( "ECG" ) );
+	oDetect.eAddFlatLine( CDetectEDF::ALL_SIGNALS, 1.0, 5.0 );
+	oDetect.eDetectRecords( 0, llNumberRecords, &asEvents );
+	oDetect.vFlush( &asEvents );
+	string sTal = oDetect.sFormatAnnotations( asEvents );
+	\endcode
+*/
+
+class CDetectEDF
+{
+	public:
+
+	enum detectConstants_E
+	{
+		ALL_SIGNALS = -1,				///< signal number that adds a detector to every signal
+		BLOCK_RECORDS = 16,				///< data records read per block by eDetectRecords()
+	};
+
+	enum detectorType_E
+	{
+		DETECT_THRESHOLD,				///< physical value outside [low, high] for a minimum time
+		DETECT_SPIKE,					///< nonlinear energy above a multiple of its running mean
+		DETECT_FLAT_LINE,				///< peak-to-peak range below a tolerance for a minimum time
+		DETECT_R_PEAK,					///< ECG QRS complexes (Pan-Tompkins style)
+	};
+
+	//! \brief One detection.
+	struct event_S
+	{
+		double dOnset;					///< seconds from the start of the file (EDF+: on the time keeping TAL clock)
+		double dDuration;				///< seconds (0 for point events: spikes, R-peaks)
+		double dValue;					///< physical value at the peak (or the run minimum for flat lines)
+		int iSignal;
+		int iDetector;					///< index in the order the detectors were added
+	};
+
+	CDetectEDF( CReadEDF *poEDF );
+	~CDetectEDF( void );
+
+	CReadEDF::edfStatus_E eAddThreshold( int iSignalNumber, double dLow, double dHigh, double dMinimumSeconds = 0.0 );
+	CReadEDF::edfStatus_E eAddSpike( int iSignalNumber, double dFactor = 30.0, double dRefractorySeconds = 0.2 );
+	CReadEDF::edfStatus_E eAddFlatLine( int iSignalNumber, double dTolerance, double dMinimumSeconds );
+	CReadEDF::edfStatus_E eAddRPeak( int iSignalNumber );
+
+	//! \brief Return the number of detectors added.
+	int iGetNumberDetectors( void )
+	{
+		return( (int)m_asDetectors.size() );
+	};
+
+	const char *pszGetDetectorLabel( int iDetector );
+
+	void vReset( void );
+
+	CReadEDF::edfStatus_E eDetectRecords( long long llFirstRecord, long long llNumberRecords, vector<event_S> *pasEvents );
+	void vFlush( vector<event_S> *pasEvents );
+
+	string sFormatAnnotations( const vector<event_S> &asEvents );
+
+	private:
+
+	static const double BASELINE_SECONDS;	///< spike detector: time constant of the running energy mean
+	static const double LEARN_SECONDS;		///< R-peak detector: initial threshold training (no beats reported)
+
+	//! \brief One detector with its parameters and running state.
+	struct detector_S
+	{
+		detectorType_E eType;
+		int iSignal;
+		string sLabel;					///< annotation text, e.g. "R-peak ECG"
+
+		// Parameters:
+		double dLow;					///< threshold: lower limit
+		double dHigh;					///< threshold: upper limit; flat line: tolerance; spike: factor
+		long long llMinimumSamples;		///< threshold, flat line: shortest reported event
+		long long llRefractorySamples;	///< spike, R-peak: dead time after a detection
+		int iWindowSamples;				///< R-peak: moving integration window
+
+		// State:
+		bool bActive;					///< inside an excursion / run / candidate
+		long long llStart;				///< first sample of the excursion or run
+		long long llPeak;				///< sample of the candidate peak
+		double dPeak;					///< feature value at the candidate peak
+		double dPeakValue;				///< physical value at the candidate peak
+		double dRunMinimum;				///< flat line: running range
+		double dRunMaximum;
+		double dBaseline;				///< spike: energy mean; R-peak: signal baseline
+		double dSignalLevel;			///< R-peak: running QRS energy peak level
+		double dNoiseLevel;				///< R-peak: running noise energy peak level
+		double dWindowSum;				///< R-peak: sum of the integration window
+		int iWindowPosition;
+		vector<float> afWindow;			///< R-peak: squared slopes in the integration window
+		vector<float> afRecent;			///< R-peak: baseline-removed values in the same window
+		long long llLastDetection;
+		long long llLastDecay;			///< R-peak: last threshold decay (no beats for a while)
+		bool bPrimed;					///< previous samples and baselines are valid
+		float fPrevious1;				///< x[n-1] from the previous segment
+		float fPrevious2;				///< x[n-2] from the previous segment
+	};
+
+	CReadEDF::edfStatus_E eAddDetector( detectorType_E eType, int iSignalNumber, double dLow, double dHigh,
+										double dMinimumSeconds, double dRefractorySeconds, const char *pszName );
+	void vResetDetector( detector_S &sDetector );
+	void vAddEvent( const detector_S &sDetector, int iDetector, long long llStart, long long llSamples, double dValue, vector<event_S> *pasEvents );
+	bool bReadOnset( const short int *psRecord, double *pdOnset );
+
+	void vRunThreshold( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents );
+	void vRunSpike( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents );
+	void vRunFlatLine( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents );
+	void vRunRPeak( detector_S &sDetector, int iDetector, const float *pfData, int iNumberSamples, long long llBase, vector<event_S> *pasEvents );
+
+	CReadEDF *m_poEDF;
+	int m_iNumberSignals;
+	vector<detector_S> m_asDetectors;
+	vector<double> m_adGains;
+	vector<double> m_adOffsets;
+	vector<double> m_adSampleRates;
+	vector<long long> m_allNextSamples;		///< per signal: sample number of the next segment
+	long long m_llNextRecord;				///< record that continues the current state (-1 = none)
+	int m_iAnnotationSignal;				///< EDF+ time keeping signal (-1 for plain EDF)
+	vector<double> m_adRecordOnsets;		///< EDF+: onset of every record read so far (NaN if not read)
+	vector<short int> m_asBlock;			///< raw data records of the current block
+	vector<float> m_afSegment;				///< one calibrated signal segment
+	vector<float> m_afFeature;				///< detector feature of one segment (energy, squared slope)
+}; //class CDetectEDF
+
+#endif // EDFDETECT_H
@@ -0,0 +1,587 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for record level EDF editing (crop, split, concatenate).
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "edfedit.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#endif
+
+using namespace std;
+
+/*!
+*   \brief Read the raw header record of a file.
+*   \return true if iHeaderBytes bytes were read.
+*/
+
+bool CEditEDF::bReadHeader( const char *pszInputFile, vector<char> &acHeader, int iHeaderBytes )
+{
+	ifstream oInput( pszInputFile, ios::in | ios::binary );
+
+	acHeader.resize( iHeaderBytes );
+	oInput.read( &acHeader[0], iHeaderBytes );
+
+	return( !oInput.fail() );
+}
+
+/*!
+*   \brief Create (truncate) a file and write a header record to it.
+*   \return true if written.
+*/
+
+bool CEditEDF::bWriteHeader( const char *pszOutputFile, const vector<char> &acHeader )
+{
+	ofstream oOutput( pszOutputFile, ios::out | ios::binary | ios::trunc );
+
+	oOutput.write( &acHeader[0], acHeader.size() );
+	oOutput.close();
+
+	return( !oOutput.fail() );
+}
+
+/*!
+*   \brief Return true for an EDF+ header (reserved field starts with "EDF+").
+*/
+
+bool CEditEDF::bIsEdfPlus( const vector<char> &acHeader )
+{
+	return( memcmp( &acHeader[offsetof( CReadEDF::headerFixedLength_S, acReserved44 )], "EDF+", 4 ) == 0 );
+}
+
+/*!
+*   \brief Store a left-justified, space padded ASCII header field.
+*/
+
+void CEditEDF::vSetField( vector<char> &acHeader, size_t iOffset, size_t iSize, const char *pszValue )
+{
+	size_t iLength = min( strlen( pszValue ), iSize );
+
+	memset( &acHeader[iOffset], ' ', iSize );
+	memcpy( &acHeader[iOffset], pszValue, iLength );
+}
+
+/*!
+*   \brief Store the number of data records in a raw header.
+*/
+
+void CEditEDF::vSetNumberRecords( vector<char> &acHeader, long long llNumberRecords )
+{
+	char szValue[32];
+
+	snprintf( szValue, sizeof(szValue), "%lld", llNumberRecords );
+	vSetField( acHeader, offsetof( CReadEDF::headerFixedLength_S, acNumberRecords ), CReadEDF::eNumberRecordsSize, szValue );
+}
+
+/*!
+*   \brief Store the start date (dd.mm.yy) and time (hh.mm.ss) in a raw header.
+*   \param llSeconds - seconds since 1970-01-01 00:00:00 (see CReadEDF::eGetStartSeconds())
+*/
+
+void CEditEDF::vSetStartSeconds( vector<char> &acHeader, long long llSeconds )
+{
+	long long llDays = llSeconds / 86400;
+	long long llSecondOfDay = llSeconds % 86400;
+	char szValue[32];
+
+	if( llSecondOfDay < 0 )
+	{
+		llSecondOfDay += 86400;
+		llDays--;
+	}
+
+	// Civil date from days since 1970-01-01 (inverse of CReadEDF::eGetStartSeconds()):
+	long long llShifted = llDays + 719468;
+	long long llEra = (llShifted >= 0 ? llShifted : llShifted - 146096) / 146097;
+	long long llDayOfEra = llShifted - llEra * 146097;
+	long long llYearOfEra = (llDayOfEra - llDayOfEra / 1460 + llDayOfEra / 36524 - llDayOfEra / 146096) / 365;
+	long long llDayOfYear = llDayOfEra - (365 * llYearOfEra + llYearOfEra / 4 - llYearOfEra / 100);
+	long long llMonthIndex = (5 * llDayOfYear + 2) / 153;
+	int iDay = (int)(llDayOfYear - (153 * llMonthIndex + 2) / 5 + 1);
+	int iMonth = (int)(llMonthIndex < 10 ? llMonthIndex + 3 : llMonthIndex - 9);
+	int iYear = (int)(llYearOfEra + llEra * 400 + (iMonth <= 2 ? 1 : 0));
+
+	snprintf( szValue, sizeof(szValue), "%02d.%02d.%02d", iDay, iMonth, iYear % 100 );
+	vSetField( acHeader, offsetof( CReadEDF::headerFixedLength_S, acStartDate ), CReadEDF::eStartDateSize, szValue );
+
+	snprintf( szValue, sizeof(szValue), "%02d.%02d.%02d", (int)(llSecondOfDay / 3600), (int)((llSecondOfDay / 60) % 60), (int)(llSecondOfDay % 60) );
+	vSetField( acHeader, offsetof( CReadEDF::headerFixedLength_S, acStartTime ), CReadEDF::eStartTimeSize, szValue );
+}
+
+/*!
+*   \brief Return the number of data records of an open file; an unknown count (-1) is derived from the file size.
+*/
+
+long long CEditEDF::llCountRecords( CReadEDF &oEDF, const char *pszInputFile )
+{
+	long long llNumberRecords = 0;
+	struct stat sStat;
+
+	oEDF.eGetNumberRecords( &llNumberRecords );
+
+	if( llNumberRecords < 0 )
+	{
+		llNumberRecords = (oEDF.iGetRecordSize() > 0 && stat( pszInputFile, &sStat ) == 0)
+			? max( 0LL, ((long long)sStat.st_size - oEDF.iGetHeaderBytes()) / oEDF.iGetRecordSize() ) : 0;
+	}
+
+	return( llNumberRecords );
+}
+
+/*!
+*   \brief Return true if both names refer to the same existing file (hard links and other spellings included).
+*/
+
+bool CEditEDF::bSameFile( const char *pszFirstFile, const char *pszSecondFile )
+{
+	struct stat sFirst;
+	struct stat sSecond;
+
+	if( stat( pszFirstFile, &sFirst ) != 0 || stat( pszSecondFile, &sSecond ) != 0 )
+	{
+		return( false );			// the output does not exist yet
+	}
+
+	if( sFirst.st_ino != 0 )
+	{
+		return( sFirst.st_dev == sSecond.st_dev && sFirst.st_ino == sSecond.st_ino );
+	}
+
+	return( strcmp( pszFirstFile, pszSecondFile ) == 0 );		// no inode numbers here (Windows)
+}
+
+/*!
+*   \brief Copy a byte range from one file into another (existing) file without user space buffering where possible.
+*   \param pszInputFile - source file
+*   \param llInputOffset - source byte offset
+*   \param pszOutputFile - destination file (must exist)
+*   \param llOutputOffset - destination byte offset
+*   \param llBytes - number of bytes
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CEditEDF::eCopyBytes( const char *pszInputFile, long long llInputOffset,
+	const char *pszOutputFile, long long llOutputOffset, long long llBytes )
+{
+#if defined(__linux__)
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	int iInput = open( pszInputFile, O_RDONLY );
+	int iOutput = open( pszOutputFile, O_WRONLY );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( iInput < 0 || iOutput < 0 )
+		{
+			break;
+		}
+
+		loff_t llIn = llInputOffset;
+		loff_t llOut = llOutputOffset;
+		bool bUseSendfile = false;
+
+		eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+		while( llBytes > 0 )
+		{
+			size_t iChunk = (size_t)min( llBytes, 1LL << 30 );
+			ssize_t iCopied = -1;
+
+			if( !bUseSendfile )
+			{
+				iCopied = copy_file_range( iInput, &llIn, iOutput, &llOut, iChunk, 0 );
+
+				// Older kernels and some file system pairs can not do it; fall back to sendfile():
+				if( iCopied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP) )
+				{
+					bUseSendfile = true;
+				}
+			}
+
+			if( bUseSendfile )
+			{
+				off_t lIn = (off_t)llIn;
+
+				if( lseek( iOutput, (off_t)llOut, SEEK_SET ) < 0 )
+				{
+					iCopied = -1;
+				}
+				else
+				{
+					iCopied = sendfile( iOutput, iInput, &lIn, iChunk );
+				}
+
+				if( iCopied > 0 )
+				{
+					llIn += iCopied;
+					llOut += iCopied;
+				}
+			}
+
+			if( iCopied <= 0 )
+			{
+				eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;	// short input file or write error
+				break;
+			}
+
+			llBytes -= iCopied;
+		}
+	} //for()
+
+	if( iInput >= 0 )
+	{
+		close( iInput );
+	}
+
+	if( iOutput >= 0 )
+	{
+		close( iOutput );
+	}
+
+	return( eEdfStatus );
+#else
+	ifstream oInput( pszInputFile, ios::in | ios::binary );
+	fstream oOutput( pszOutputFile, ios::in | ios::out | ios::binary );
+	vector<char> acBuffer( 1 << 20 );
+
+	if( oInput.fail() || oOutput.fail() )
+	{
+		return( CReadEDF::EDF_FILE_OPEN_ERROR );
+	}
+
+	oInput.seekg( (streamoff)llInputOffset );
+	oOutput.seekp( (streamoff)llOutputOffset );
+
+	while( llBytes > 0 )
+	{
+		streamsize iChunk = (streamsize)min( llBytes, (long long)acBuffer.size() );
+
+		oInput.read( &acBuffer[0], iChunk );
+		oOutput.write( &acBuffer[0], iChunk );
+
+		if( oInput.fail() || oOutput.fail() )
+		{
+			return( CReadEDF::EDF_FILE_CONTENTS_ERROR );
+		}
+
+		llBytes -= iChunk;
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+#endif
+}
+
+/*!
+*   \brief Write an excerpt of whole data records to a new file.
+*   \param pszInputFile - input file
+*   \param pszOutputFile - output file (overwritten; must not be the input)
+*   \param llFirstRecord - first data record to keep (0 based)
+*   \param llNumberRecords - number of data records to keep
+*   \return Status of operation (EDF_TIME_ERROR if a plain EDF excerpt would not start on a whole second).
+*/
+
+CReadEDF::edfStatus_E CEditEDF::eCrop( char *pszInputFile, char *pszOutputFile, long long llFirstRecord, long long llNumberRecords )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	CReadEDF oEDF( pszInputFile, &eEdfStatus );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		long long llInputRecords = llCountRecords( oEDF, pszInputFile );
+
+		if( bSameFile( pszInputFile, pszOutputFile ) )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		if( llFirstRecord < 0 || llNumberRecords <= 0 || llFirstRecord + llNumberRecords > llInputRecords )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_RECORD_REQUESTED;
+			break;
+		}
+
+		vector<char> acHeader;
+		long long llRecordSize = oEDF.iGetRecordSize();
+		long long llHeaderBytes = oEDF.iGetHeaderBytes();
+
+		if( !bReadHeader( pszInputFile, acHeader, (int)llHeaderBytes ) )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		vSetNumberRecords( acHeader, llNumberRecords );
+
+		if( llFirstRecord > 0 )
+		{
+			if( bIsEdfPlus( acHeader ) )
+			{
+				vSetField( acHeader, offsetof( CReadEDF::headerFixedLength_S, acReserved44 ), CReadEDF::eReserved44Size, "EDF+D" );
+			}
+			else
+			{
+				// A plain EDF header holds whole seconds only; a fractional offset cannot be stored:
+				long long llStartSeconds = 0;
+				double dOffset = llFirstRecord * oEDF.dGetRecordDuration();
+
+				eEdfStatus = oEDF.eGetStartSeconds( &llStartSeconds );
+				if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+				{
+					break;
+				}
+
+				if( fabs( dOffset - floor( dOffset + 0.5 ) ) > 1e-6 )
+				{
+					eEdfStatus = CReadEDF::EDF_TIME_ERROR;
+					break;
+				}
+
+				vSetStartSeconds( acHeader, llStartSeconds + (long long)floor( dOffset + 0.5 ) );
+			}
+		}
+
+		if( !bWriteHeader( pszOutputFile, acHeader ) )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+			break;
+		}
+
+		eEdfStatus = eCopyBytes( pszInputFile, llHeaderBytes + llFirstRecord * llRecordSize,
+			pszOutputFile, llHeaderBytes, llNumberRecords * llRecordSize );
+	} //for()
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Write an excerpt covering a time range (rounded out to whole data records).
+*   \param pszInputFile - input file
+*   \param pszOutputFile - output file (overwritten; must not be the input)
+*   \param dStartSeconds - start of the excerpt, in seconds from the start of the recording
+*   \param dDurationSeconds - duration of the excerpt in seconds
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CEditEDF::eCropTime( char *pszInputFile, char *pszOutputFile, double dStartSeconds, double dDurationSeconds )
+{
+	double dDuration = 0.0;
+
+	{
+		CReadEDF oEDF( pszInputFile );
+
+		if( !oEDF.bReadyStatus() || oEDF.dGetRecordDuration() <= 0.0 )
+		{
+			return( CReadEDF::EDF_FILE_CONTENTS_ERROR );
+		}
+
+		dDuration = oEDF.dGetRecordDuration();
+	}
+
+	if( dStartSeconds < 0.0 || dDurationSeconds <= 0.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	long long llFirstRecord = (long long)floor( dStartSeconds / dDuration );
+	long long llEndRecord = (long long)ceil( (dStartSeconds + dDurationSeconds) / dDuration );
+
+	return( eCrop( pszInputFile, pszOutputFile, llFirstRecord, llEndRecord - llFirstRecord ) );
+}
+
+/*!
+*   \brief Split a file into parts of llRecordsPerPart data records (the last part may be shorter).
+*	\note Parts are named <prefix>_001.edf, <prefix>_002.edf, ...
+*   \param pszInputFile - input file
+*   \param pszOutputPrefix - output file name prefix
+*   \param llRecordsPerPart - data records per part
+*   \param piNumberParts - loaded with the number of parts written if not null
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CEditEDF::eSplit( char *pszInputFile, const char *pszOutputPrefix, long long llRecordsPerPart, int *piNumberParts )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	long long llNumberRecords = 0;
+	int iNumberParts = 0;
+
+	{
+		CReadEDF oEDF( pszInputFile, &eEdfStatus );
+		llNumberRecords = llCountRecords( oEDF, pszInputFile );
+	}
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS && llRecordsPerPart <= 0 )
+	{
+		eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+	}
+
+	for( long long llFirstRecord = 0; eEdfStatus == CReadEDF::EDF_SUCCESS && llFirstRecord < llNumberRecords; llFirstRecord += llRecordsPerPart )
+	{
+		string sOutputFile( pszOutputPrefix );
+		char szSuffix[32];
+
+		snprintf( szSuffix, sizeof(szSuffix), "_%03d.edf", iNumberParts + 1 );
+		sOutputFile += szSuffix;
+
+		eEdfStatus = eCrop( pszInputFile, &sOutputFile[0], llFirstRecord, min( llRecordsPerPart, llNumberRecords - llFirstRecord ) );
+		if( eEdfStatus == CReadEDF::EDF_SUCCESS )
+		{
+			iNumberParts++;
+		}
+	}
+
+	if( piNumberParts != NULL )
+	{
+		*piNumberParts = iNumberParts;
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Concatenate files with compatible headers into one file.
+*	\note Compatible means the same version, patient, record duration, signal count and identical
+*	      signal headers (label through samples per record). The output keeps the first header's start,
+*	      so a gap between inputs would shift every later sample; by default it is refused.
+*   \param apszInputFiles - input files, in recording order
+*   \param iNumberInputs - number of input files
+*   \param pszOutputFile - output file (overwritten; must not be one of the inputs)
+*   \param bRequireContiguous - require each file to start where the previous one ended (EDF_TIME_ERROR if not);
+*	       false joins them regardless, dropping any gaps from the time line
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CEditEDF::eConcatenate( char **apszInputFiles, int iNumberInputs, char *pszOutputFile, bool bRequireContiguous )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+	vector<char> acFirstHeader;
+	vector<long long> allRecords( max( iNumberInputs, 0 ) );
+	long long llTotalRecords = 0;
+	long long llRecordSize = 0;
+	int iHeaderBytes = 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( apszInputFiles == NULL || iNumberInputs <= 0 )
+		{
+			break;
+		}
+
+		long long llExpectedStart = 0;
+		int iInput = 0;
+
+		for( ; iInput < iNumberInputs; iInput++ )
+		{
+			CReadEDF oEDF( apszInputFiles[iInput], &eEdfStatus );
+			vector<char> acHeader;
+			long long llStartSeconds = 0;
+
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				break;
+			}
+
+			if( bSameFile( apszInputFiles[iInput], pszOutputFile ) )
+			{
+				eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+				break;
+			}
+
+			eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+
+			if( !bReadHeader( apszInputFiles[iInput], acHeader, oEDF.iGetHeaderBytes() ) || bIsEdfPlus( acHeader ) )
+			{
+				break;
+			}
+
+			allRecords[iInput] = llCountRecords( oEDF, apszInputFiles[iInput] );
+
+			if( bRequireContiguous )
+			{
+				eEdfStatus = oEDF.eGetStartSeconds( &llStartSeconds );
+				if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+				{
+					break;
+				}
+
+				eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			}
+
+			if( iInput == 0 )
+			{
+				acFirstHeader = acHeader;
+				iHeaderBytes = oEDF.iGetHeaderBytes();
+				llRecordSize = oEDF.iGetRecordSize();
+			}
+			else
+			{
+				// Version, patient, duration and signal count, then all signal headers except the reserved field:
+				size_t iVersion = offsetof( CReadEDF::headerFixedLength_S, acFormat );
+				size_t iPatient = offsetof( CReadEDF::headerFixedLength_S, acLocalPatientID );
+				size_t iDuration = offsetof( CReadEDF::headerFixedLength_S, acDuration );
+				size_t iSignalHeaders = (size_t)(iHeaderBytes - sizeof(CReadEDF::headerFixedLength_S)) / sizeof(CReadEDF::headerVariableLength_S)
+					* (sizeof(CReadEDF::headerVariableLength_S) - CReadEDF::eReserved32Size);
+
+				if( acHeader.size() != acFirstHeader.size()
+					|| memcmp( &acHeader[iVersion], &acFirstHeader[iVersion], CReadEDF::eFormatSize ) != 0
+					|| memcmp( &acHeader[iPatient], &acFirstHeader[iPatient], CReadEDF::eLocalPatientIDSize ) != 0
+					|| memcmp( &acHeader[iDuration], &acFirstHeader[iDuration], CReadEDF::eDurationSize + CReadEDF::eNumberSignalsSize ) != 0
+					|| memcmp( &acHeader[sizeof(CReadEDF::headerFixedLength_S)], &acFirstHeader[sizeof(CReadEDF::headerFixedLength_S)], iSignalHeaders ) != 0 )
+				{
+					break;
+				}
+
+				if( bRequireContiguous && llStartSeconds != llExpectedStart )
+				{
+					eEdfStatus = CReadEDF::EDF_TIME_ERROR;
+					break;
+				}
+			}
+
+			llExpectedStart = llStartSeconds + (long long)floor( allRecords[iInput] * oEDF.dGetRecordDuration() + 0.5 );
+			llTotalRecords += allRecords[iInput];
+			eEdfStatus = CReadEDF::EDF_SUCCESS;
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		vSetNumberRecords( acFirstHeader, llTotalRecords );
+
+		if( !bWriteHeader( pszOutputFile, acFirstHeader ) )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+			break;
+		}
+
+		long long llOutputOffset = iHeaderBytes;
+
+		for( iInput = 0; iInput < iNumberInputs && eEdfStatus == CReadEDF::EDF_SUCCESS; iInput++ )
+		{
+			eEdfStatus = eCopyBytes( apszInputFiles[iInput], iHeaderBytes, pszOutputFile, llOutputOffset, allRecords[iInput] * llRecordSize );
+			llOutputOffset += allRecords[iInput] * llRecordSize;
+		}
+	} //for()
+
+	return( eEdfStatus );
+}
@@ -0,0 +1,57 @@
+#ifndef EDFEDIT_H
+#define EDFEDIT_H
+
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for record level EDF editing (crop, split, concatenate).
+*/
+
+/*! \class CEditEDF
+    \brief Crop, split and concatenate EDF files by whole data records, without decoding samples.
+
+	EDF data records are self-contained fixed-size blocks, so an excerpt is a rewritten header
+	(number of data records, start date/time) followed by a byte range of the input. On Linux the
+	range is moved by the kernel with copy_file_range() (which shares extents/reflinks on file
+	systems that support it, e.g. Btrfs and XFS) with a sendfile() fallback; elsewhere it is a
+	buffered stream copy. Samples never pass through the sample decoding path.
+
+	Start time: a plain EDF excerpt gets its header start date/time moved by the start of the
+	first record kept (whole seconds; an excerpt starting within a second is refused with
+	EDF_TIME_ERROR). EDF+ annotation onsets are relative to the header start time, so an EDF+
+	excerpt keeps the original start time and is marked EDF+D (discontinuous), which keeps every
+	onset valid. Concatenation of EDF+ files is refused for the same reason (each file's onsets
+	restart at zero), and plain EDF inputs must follow each other without gaps unless the caller
+	explicitly accepts a shifted time line.
+
+	The output is truncated before any data is copied, so an output naming one of the inputs
+	(same file system object, however spelled) is refused with EDF_INVALID_PARAMETER.
+*/
+
+class CEditEDF
+{
+	public:
+
+	static CReadEDF::edfStatus_E eCrop( char *pszInputFile, char *pszOutputFile, long long llFirstRecord, long long llNumberRecords );
+	static CReadEDF::edfStatus_E eCropTime( char *pszInputFile, char *pszOutputFile, double dStartSeconds, double dDurationSeconds );
+	static CReadEDF::edfStatus_E eSplit( char *pszInputFile, const char *pszOutputPrefix, long long llRecordsPerPart, int *piNumberParts = NULL );
+	static CReadEDF::edfStatus_E eConcatenate( char **apszInputFiles, int iNumberInputs, char *pszOutputFile, bool bRequireContiguous = true );
+
+	static CReadEDF::edfStatus_E eCopyBytes( const char *pszInputFile, long long llInputOffset,
+		const char *pszOutputFile, long long llOutputOffset, long long llBytes );
+
+	private:
+	static bool bReadHeader( const char *pszInputFile, vector<char> &acHeader, int iHeaderBytes );
+	static bool bWriteHeader( const char *pszOutputFile, const vector<char> &acHeader );
+	static bool bIsEdfPlus( const vector<char> &acHeader );
+	static void vSetField( vector<char> &acHeader, size_t iOffset, size_t iSize, const char *pszValue );
+	static void vSetNumberRecords( vector<char> &acHeader, long long llNumberRecords );
+	static void vSetStartSeconds( vector<char> &acHeader, long long llSeconds );
+	static long long llCountRecords( CReadEDF &oEDF, const char *pszInputFile );
+	static bool bSameFile( const char *pszFirstFile, const char *pszSecondFile );
+}; //class CEditEDF
+
+#endif // EDFEDIT_H
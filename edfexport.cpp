@@ -0,0 +1,415 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for high-throughput export of EDF signals (raw float32, NPY, CSV).
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <charconv>
+#include <map>
+#include <thread>
+#include "edfexport.h"
+using namespace std;
+
+/*!
+*   \brief Constructor
+*   \param poEDF - reader (must stay valid for the lifetime of the exporter)
+*   \param iNumberThreads - CSV formatting threads (0 = one per hardware thread)
+*/
+
+CExportEDF::CExportEDF( CReadEDF *poEDF, int iNumberThreads )
+{
+	m_poEDF = poEDF;
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+	m_bCalibrate = false;
+	m_dStartSeconds = 0.0;
+	m_dDurationSeconds = -1.0;
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CExportEDF::~CExportEDF( void )
+{
+}
+
+/*!
+*   \brief Derive the export format from a format name or an output file name extension.
+*   \param pszName - "raw", "f32", "npy", "csv" or a file name ending in one of those
+*   \param peFormat - loaded with the format if recognized
+*   \return true if recognized.
+*/
+
+bool CExportEDF::bFormatFromName( const char *pszName, format_E *peFormat )
+{
+	const char *pszExtension = strrchr( pszName, '.' );
+	pszExtension = (pszExtension != NULL) ? pszExtension + 1 : pszName;
+
+	if( strcmp( pszExtension, "raw" ) == 0 || strcmp( pszExtension, "f32" ) == 0 || strcmp( pszExtension, "bin" ) == 0 )
+	{
+		*peFormat = FORMAT_RAW_F32;
+	}
+	else if( strcmp( pszExtension, "npy" ) == 0 )
+	{
+		*peFormat = FORMAT_NPY;
+	}
+	else if( strcmp( pszExtension, "csv" ) == 0 )
+	{
+		*peFormat = FORMAT_CSV;
+	}
+	else
+	{
+		return( false );
+	}
+
+	return( true );
+}
+
+/*!
+*   \brief Add a signal (by number) to the export selection; columns follow the selection order.
+*   \param iSignalNumber - signal number (0 based)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CExportEDF::eSelectSignal( int iSignalNumber )
+{
+	int iNumberSignals = 0;
+
+	m_poEDF->eGetNumberSignals( &iNumberSignals );
+
+	if( iSignalNumber < 0 || iSignalNumber >= iNumberSignals )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	m_aiSignals.push_back( iSignalNumber );
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add a signal (by label) to the export selection; columns follow the selection order.
+*   \param pszLabel - signal label (see CReadEDF::iFindSignal())
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CExportEDF::eSelectSignal( const char *pszLabel )
+{
+	return( eSelectSignal( m_poEDF->iFindSignal( pszLabel ) ) );
+}
+
+/*!
+*   \brief Limit the export to a time range.
+*   \param dStartSeconds - start, in seconds from the start of the recording
+*   \param dDurationSeconds - duration in seconds (negative = up to the end)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CExportEDF::eSetTimeRange( double dStartSeconds, double dDurationSeconds )
+{
+	if( dStartSeconds < 0.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	m_dStartSeconds = dStartSeconds;
+	m_dDurationSeconds = dDurationSeconds;
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Format CSV rows (time column plus one column per selected signal).
+*   \param pcOut - output buffer, large enough for iNumberRows lines
+*   \param pfRows - row-major values
+*   \param iNumberRows - number of rows
+*   \param llFirstRow - sample number of the first row (for the time column)
+*   \param dSampleRate - samples per second
+*   \return Number of characters written.
+*/
+
+int CExportEDF::iFormatRows( char *pcOut, const float *pfRows, int iNumberRows, long long llFirstRow, double dSampleRate )
+{
+	int iNumberColumns = (int)m_aiSignals.size();
+	char *pcNext = pcOut;
+
+	for( int iRow = 0; iRow < iNumberRows; iRow++ )
+	{
+		double dTime = (llFirstRow + iRow) / dSampleRate;
+
+		pcNext = to_chars( pcNext, pcNext + 32, dTime ).ptr;
+
+		for( int iColumn = 0; iColumn < iNumberColumns; iColumn++ )
+		{
+			*pcNext++ = ',';
+			pcNext = to_chars( pcNext, pcNext + 32, pfRows[(size_t)iRow * iNumberColumns + iColumn] ).ptr;
+		}
+
+		*pcNext++ = '\n';
+	}
+
+	return( (int)(pcNext - pcOut) );
+}
+
+/*!
+*   \brief Export the selected signals (all signals if none selected) over the time range.
+*   \param pszOutputFile - output file
+*   \param eFormat - output format
+*   \param pllRowsWritten - loaded with the number of rows (samples per signal) written if not null
+*   \return Status of operation (on failure after the output was created it is removed, and no rows count as written).
+*/
+
+CReadEDF::edfStatus_E CExportEDF::eExport( const char *pszOutputFile, format_E eFormat, long long *pllRowsWritten )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	long long llRowsWritten = 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		int iNumberSignals = 0;
+		long long llNumberRecords = 0;
+
+		m_poEDF->eGetNumberSignals( &iNumberSignals );
+		m_poEDF->eGetNumberRecords( &llNumberRecords );
+
+		// Default: the largest group of signals sharing one sample rate (ties to the higher rate), without annotations:
+		if( m_aiSignals.empty() )
+		{
+			vector<bool> abAnnotation( iNumberSignals );
+			map<int, int> oCounts;
+			int iBestSamples = 0;
+
+			for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+			{
+				int iSamples = m_poEDF->iGetNumberSamples( iThisSignal );
+
+				abAnnotation[iThisSignal] = (strncmp( m_poEDF->pszGetSignalLabel( iThisSignal ), "EDF Annotations", 15 ) == 0);
+				if( abAnnotation[iThisSignal] )
+				{
+					continue;
+				}
+
+				int iCount = ++oCounts[iSamples];
+
+				if( iCount > oCounts[iBestSamples] || (iCount == oCounts[iBestSamples] && iSamples > iBestSamples) )
+				{
+					iBestSamples = iSamples;
+				}
+			}
+
+			for( int iThisSignal = 0; iThisSignal < iNumberSignals && iBestSamples > 0; iThisSignal++ )
+			{
+				if( !abAnnotation[iThisSignal] && m_poEDF->iGetNumberSamples( iThisSignal ) == iBestSamples )
+				{
+					m_aiSignals.push_back( iThisSignal );
+				}
+			}
+
+			if( m_aiSignals.empty() )
+			{
+				eEdfStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;
+				break;
+			}
+		}
+
+		// One table needs one sample rate:
+		int iNumberColumns = (int)m_aiSignals.size();
+		int iSamplesPerSignal = m_poEDF->iGetNumberSamples( m_aiSignals[0] );
+		vector<double> adGains( iNumberColumns, 1.0 );
+		vector<double> adOffsets( iNumberColumns, 0.0 );
+		vector<int> aiOffsets( iNumberColumns );
+
+		eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+		for( int iColumn = 0; iColumn < iNumberColumns; iColumn++ )
+		{
+			if( m_poEDF->iGetNumberSamples( m_aiSignals[iColumn] ) != iSamplesPerSignal )
+			{
+				eEdfStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;
+			}
+
+			if( m_bCalibrate )
+			{
+				m_poEDF->eGetCalibration( m_aiSignals[iColumn], &adGains[iColumn], &adOffsets[iColumn] );
+			}
+
+			aiOffsets[iColumn] = m_poEDF->iGetSignalOffset( m_aiSignals[iColumn] );
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS || llNumberRecords <= 0 || m_poEDF->dGetRecordDuration() <= 0.0 )
+		{
+			eEdfStatus = (eEdfStatus != CReadEDF::EDF_SUCCESS) ? eEdfStatus : CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		// Time range to sample range [llFirstRow, llEndRow):
+		double dSampleRate = iSamplesPerSignal / m_poEDF->dGetRecordDuration();
+		long long llTotalRows = llNumberRecords * iSamplesPerSignal;
+		long long llFirstRow = min( llTotalRows, (long long)floor( m_dStartSeconds * dSampleRate + 0.5 ) );
+		long long llEndRow = llTotalRows;
+
+		if( m_dDurationSeconds >= 0.0 )
+		{
+			llEndRow = min( llTotalRows, llFirstRow + (long long)floor( m_dDurationSeconds * dSampleRate + 0.5 ) );
+		}
+
+		ofstream oOutput( pszOutputFile, ios::out | ios::binary | ios::trunc );
+
+		if( oOutput.fail() )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+			break;
+		}
+
+		if( eFormat == FORMAT_NPY )
+		{
+			char szHeader[128];
+			int iLength = snprintf( szHeader, sizeof(szHeader), "{'descr': '<f4', 'fortran_order': False, 'shape': (%lld, %d), }",
+				llEndRow - llFirstRow, iNumberColumns );
+
+			// Magic, version 1.0, header length; header padded with spaces so the data starts 64 byte aligned:
+			int iPadded = ((10 + iLength + 1 + 63) / 64) * 64 - 10;
+			string sHeader( "\x93NUMPY\x01\x00", 8 );
+
+			sHeader += (char)(iPadded & 0xFF);
+			sHeader += (char)((iPadded >> 8) & 0xFF);
+			sHeader += string( szHeader, iLength );
+			sHeader += string( iPadded - iLength - 1, ' ' );
+			sHeader += '\n';
+			oOutput.write( sHeader.data(), sHeader.size() );
+		}
+		else if( eFormat == FORMAT_CSV )
+		{
+			oOutput << "time";
+
+			for( int iColumn = 0; iColumn < iNumberColumns; iColumn++ )
+			{
+				char *pszLabel = m_poEDF->pszGetSignalLabel( m_aiSignals[iColumn] );
+				int iLength = (int)strlen( pszLabel );
+
+				while( iLength > 0 && pszLabel[iLength - 1] == ' ' )
+				{
+					iLength--;
+				}
+
+				oOutput << ',' << string( pszLabel, iLength );
+			}
+
+			oOutput << '\n';
+		}
+
+		int iSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+		vector<short int> asRecords( (size_t)CHUNK_RECORDS * iSamplesPerRecord );
+		vector<float> afRows( (size_t)CHUNK_RECORDS * iSamplesPerSignal * iNumberColumns );
+		vector< vector<char> > aacText( m_iNumberThreads );
+		vector<int> aiTextLengths( m_iNumberThreads );
+
+		for( long long llRow = llFirstRow; llRow < llEndRow; )
+		{
+			long long llRecord = llRow / iSamplesPerSignal;
+			long long llChunkRecords = min( (long long)CHUNK_RECORDS, (llEndRow - 1) / iSamplesPerSignal - llRecord + 1 );
+
+			eEdfStatus = m_poEDF->eReadRecords( llRecord, llChunkRecords, &asRecords[0] );
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				break;
+			}
+
+			// De-interleave the rows of this chunk that fall inside the range:
+			long long llChunkFirst = llRow;
+			long long llChunkEnd = min( llEndRow, (llRecord + llChunkRecords) * iSamplesPerSignal );
+			int iNumberRows = (int)(llChunkEnd - llChunkFirst);
+
+			for( int iRow = 0; iRow < iNumberRows; iRow++ )
+			{
+				long long llSample = llChunkFirst + iRow - llRecord * iSamplesPerSignal;
+				const short int *psRecord = &asRecords[(size_t)(llSample / iSamplesPerSignal) * iSamplesPerRecord];
+				int iIndex = (int)(llSample % iSamplesPerSignal);
+				float *pfRow = &afRows[(size_t)iRow * iNumberColumns];
+
+				for( int iColumn = 0; iColumn < iNumberColumns; iColumn++ )
+				{
+					pfRow[iColumn] = (float)(adGains[iColumn] * psRecord[aiOffsets[iColumn] + iIndex] + adOffsets[iColumn]);
+				}
+			}
+
+			if( eFormat == FORMAT_CSV )
+			{
+				// Format row slices in parallel, then write them in order:
+				int iNumberThreads = min( m_iNumberThreads, iNumberRows );
+				int iRowsPerThread = (iNumberRows + iNumberThreads - 1) / iNumberThreads;
+				vector<thread> aoThreads;
+
+				auto fnFormat = [&]( int iThread )
+				{
+					int iFirst = iThread * iRowsPerThread;
+					int iRows = max( 0, min( iRowsPerThread, iNumberRows - iFirst ) );
+
+					aacText[iThread].resize( (size_t)iRows * (iNumberColumns + 1) * 32 + 1 );
+					aiTextLengths[iThread] = iFormatRows( aacText[iThread].data(), &afRows[(size_t)iFirst * iNumberColumns],
+						iRows, llChunkFirst + iFirst, dSampleRate );
+				};
+
+				for( int iThread = 1; iThread < iNumberThreads; iThread++ )
+				{
+					aoThreads.push_back( thread( fnFormat, iThread ) );
+				}
+
+				fnFormat( 0 );
+
+				for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+				{
+					aoThreads[iThread].join();
+				}
+
+				for( int iThread = 0; iThread < iNumberThreads; iThread++ )
+				{
+					oOutput.write( aacText[iThread].data(), aiTextLengths[iThread] );
+				}
+			}
+			else
+			{
+				oOutput.write( reinterpret_cast<const char *>(&afRows[0]), (streamsize)iNumberRows * iNumberColumns * sizeof(float) );
+			}
+
+			if( oOutput.fail() )
+			{
+				eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+				break;
+			}
+
+			llRowsWritten += iNumberRows;
+			llRow = llChunkEnd;
+		}
+
+		// The final flush can fail too (ENOSPC, EIO); a partial file (an NPY header claims every row) is not left behind:
+		oOutput.close();
+
+		if( eEdfStatus == CReadEDF::EDF_SUCCESS && oOutput.fail() )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			remove( pszOutputFile );
+			llRowsWritten = 0;
+		}
+	} //for()
+
+	if( pllRowsWritten != NULL )
+	{
+		*pllRowsWritten = llRowsWritten;
+	}
+
+	return( eEdfStatus );
+}
@@ -0,0 +1,72 @@
+#ifndef EDFEXPORT_H
+#define EDFEXPORT_H
+
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for high-throughput export of EDF signals (raw float32, NPY, CSV).
+*/
+
+/*! \class CExportEDF
+    \brief Export selected signals over a time range as a [time, signal] float32 table.
+
+	All selected signals must have the same sample rate. With no selection the largest group of
+	signals sharing one sample rate is exported ("EDF Annotations" left out). Data records are read in chunks of
+	CHUNK_RECORDS, de-interleaved into a row-major float block and written with one large write
+	per chunk, so memory stays bounded for any recording length. For CSV the rows of a chunk are
+	split over worker threads that format with std::to_chars into their own buffers, and the
+	buffers are then written in order.
+
+	Formats:
+	- FORMAT_RAW_F32: little-endian float32, row-major, no header
+	- FORMAT_NPY: NumPy .npy v1.0, '<f4', shape (samples, signals)
+	- FORMAT_CSV: header line "time,<label>,...", then one line per sample with the time in seconds
+*/
+
+class CExportEDF
+{
+	public:
+
+	enum exportConstants_E
+	{
+		CHUNK_RECORDS = 64,				///< data records read and written per chunk
+	};
+
+	enum format_E
+	{
+		FORMAT_RAW_F32=0,
+		FORMAT_NPY,
+		FORMAT_CSV,
+	};
+
+	CExportEDF( CReadEDF *poEDF, int iNumberThreads = 0 );
+	~CExportEDF( void );
+
+	static bool bFormatFromName( const char *pszName, format_E *peFormat );
+
+	CReadEDF::edfStatus_E eSelectSignal( int iSignalNumber );
+	CReadEDF::edfStatus_E eSelectSignal( const char *pszLabel );
+	CReadEDF::edfStatus_E eSetTimeRange( double dStartSeconds, double dDurationSeconds = -1.0 );
+
+	void vSetCalibrate( bool bCalibrate )
+	{
+		m_bCalibrate = bCalibrate;
+	};
+
+	CReadEDF::edfStatus_E eExport( const char *pszOutputFile, format_E eFormat, long long *pllRowsWritten = NULL );
+
+	private:
+	int iFormatRows( char *pcOut, const float *pfRows, int iNumberRows, long long llFirstRow, double dSampleRate );
+
+	CReadEDF *m_poEDF;
+	int m_iNumberThreads;
+	bool m_bCalibrate;
+	double m_dStartSeconds;
+	double m_dDurationSeconds;
+	vector<int> m_aiSignals;
+}; //class CExportEDF
+
+#endif // EDFEXPORT_H
@@ -0,0 +1,636 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for streaming digital filtering of EDF data records.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "edffilter.h"
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*!
+*   \brief Constructor
+*   \param poEDF - reader (must stay valid for the lifetime of the filter)
+*   \param bCalibrate - filter physical values when true, raw digital values when false
+*/
+
+CFilterEDF::CFilterEDF( CReadEDF *poEDF, bool bCalibrate )
+{
+	m_poEDF = poEDF;
+	m_iNumberSignals = 0;
+
+	if( m_poEDF != NULL && m_poEDF->bReadyStatus() )
+	{
+		m_poEDF->eGetNumberSignals( &m_iNumberSignals );
+	}
+
+	m_asChains.resize( m_iNumberSignals );
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		chain_S &sChain = m_asChains[iThisSignal];
+
+		sChain.iFirPosition = 0;
+		sChain.dGain = 1.0;
+		sChain.dOffset = 0.0;
+
+		if( bCalibrate )
+		{
+			m_poEDF->eGetCalibration( iThisSignal, &sChain.dGain, &sChain.dOffset );
+		}
+	}
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CFilterEDF::~CFilterEDF( void )
+{
+}
+
+/*!
+*   \brief Design a 2nd order low-pass section (bilinear transform, RBJ cookbook).
+*   \param dSampleRate - samples per second
+*   \param dCutoff - -3 dB frequency for Q = 0.7071
+*   \param dQ - quality factor
+*   \return Normalized biquad coefficients.
+*/
+
+CFilterEDF::biquad_S CFilterEDF::sDesignLowPass( double dSampleRate, double dCutoff, double dQ )
+{
+	double dW0 = 2.0 * M_PI * dCutoff / dSampleRate;
+	double dCos = cos( dW0 );
+	double dAlpha = sin( dW0 ) / (2.0 * dQ);
+	double dA0 = 1.0 + dAlpha;
+	biquad_S sBiquad;
+
+	sBiquad.dB0 = ((1.0 - dCos) / 2.0) / dA0;
+	sBiquad.dB1 = (1.0 - dCos) / dA0;
+	sBiquad.dB2 = sBiquad.dB0;
+	sBiquad.dA1 = (-2.0 * dCos) / dA0;
+	sBiquad.dA2 = (1.0 - dAlpha) / dA0;
+
+	return( sBiquad );
+}
+
+/*!
+*   \brief Design a 2nd order high-pass section (bilinear transform, RBJ cookbook).
+*   \param dSampleRate - samples per second
+*   \param dCutoff - -3 dB frequency for Q = 0.7071
+*   \param dQ - quality factor
+*   \return Normalized biquad coefficients.
+*/
+
+CFilterEDF::biquad_S CFilterEDF::sDesignHighPass( double dSampleRate, double dCutoff, double dQ )
+{
+	double dW0 = 2.0 * M_PI * dCutoff / dSampleRate;
+	double dCos = cos( dW0 );
+	double dAlpha = sin( dW0 ) / (2.0 * dQ);
+	double dA0 = 1.0 + dAlpha;
+	biquad_S sBiquad;
+
+	sBiquad.dB0 = ((1.0 + dCos) / 2.0) / dA0;
+	sBiquad.dB1 = -(1.0 + dCos) / dA0;
+	sBiquad.dB2 = sBiquad.dB0;
+	sBiquad.dA1 = (-2.0 * dCos) / dA0;
+	sBiquad.dA2 = (1.0 - dAlpha) / dA0;
+
+	return( sBiquad );
+}
+
+/*!
+*   \brief Design a 2nd order notch section (bilinear transform, RBJ cookbook).
+*   \param dSampleRate - samples per second
+*   \param dCenter - notch frequency (e.g. 50 or 60 Hz mains)
+*   \param dQ - quality factor (center / bandwidth)
+*   \return Normalized biquad coefficients.
+*/
+
+CFilterEDF::biquad_S CFilterEDF::sDesignNotch( double dSampleRate, double dCenter, double dQ )
+{
+	double dW0 = 2.0 * M_PI * dCenter / dSampleRate;
+	double dCos = cos( dW0 );
+	double dAlpha = sin( dW0 ) / (2.0 * dQ);
+	double dA0 = 1.0 + dAlpha;
+	biquad_S sBiquad;
+
+	sBiquad.dB0 = 1.0 / dA0;
+	sBiquad.dB1 = (-2.0 * dCos) / dA0;
+	sBiquad.dB2 = sBiquad.dB0;
+	sBiquad.dA1 = sBiquad.dB1;
+	sBiquad.dA2 = (1.0 - dAlpha) / dA0;
+
+	return( sBiquad );
+}
+
+/*!
+*   \brief Return true for an "EDF Annotations" signal (TAL bytes, nothing to filter).
+*/
+
+bool CFilterEDF::bIsAnnotationSignal( int iSignalNumber )
+{
+	return( strncmp( m_poEDF->pszGetSignalLabel( iSignalNumber ), "EDF Annotations", 15 ) == 0 );
+}
+
+/*!
+*   \brief Return true if a signal number is out of range or selects an annotation signal.
+*/
+
+bool CFilterEDF::bBadSignal( int iSignalNumber )
+{
+	return( iSignalNumber < ALL_SIGNALS || iSignalNumber >= m_iNumberSignals
+		|| (iSignalNumber != ALL_SIGNALS && bIsAnnotationSignal( iSignalNumber )) );
+}
+
+/*!
+*   \brief Append a biquad section to a signal filter chain.
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param sBiquad - normalized section coefficients
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CFilterEDF::eAddBiquad( int iSignalNumber, const biquad_S &sBiquad )
+{
+	if( bBadSignal( iSignalNumber ) )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		if( (iSignalNumber == ALL_SIGNALS && !bIsAnnotationSignal( iThisSignal )) || iSignalNumber == iThisSignal )
+		{
+			m_asChains[iThisSignal].asBiquads.push_back( sBiquad );
+			m_asChains[iThisSignal].adBiquadStates.push_back( 0.0 );
+			m_asChains[iThisSignal].adBiquadStates.push_back( 0.0 );
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add FIR taps to a signal filter chain (convolved with any FIR already present).
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param pdTaps - impulse response h[0..iNumberTaps-1]
+*   \param iNumberTaps - number of taps
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CFilterEDF::eAddFir( int iSignalNumber, const double *pdTaps, int iNumberTaps )
+{
+	if( bBadSignal( iSignalNumber ) )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( pdTaps == NULL || iNumberTaps <= 0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		if( (iSignalNumber != ALL_SIGNALS && iSignalNumber != iThisSignal) || bIsAnnotationSignal( iThisSignal ) )
+		{
+			continue;
+		}
+
+		chain_S &sChain = m_asChains[iThisSignal];
+
+		// Back to forward order, convolve, then store reversed again:
+		vector<double> adOld( sChain.adFirTaps.rbegin(), sChain.adFirTaps.rend() );
+		vector<double> adNew;
+
+		if( adOld.empty() )
+		{
+			adNew.assign( pdTaps, pdTaps + iNumberTaps );
+		}
+		else
+		{
+			adNew.assign( adOld.size() + iNumberTaps - 1, 0.0 );
+
+			for( size_t i = 0; i < adOld.size(); i++ )
+			{
+				for( int k = 0; k < iNumberTaps; k++ )
+				{
+					adNew[i + k] += adOld[i] * pdTaps[k];
+				}
+			}
+		}
+
+		sChain.adFirTaps.assign( adNew.rbegin(), adNew.rend() );
+		sChain.adFirHistory.assign( 2 * adNew.size(), 0.0 );
+		sChain.iFirPosition = 0;
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add a Butterworth band-pass (high-pass plus low-pass cascade) to a signal filter chain.
+*	\note With ALL_SIGNALS the low-pass is left out for signals whose Nyquist frequency is at
+*	      or below dHighCutoff (e.g. slow SpO2 or position channels); nothing there to remove.
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param dLowCutoff - high-pass -3 dB frequency (0 for low-pass only)
+*   \param dHighCutoff - low-pass -3 dB frequency
+*   \param iOrder - order of each side (even, 2 per biquad section)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CFilterEDF::eAddBandPass( int iSignalNumber, double dLowCutoff, double dHighCutoff, int iOrder )
+{
+	if( bBadSignal( iSignalNumber ) )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( iOrder < 2 || (iOrder % 2) != 0 || dLowCutoff < 0.0 || dHighCutoff <= dLowCutoff )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	vector<double> adSampleRates( m_iNumberSignals, 0.0 );	// 0 = not selected
+
+	// Check every selected signal first so that a failure leaves all chains unchanged:
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		if( (iSignalNumber != ALL_SIGNALS && iSignalNumber != iThisSignal) || bIsAnnotationSignal( iThisSignal ) )
+		{
+			continue;
+		}
+
+		CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+		double dSampleRate = m_poEDF->dGetSampleRate( iThisSignal, &eEdfStatus );
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			return( eEdfStatus );
+		}
+
+		if( dLowCutoff >= dSampleRate / 2.0 )
+		{
+			return( CReadEDF::EDF_INVALID_PARAMETER );
+		}
+
+		adSampleRates[iThisSignal] = dSampleRate;
+	}
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		double dSampleRate = adSampleRates[iThisSignal];
+		double dNyquist = dSampleRate / 2.0;
+
+		if( dSampleRate <= 0.0 )
+		{
+			continue;
+		}
+
+		// Butterworth poles split into sections with Q = 1 / (2 cos(pi (2k+1) / 2N)):
+		for( int k = 0; k < iOrder / 2; k++ )
+		{
+			double dQ = 1.0 / (2.0 * cos( M_PI * (2 * k + 1) / (2.0 * iOrder) ));
+
+			if( dLowCutoff > 0.0 )
+			{
+				eAddBiquad( iThisSignal, sDesignHighPass( dSampleRate, dLowCutoff, dQ ) );
+			}
+
+			if( dHighCutoff < dNyquist )
+			{
+				eAddBiquad( iThisSignal, sDesignLowPass( dSampleRate, dHighCutoff, dQ ) );
+			}
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add a notch (e.g. 50/60 Hz mains) to a signal filter chain.
+*	\note With ALL_SIGNALS the notch is left out for signals that cannot contain dCenter.
+*   \param iSignalNumber - signal number, or ALL_SIGNALS
+*   \param dCenter - notch frequency
+*   \param dQ - quality factor (center / bandwidth)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CFilterEDF::eAddNotch( int iSignalNumber, double dCenter, double dQ )
+{
+	if( bBadSignal( iSignalNumber ) )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( dCenter <= 0.0 || dQ <= 0.0 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	vector<double> adSampleRates( m_iNumberSignals, 0.0 );	// 0 = no notch
+
+	// Check every selected signal first so that a failure leaves all chains unchanged:
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		if( (iSignalNumber != ALL_SIGNALS && iSignalNumber != iThisSignal) || bIsAnnotationSignal( iThisSignal ) )
+		{
+			continue;
+		}
+
+		CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+		double dSampleRate = m_poEDF->dGetSampleRate( iThisSignal, &eEdfStatus );
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			return( eEdfStatus );
+		}
+
+		if( dCenter < dSampleRate / 2.0 )
+		{
+			adSampleRates[iThisSignal] = dSampleRate;
+		}
+		else if( iSignalNumber != ALL_SIGNALS )
+		{
+			return( CReadEDF::EDF_INVALID_PARAMETER );
+		}
+	}
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		if( adSampleRates[iThisSignal] > 0.0 )
+		{
+			eAddBiquad( iThisSignal, sDesignNotch( adSampleRates[iThisSignal], dCenter, dQ ) );
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Clear all filter state (start of a new, unrelated record range).
+*/
+
+void CFilterEDF::vReset( void )
+{
+	for( size_t iThisSignal = 0; iThisSignal < m_asChains.size(); iThisSignal++ )
+	{
+		chain_S &sChain = m_asChains[iThisSignal];
+
+		fill( sChain.adBiquadStates.begin(), sChain.adBiquadStates.end(), 0.0 );
+		fill( sChain.adFirHistory.begin(), sChain.adFirHistory.end(), 0.0 );
+		sChain.iFirPosition = 0;
+	}
+}
+
+/*!
+*   \brief Run a signal segment through a filter chain in place, updating the chain state.
+*	\note Section by section over the whole segment, so each section's state stays in registers.
+*   \param sChain - filter chain and state
+*   \param pdData - samples (in/out)
+*   \param iNumberSamples - number of samples
+*/
+
+void CFilterEDF::vRunChain( chain_S &sChain, double *pdData, int iNumberSamples )
+{
+	for( size_t iSection = 0; iSection < sChain.asBiquads.size(); iSection++ )
+	{
+		const biquad_S &sBiquad = sChain.asBiquads[iSection];
+		double dS1 = sChain.adBiquadStates[2 * iSection];
+		double dS2 = sChain.adBiquadStates[2 * iSection + 1];
+
+		for( int i = 0; i < iNumberSamples; i++ )
+		{
+			double dX = pdData[i];
+			double dY = sBiquad.dB0 * dX + dS1;
+
+			dS1 = sBiquad.dB1 * dX - sBiquad.dA1 * dY + dS2;
+			dS2 = sBiquad.dB2 * dX - sBiquad.dA2 * dY;
+			pdData[i] = dY;
+		}
+
+		sChain.adBiquadStates[2 * iSection] = dS1;
+		sChain.adBiquadStates[2 * iSection + 1] = dS2;
+	}
+
+	int iNumberTaps = (int)sChain.adFirTaps.size();
+
+	if( iNumberTaps > 0 )
+	{
+		const double *pdTaps = &sChain.adFirTaps[0];
+		double *pdHistory = &sChain.adFirHistory[0];
+		int iPosition = sChain.iFirPosition;
+
+		for( int i = 0; i < iNumberSamples; i++ )
+		{
+			// Mirrored history: the newest iNumberTaps samples are always at pdHistory[iPosition+1...]:
+			pdHistory[iPosition] = pdData[i];
+			pdHistory[iPosition + iNumberTaps] = pdData[i];
+
+			const double *pdWindow = &pdHistory[iPosition + 1];
+			double dSum = 0.0;
+
+			for( int k = 0; k < iNumberTaps; k++ )
+			{
+				dSum += pdTaps[k] * pdWindow[k];
+			}
+
+			pdData[i] = dSum;
+			iPosition = (iPosition + 1 == iNumberTaps) ? 0 : iPosition + 1;
+		}
+
+		sChain.iFirPosition = iPosition;
+	}
+}
+
+/*!
+*   \brief Load the steady state of a constant input into a filter chain (avoids edge transients).
+*   \param sChain - filter chain and state
+*   \param dValue - constant input value
+*/
+
+void CFilterEDF::vPrimeChain( chain_S &sChain, double dValue )
+{
+	double dX = dValue;
+
+	for( size_t iSection = 0; iSection < sChain.asBiquads.size(); iSection++ )
+	{
+		const biquad_S &sBiquad = sChain.asBiquads[iSection];
+		double dDenominator = 1.0 + sBiquad.dA1 + sBiquad.dA2;
+		double dY = (dDenominator != 0.0) ? dX * (sBiquad.dB0 + sBiquad.dB1 + sBiquad.dB2) / dDenominator : 0.0;
+		double dS2 = sBiquad.dB2 * dX - sBiquad.dA2 * dY;
+
+		sChain.adBiquadStates[2 * iSection] = sBiquad.dB1 * dX - sBiquad.dA1 * dY + dS2;
+		sChain.adBiquadStates[2 * iSection + 1] = dS2;
+		dX = dY;
+	}
+
+	fill( sChain.adFirHistory.begin(), sChain.adFirHistory.end(), dX );
+	sChain.iFirPosition = 0;
+}
+
+/*!
+*   \brief Read, calibrate and filter consecutive data records, carrying state across calls.
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \param pfOut - loaded with llNumberRecords * CReadEDF::iGetSamplesPerRecord() values in record layout
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CFilterEDF::eFilterRecords( long long llFirstRecord, long long llNumberRecords, float *pfOut )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_poEDF == NULL || !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		if( pfOut == NULL )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		int iSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+		m_asBlock.resize( (size_t)BLOCK_RECORDS * iSamplesPerRecord );
+		m_adScratch.resize( iSamplesPerRecord );
+
+		for( long long llDone = 0; llDone < llNumberRecords; llDone += BLOCK_RECORDS )
+		{
+			int iBlockRecords = (int)min( (long long)BLOCK_RECORDS, llNumberRecords - llDone );
+
+			eEdfStatus = m_poEDF->eReadRecords( llFirstRecord + llDone, iBlockRecords, &m_asBlock[0] );
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				break;
+			}
+
+			// Filter every signal segment of the block while it is still in cache:
+			for( int iRecord = 0; iRecord < iBlockRecords; iRecord++ )
+			{
+				const short int *psRecord = &m_asBlock[(size_t)iRecord * iSamplesPerRecord];
+				float *pfRecord = &pfOut[(size_t)(llDone + iRecord) * iSamplesPerRecord];
+
+				for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+				{
+					chain_S &sChain = m_asChains[iThisSignal];
+					int iOffset = m_poEDF->iGetSignalOffset( iThisSignal );
+					int iEnd = (iThisSignal + 1 < m_iNumberSignals) ? m_poEDF->iGetSignalOffset( iThisSignal + 1 ) : iSamplesPerRecord;
+					int iNumberSamples = iEnd - iOffset;
+
+					for( int i = 0; i < iNumberSamples; i++ )
+					{
+						m_adScratch[i] = sChain.dGain * psRecord[iOffset + i] + sChain.dOffset;
+					}
+
+					vRunChain( sChain, &m_adScratch[0], iNumberSamples );
+
+					for( int i = 0; i < iNumberSamples; i++ )
+					{
+						pfRecord[iOffset + i] = (float)m_adScratch[i];
+					}
+				}
+			}
+		}
+	} //for()
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Zero-phase (forward-backward) filtering of one signal over an offline record range.
+*	\note Uses a copy of the signal chain, so the streaming state of eFilterRecords() is untouched.
+*	      The effective magnitude response is the square of the chain's response.
+*   \param iSignalNumber - signal number
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \param pfOut - loaded with llNumberRecords * (samples per record of this signal) contiguous values
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CFilterEDF::eFilterZeroPhase( int iSignalNumber, long long llFirstRecord, long long llNumberRecords, float *pfOut )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_poEDF == NULL || !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;
+			break;
+		}
+
+		if( pfOut == NULL || llNumberRecords <= 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		int iSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+		int iOffset = m_poEDF->iGetSignalOffset( iSignalNumber );
+		int iEnd = (iSignalNumber + 1 < m_iNumberSignals) ? m_poEDF->iGetSignalOffset( iSignalNumber + 1 ) : iSamplesPerRecord;
+		int iNumberSamples = iEnd - iOffset;
+		chain_S sChain = m_asChains[iSignalNumber];
+		vector<double> adData( (size_t)llNumberRecords * iNumberSamples );
+
+		m_asBlock.resize( (size_t)BLOCK_RECORDS * iSamplesPerRecord );
+
+		for( long long llDone = 0; llDone < llNumberRecords; llDone += BLOCK_RECORDS )
+		{
+			int iBlockRecords = (int)min( (long long)BLOCK_RECORDS, llNumberRecords - llDone );
+
+			eEdfStatus = m_poEDF->eReadRecords( llFirstRecord + llDone, iBlockRecords, &m_asBlock[0] );
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				break;
+			}
+
+			for( int iRecord = 0; iRecord < iBlockRecords; iRecord++ )
+			{
+				const short int *psSegment = &m_asBlock[(size_t)iRecord * iSamplesPerRecord + iOffset];
+				double *pdSegment = &adData[(size_t)(llDone + iRecord) * iNumberSamples];
+
+				for( int i = 0; i < iNumberSamples; i++ )
+				{
+					pdSegment[i] = sChain.dGain * psSegment[i] + sChain.dOffset;
+				}
+			}
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		// Forward pass, reverse, backward pass, reverse back:
+		vPrimeChain( sChain, adData.front() );
+		vRunChain( sChain, &adData[0], (int)adData.size() );
+		reverse( adData.begin(), adData.end() );
+		vPrimeChain( sChain, adData.front() );
+		vRunChain( sChain, &adData[0], (int)adData.size() );
+		reverse( adData.begin(), adData.end() );
+
+		for( size_t i = 0; i < adData.size(); i++ )
+		{
+			pfOut[i] = (float)adData[i];
+		}
+	} //for()
+
+	return( eEdfStatus );
+}
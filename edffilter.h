@@ -0,0 +1,96 @@
+#ifndef EDFFILTER_H
+#define EDFFILTER_H
+
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for streaming digital filtering of EDF data records.
+*/
+
+/*! \class CFilterEDF
+    \brief Per-signal cascaded biquad (IIR) and FIR filtering on the CReadEDF record read path.
+
+	Each signal owns a filter chain: any number of biquad sections followed by one FIR (adding a
+	second FIR convolves it into the first). Data records are read in blocks with
+	CReadEDF::eReadRecords() and every signal segment is calibrated and filtered while the block
+	is still in cache. Filter state is carried from one record to the next, so consecutive
+	eFilterRecords() calls behave like one uninterrupted recording; vReset() starts over.
+	"EDF Annotations" signals never get a filter: ALL_SIGNALS leaves them out and selecting one
+	by number is refused.
+
+	Typical EEG use:
+	\code
+	CFilterEDF oFilter( poEDF );
+	oFilter.eAddBandPass( CFilterEDF::ALL_SIGNALS, 0.3, 35.0 );
+	oFilter.eAddNotch( CFilterEDF::ALL_SIGNALS, 50.0 );
+	oFilter.eFilterRecords( 0, llNumberRecords, pfOut );
+	\endcode
+*/
+
+class CFilterEDF
+{
+	public:
+
+	enum filterConstants_E
+	{
+		ALL_SIGNALS = -1,				///< signal number that applies a filter to every signal except "EDF Annotations"
+		BLOCK_RECORDS = 16,				///< data records read per block by eFilterRecords()
+	};
+
+	//! \brief One second order section, transposed direct form II (a0 normalized to 1).
+	struct biquad_S
+	{
+		double dB0;
+		double dB1;
+		double dB2;
+		double dA1;
+		double dA2;
+	};
+
+	CFilterEDF( CReadEDF *poEDF, bool bCalibrate = true );
+	~CFilterEDF( void );
+
+	static biquad_S sDesignLowPass( double dSampleRate, double dCutoff, double dQ );
+	static biquad_S sDesignHighPass( double dSampleRate, double dCutoff, double dQ );
+	static biquad_S sDesignNotch( double dSampleRate, double dCenter, double dQ );
+
+	CReadEDF::edfStatus_E eAddBiquad( int iSignalNumber, const biquad_S &sBiquad );
+	CReadEDF::edfStatus_E eAddFir( int iSignalNumber, const double *pdTaps, int iNumberTaps );
+	CReadEDF::edfStatus_E eAddBandPass( int iSignalNumber, double dLowCutoff, double dHighCutoff, int iOrder = 4 );
+	CReadEDF::edfStatus_E eAddNotch( int iSignalNumber, double dCenter, double dQ = 30.0 );
+
+	void vReset( void );
+
+	CReadEDF::edfStatus_E eFilterRecords( long long llFirstRecord, long long llNumberRecords, float *pfOut );
+	CReadEDF::edfStatus_E eFilterZeroPhase( int iSignalNumber, long long llFirstRecord, long long llNumberRecords, float *pfOut );
+
+	private:
+
+	//! \brief Filter chain and its running state for one signal.
+	struct chain_S
+	{
+		vector<biquad_S> asBiquads;
+		vector<double> adBiquadStates;		///< 2 states per biquad section
+		vector<double> adFirTaps;			///< stored in reverse order for a forward dot product
+		vector<double> adFirHistory;		///< 2 * taps long, so the history window is always contiguous
+		int iFirPosition;
+		double dGain;						///< calibration gain (1.0 if uncalibrated)
+		double dOffset;						///< calibration offset (0.0 if uncalibrated)
+	};
+
+	bool bIsAnnotationSignal( int iSignalNumber );
+	bool bBadSignal( int iSignalNumber );
+	static void vRunChain( chain_S &sChain, double *pdData, int iNumberSamples );
+	static void vPrimeChain( chain_S &sChain, double dValue );
+
+	CReadEDF *m_poEDF;
+	int m_iNumberSignals;
+	vector<chain_S> m_asChains;
+	vector<short int> m_asBlock;			///< raw data records of the current block
+	vector<double> m_adScratch;				///< one signal segment being filtered
+}; //class CFilterEDF
+
+#endif // EDFFILTER_H
@@ -0,0 +1,494 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for montage (derived channel / re-referencing) computation.
+*/
+
+#include <algorithm>
+#include "edfmontage.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EDF_MONTAGE_SSE2
+#endif
+
+using namespace std;
+
+/*!
+*   \brief Constructor
+*   \param poEDF - reader (must stay valid for the lifetime of the montage)
+*/
+
+CMontageEDF::CMontageEDF( CReadEDF *poEDF )
+{
+	m_poEDF = poEDF;
+	m_bCompiled = false;
+	m_iOutputSamplesPerRecord = 0;
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CMontageEDF::~CMontageEDF( void )
+{
+}
+
+/*!
+*   \brief Remove all output channels (to define a different montage on the same reader).
+*/
+
+void CMontageEDF::vClear( void )
+{
+	m_asChannels.clear();
+	m_bCompiled = false;
+	m_iOutputSamplesPerRecord = 0;
+}
+
+/*!
+*   \brief Add an (empty) output channel.
+*   \param pszName - channel name (e.g. "Fp1-F3")
+*   \return Output channel number.
+*/
+
+int CMontageEDF::iAddChannel( const char *pszName )
+{
+	channel_S sChannel;
+
+	sChannel.sName = (pszName != NULL) ? pszName : "";
+	m_asChannels.push_back( sChannel );
+	m_bCompiled = false;
+
+	return( (int)m_asChannels.size() - 1 );
+}
+
+/*!
+*   \brief Add weight * input signal to an output channel (weights of a repeated input are summed).
+*   \param iChannel - output channel number
+*   \param pszLabel - input signal label (see CReadEDF::iFindSignal())
+*   \param dWeight - weight
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eAddTerm( int iChannel, const char *pszLabel, double dWeight )
+{
+	if( iChannel < 0 || iChannel >= (int)m_asChannels.size() )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	int iSignal = (m_poEDF != NULL) ? m_poEDF->iFindSignal( pszLabel ) : -1;
+	if( iSignal < 0 )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	vector<term_S> &asTerms = m_asChannels[iChannel].asTerms;
+	size_t iTerm = 0;
+
+	for( ; iTerm < asTerms.size() && asTerms[iTerm].iSignal != iSignal; iTerm++ )
+	{
+	}
+
+	if( iTerm < asTerms.size() )
+	{
+		asTerms[iTerm].dWeight += dWeight;
+	}
+	else
+	{
+		term_S sTerm = { iSignal, dWeight };
+		asTerms.push_back( sTerm );
+	}
+
+	m_bCompiled = false;
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Return a label without its surrounding spaces (EDF labels are space padded).
+*/
+
+string CMontageEDF::sTrimLabel( const char *pszLabel )
+{
+	string sLabel( pszLabel != NULL ? pszLabel : "" );
+	size_t iFirst = sLabel.find_first_not_of( ' ' );
+
+	if( iFirst == string::npos )
+	{
+		return( string() );
+	}
+
+	return( sLabel.substr( iFirst, sLabel.find_last_not_of( ' ' ) - iFirst + 1 ) );
+}
+
+/*!
+*   \brief Add a bipolar derivation "positive-negative".
+*   \return Status of operation (no channel is added on failure).
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eAddBipolar( const char *pszPositive, const char *pszNegative )
+{
+	if( m_poEDF == NULL || m_poEDF->iFindSignal( pszPositive ) < 0 || m_poEDF->iFindSignal( pszNegative ) < 0 )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	string sName = sTrimLabel( pszPositive ) + "-" + sTrimLabel( pszNegative );
+	int iChannel = iAddChannel( sName.c_str() );
+
+	eAddTerm( iChannel, pszPositive, 1.0 );
+	eAddTerm( iChannel, pszNegative, -1.0 );
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add a bipolar chain: labels[0]-labels[1], labels[1]-labels[2], ...
+*   \return Status of operation (no channel is added on failure).
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eAddBipolarChain( const char **apszLabels, int iNumberLabels )
+{
+	if( apszLabels == NULL || iNumberLabels < 2 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	for( int iLabel = 0; iLabel < iNumberLabels; iLabel++ )
+	{
+		if( m_poEDF == NULL || m_poEDF->iFindSignal( apszLabels[iLabel] ) < 0 )
+		{
+			return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+		}
+	}
+
+	for( int iLabel = 0; iLabel + 1 < iNumberLabels; iLabel++ )
+	{
+		eAddBipolar( apszLabels[iLabel], apszLabels[iLabel + 1] );
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add each label referenced to the average of all the labels ("Fp1-AVG", ...).
+*   \return Status of operation (no channel is added on failure).
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eAddAverageReference( const char **apszLabels, int iNumberLabels )
+{
+	if( apszLabels == NULL || iNumberLabels < 2 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	for( int iLabel = 0; iLabel < iNumberLabels; iLabel++ )
+	{
+		if( m_poEDF == NULL || m_poEDF->iFindSignal( apszLabels[iLabel] ) < 0 )
+		{
+			return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+		}
+	}
+
+	double dShare = 1.0 / iNumberLabels;
+
+	for( int iLabel = 0; iLabel < iNumberLabels; iLabel++ )
+	{
+		string sName = sTrimLabel( apszLabels[iLabel] ) + "-AVG";
+		int iChannel = iAddChannel( sName.c_str() );
+
+		eAddTerm( iChannel, apszLabels[iLabel], 1.0 );
+
+		for( int iOther = 0; iOther < iNumberLabels; iOther++ )
+		{
+			eAddTerm( iChannel, apszLabels[iOther], -dShare );
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Add each label referenced to the mean of the two mastoids ("Fp1-A1A2", ...).
+*   \return Status of operation (no channel is added on failure).
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eAddLinkedMastoids( const char **apszLabels, int iNumberLabels,
+	const char *pszLeftMastoid, const char *pszRightMastoid )
+{
+	if( apszLabels == NULL || iNumberLabels < 1 )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	if( m_poEDF == NULL || m_poEDF->iFindSignal( pszLeftMastoid ) < 0 || m_poEDF->iFindSignal( pszRightMastoid ) < 0 )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	for( int iLabel = 0; iLabel < iNumberLabels; iLabel++ )
+	{
+		if( m_poEDF->iFindSignal( apszLabels[iLabel] ) < 0 )
+		{
+			return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+		}
+	}
+
+	for( int iLabel = 0; iLabel < iNumberLabels; iLabel++ )
+	{
+		string sName = sTrimLabel( apszLabels[iLabel] ) + "-" + sTrimLabel( pszLeftMastoid ) + sTrimLabel( pszRightMastoid );
+		int iChannel = iAddChannel( sName.c_str() );
+
+		eAddTerm( iChannel, apszLabels[iLabel], 1.0 );
+		eAddTerm( iChannel, pszLeftMastoid, -0.5 );
+		eAddTerm( iChannel, pszRightMastoid, -0.5 );
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Build the sparse mixing matrix and the output record layout.
+*	\note Called by eApply()/eReadRecords() when the montage changed since the last compile.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eCompile( void )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+
+	m_bCompiled = false;
+	m_aiRowStart.assign( 1, 0 );
+	m_aiColumns.clear();
+	m_afWeights.clear();
+	m_afBias.clear();
+	m_aiNumberSamples.clear();
+	m_aiOutputOffsets.clear();
+	m_iOutputSamplesPerRecord = 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_poEDF == NULL || !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		for( size_t iChannel = 0; iChannel < m_asChannels.size() && eEdfStatus == CReadEDF::EDF_SUCCESS; iChannel++ )
+		{
+			const vector<term_S> &asTerms = m_asChannels[iChannel].asTerms;
+			double dBias = 0.0;
+
+			if( asTerms.empty() )
+			{
+				eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+				break;
+			}
+
+			int iNumberSamples = m_poEDF->iGetNumberSamples( asTerms[0].iSignal );
+
+			for( size_t iTerm = 0; iTerm < asTerms.size(); iTerm++ )
+			{
+				double dGain = 1.0;
+				double dOffset = 0.0;
+
+				if( m_poEDF->iGetNumberSamples( asTerms[iTerm].iSignal ) != iNumberSamples )
+				{
+					eEdfStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;	// mixed sample rates
+					break;
+				}
+
+				m_poEDF->eGetCalibration( asTerms[iTerm].iSignal, &dGain, &dOffset );
+				dBias += asTerms[iTerm].dWeight * dOffset;
+
+				// Terms that cancel (e.g. a reference listed twice) cost nothing at run time:
+				if( asTerms[iTerm].dWeight * dGain != 0.0 )
+				{
+					m_aiColumns.push_back( asTerms[iTerm].iSignal );
+					m_afWeights.push_back( (float)(asTerms[iTerm].dWeight * dGain) );
+				}
+			}
+
+			m_aiRowStart.push_back( (int)m_aiColumns.size() );
+			m_afBias.push_back( (float)dBias );
+			m_aiNumberSamples.push_back( iNumberSamples );
+			m_aiOutputOffsets.push_back( m_iOutputSamplesPerRecord );
+			m_iOutputSamplesPerRecord += iNumberSamples;
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			m_iOutputSamplesPerRecord = 0;
+			break;
+		}
+
+		m_bCompiled = true;
+	} //for()
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief pfOut[i] += fWeight * psIn[i]
+*/
+
+void CMontageEDF::vAccumulate( float *pfOut, const short int *psIn, float fWeight, int iNumberSamples )
+{
+	int i = 0;
+
+#ifdef EDF_MONTAGE_SSE2
+	__m128 xWeight = _mm_set1_ps( fWeight );
+
+	for( ; i + 8 <= iNumberSamples; i += 8 )
+	{
+		__m128i xSamples = _mm_loadu_si128( (const __m128i *)&psIn[i] );
+
+		// Sign extend 8 x int16 to 2 x (4 x int32) by placing each sample in the high half and shifting down:
+		__m128i xLow = _mm_srai_epi32( _mm_unpacklo_epi16( xSamples, xSamples ), 16 );
+		__m128i xHigh = _mm_srai_epi32( _mm_unpackhi_epi16( xSamples, xSamples ), 16 );
+
+		_mm_storeu_ps( &pfOut[i], _mm_add_ps( _mm_loadu_ps( &pfOut[i] ), _mm_mul_ps( xWeight, _mm_cvtepi32_ps( xLow ) ) ) );
+		_mm_storeu_ps( &pfOut[i + 4], _mm_add_ps( _mm_loadu_ps( &pfOut[i + 4] ), _mm_mul_ps( xWeight, _mm_cvtepi32_ps( xHigh ) ) ) );
+	}
+#endif
+
+	for( ; i < iNumberSamples; i++ )
+	{
+		pfOut[i] += fWeight * psIn[i];
+	}
+}
+
+/*!
+*   \brief Apply the montage to data records already in memory.
+*   \param psRecords - raw data records in CReadEDF::eReadRecords() layout
+*   \param llNumberRecords - number of data records
+*   \param pfOut - llNumberRecords * iGetSamplesPerRecord() physical values
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eApply( const short int *psRecords, long long llNumberRecords, float *pfOut )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+	if( !m_bCompiled )
+	{
+		eEdfStatus = eCompile();
+	}
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS && (psRecords == NULL || pfOut == NULL) )
+	{
+		eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+	}
+
+	if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		return( eEdfStatus );
+	}
+
+	int iInputSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+	int iNumberChannels = (int)m_asChannels.size();
+
+	for( long long llRecord = 0; llRecord < llNumberRecords; llRecord++ )
+	{
+		const short int *psRecord = &psRecords[(size_t)llRecord * iInputSamplesPerRecord];
+		float *pfRecord = &pfOut[(size_t)llRecord * m_iOutputSamplesPerRecord];
+
+		for( int iChannel = 0; iChannel < iNumberChannels; iChannel++ )
+		{
+			float *pfChannel = &pfRecord[m_aiOutputOffsets[iChannel]];
+			int iNumberSamples = m_aiNumberSamples[iChannel];
+
+			fill( pfChannel, pfChannel + iNumberSamples, m_afBias[iChannel] );
+
+			for( int iNonZero = m_aiRowStart[iChannel]; iNonZero < m_aiRowStart[iChannel + 1]; iNonZero++ )
+			{
+				vAccumulate( pfChannel, &psRecord[m_poEDF->iGetSignalOffset( m_aiColumns[iNonZero] )],
+					m_afWeights[iNonZero], iNumberSamples );
+			}
+		}
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Read consecutive data records and apply the montage.
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \param pfOut - llNumberRecords * iGetSamplesPerRecord() physical values
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CMontageEDF::eReadRecords( long long llFirstRecord, long long llNumberRecords, float *pfOut )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_SUCCESS;
+
+	if( !m_bCompiled )
+	{
+		eEdfStatus = eCompile();
+	}
+
+	if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		return( eEdfStatus );
+	}
+
+	int iInputSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+	m_asBlock.resize( (size_t)BLOCK_RECORDS * iInputSamplesPerRecord );
+
+	for( long long llDone = 0; llDone < llNumberRecords && eEdfStatus == CReadEDF::EDF_SUCCESS; llDone += BLOCK_RECORDS )
+	{
+		long long llBlockRecords = min( (long long)BLOCK_RECORDS, llNumberRecords - llDone );
+
+		eEdfStatus = m_poEDF->eReadRecords( llFirstRecord + llDone, llBlockRecords, &m_asBlock[0] );
+		if( eEdfStatus == CReadEDF::EDF_SUCCESS )
+		{
+			eEdfStatus = eApply( &m_asBlock[0], llBlockRecords, &pfOut[(size_t)llDone * m_iOutputSamplesPerRecord] );
+		}
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Return the name of an output channel (NULL if invalid).
+*/
+
+const char *CMontageEDF::pszGetChannelName( int iChannel )
+{
+	if( iChannel < 0 || iChannel >= (int)m_asChannels.size() )
+	{
+		return( NULL );
+	}
+
+	return( m_asChannels[iChannel].sName.c_str() );
+}
+
+/*!
+*   \brief Return the output samples per data record of a channel (-1 if invalid or not compiled).
+*/
+
+int CMontageEDF::iGetNumberSamples( int iChannel )
+{
+	if( !m_bCompiled || iChannel < 0 || iChannel >= (int)m_aiNumberSamples.size() )
+	{
+		return( -1 );
+	}
+
+	return( m_aiNumberSamples[iChannel] );
+}
+
+/*!
+*   \brief Return the output sample offset of a channel within a record (-1 if invalid or not compiled).
+*/
+
+int CMontageEDF::iGetChannelOffset( int iChannel )
+{
+	if( !m_bCompiled || iChannel < 0 || iChannel >= (int)m_aiOutputOffsets.size() )
+	{
+		return( -1 );
+	}
+
+	return( m_aiOutputOffsets[iChannel] );
+}
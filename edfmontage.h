@@ -0,0 +1,119 @@
+#ifndef EDFMONTAGE_H
+#define EDFMONTAGE_H
+
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for montage (derived channel / re-referencing) computation.
+*/
+
+/*! \class CMontageEDF
+    \brief Derived channels as weighted sums of raw signals, applied to raw data record blocks.
+
+	A montage is a list of output channels, each a weighted sum of input signals found by label
+	(CReadEDF::iFindSignal()). eCompile() turns it into a sparse mixing matrix in compressed row
+	form, with each input's calibration folded into its weight and a per-channel bias, so
+	applying it is one multiply-add pass per non-zero weight over the raw int16 samples
+	(SSE2 on x86/x64, an auto-vectorizable loop elsewhere).
+
+	eApply() works on records already in memory (CReadEDF::eReadRecords() layout), so a viewer can
+	keep one raw block and switch between several CMontageEDF objects without rereading the file:
+	\code
+	CMontageEDF oBipolar( poEDF );
+	const char *apszChain[] = { "Fp1", "F3", "C3", "P3", "O1" };
+	oBipolar.eAddBipolarChain( apszChain, 5 );
+
+	CMontageEDF oAverage( poEDF );
+	oAverage.eAddAverageReference( apszChain, 5 );
+
+	poEDF->eReadRecords( llFirst, llCount, psRaw );
+	oBipolar.eApply( psRaw, llCount, pfBipolar );
+	oAverage.eApply( psRaw, llCount, pfAverage );
+	\endcode
+
+	All inputs of one output channel must have the same samples per record; the output is laid out
+	per record like the input, channel after channel (see iGetChannelOffset()).
+*/
+
+class CMontageEDF
+{
+	public:
+
+	enum montageConstants_E
+	{
+		BLOCK_RECORDS = 16,				///< data records read per block by eReadRecords()
+	};
+
+	CMontageEDF( CReadEDF *poEDF );
+	~CMontageEDF( void );
+
+	// Montage definition:
+	void vClear( void );
+	int iAddChannel( const char *pszName );
+	CReadEDF::edfStatus_E eAddTerm( int iChannel, const char *pszLabel, double dWeight );
+	CReadEDF::edfStatus_E eAddBipolar( const char *pszPositive, const char *pszNegative );
+	CReadEDF::edfStatus_E eAddBipolarChain( const char **apszLabels, int iNumberLabels );
+	CReadEDF::edfStatus_E eAddAverageReference( const char **apszLabels, int iNumberLabels );
+	CReadEDF::edfStatus_E eAddLinkedMastoids( const char **apszLabels, int iNumberLabels,
+		const char *pszLeftMastoid = "A1", const char *pszRightMastoid = "A2" );
+
+	CReadEDF::edfStatus_E eCompile( void );
+
+	// Application:
+	CReadEDF::edfStatus_E eApply( const short int *psRecords, long long llNumberRecords, float *pfOut );
+	CReadEDF::edfStatus_E eReadRecords( long long llFirstRecord, long long llNumberRecords, float *pfOut );
+
+	//! \brief Return the number of output channels.
+	int iGetNumberChannels( void )
+	{
+		return( (int)m_asChannels.size() );
+	};
+
+	const char *pszGetChannelName( int iChannel );
+	int iGetNumberSamples( int iChannel );
+	int iGetChannelOffset( int iChannel );
+
+	//! \brief Return the number of output samples per data record (valid after eCompile()).
+	int iGetSamplesPerRecord( void )
+	{
+		return( m_iOutputSamplesPerRecord );
+	};
+
+	private:
+
+	struct term_S
+	{
+		int iSignal;
+		double dWeight;
+	};
+
+	struct channel_S
+	{
+		string sName;
+		vector<term_S> asTerms;
+	};
+
+	static string sTrimLabel( const char *pszLabel );
+	static void vAccumulate( float *pfOut, const short int *psIn, float fWeight, int iNumberSamples );
+
+	CReadEDF *m_poEDF;
+	bool m_bCompiled;
+	vector<channel_S> m_asChannels;
+
+	// Compiled mixing matrix (compressed sparse rows, one row per output channel):
+	vector<int> m_aiRowStart;				///< first non-zero of each row; size channels + 1
+	vector<int> m_aiColumns;				///< input signal of each non-zero
+	vector<float> m_afWeights;				///< weight * calibration gain of each non-zero
+	vector<float> m_afBias;					///< sum of weight * calibration offset of each row
+	vector<int> m_aiNumberSamples;			///< output samples per record of each channel
+	vector<int> m_aiOutputOffsets;			///< output sample offset of each channel within a record
+	int m_iOutputSamplesPerRecord;
+
+	vector<short int> m_asBlock;			///< raw data records for eReadRecords()
+}; //class CMontageEDF
+
+#endif // EDFMONTAGE_H
@@ -6,6 +6,7 @@
 */
 
 #include <iostream>	// for cout
+#include <ctype.h>	// for toupper
 #include "edfplus.h"
 using namespace std;
 
@@ -16,21 +17,112 @@ using namespace std;
 */
 
 CReadEDF::CReadEDF( char *pszInputFile, edfStatus_E *peEdfStatus )
+{
+	vInitialize();
+
+	m_poEdfFile = new ifstream( pszInputFile, ios::in | ios::binary );
+	m_bOwnsStream = true;
+
+	if( m_poEdfFile->fail() )
+	{
+		m_eDynamicStatus = EDF_FILE_OPEN_ERROR;
+	}
+	else
+	{
+		m_eDynamicStatus = eReadHeader();
+	}
+
+	m_eStaticStatus = m_eDynamicStatus;		// Set the static (constructor) status
+
+	if( peEdfStatus )
+	{
+		*peEdfStatus = m_eStaticStatus;
+	}
+
+} // CReadEDF()
+
+/*!
+*   \brief Constructor for an already open input stream (e.g. a pipe or std::cin).
+*	\note The header is read strictly sequentially and the stream is left at the first data
+*	      record, so non-seekable streams work with CStreamEDF. eGetSample() and eReadRecords()
+*	      seek, so they need a seekable stream.
+*   \param poInput - binary input stream, positioned at the start of the header
+*   \param bOwnsStream - delete the stream in the destructor (e.g. a CCompressedStreamEDF)
+*   \return - status
+*/
+
+CReadEDF::CReadEDF( istream *poInput, edfStatus_E *peEdfStatus, bool bOwnsStream )
+{
+	vInitialize();
+
+	m_poEdfFile = poInput;
+	m_bOwnsStream = bOwnsStream;
+
+	if( m_poEdfFile == NULL || m_poEdfFile->fail() )
+	{
+		m_eDynamicStatus = EDF_FILE_OPEN_ERROR;
+	}
+	else
+	{
+		m_eDynamicStatus = eReadHeader();
+	}
+
+	m_eStaticStatus = m_eDynamicStatus;		// Set the static (constructor) status
+
+	if( peEdfStatus )
+	{
+		*peEdfStatus = m_eStaticStatus;
+	}
+
+} // CReadEDF()
+
+/*!
+*   \brief Set every member to its "nothing loaded" value (shared by the constructors).
+*/
+
+void CReadEDF::vInitialize( void )
 {
 	m_eStaticStatus = EDF_VOID;		// signify undetermined status
 	m_eDynamicStatus = EDF_VOID;		// signify undetermined status
 
+	m_poEdfFile = NULL;
+	m_bOwnsStream = false;
+	m_pcFileData = NULL;
+	m_pacSignalLabels = NULL;
+	m_pacTransducerTypes = NULL;
+	m_pacPhysicalDimensions = NULL;
+	m_pacPhysicalMinimums = NULL;
+	m_pacPhysicalMaximums = NULL;
+	m_pacDigitalMinimums = NULL;
+	m_pacDigitalMaximums = NULL;
+	m_pacPrefilterings = NULL;
+	m_pacNumberSamples = NULL;
+	m_pacReserveds = NULL;
+	m_piNumberSamples = NULL;
+	m_piSignalOffsets = NULL;
+	m_pdGains = NULL;
+	m_pdOffsets = NULL;
+	m_piDigitalMinimums = NULL;
+	m_piDigitalMaximums = NULL;
+	m_iSamplesPerRecord = 0;
+	m_iRecordSize = 0;
+	m_iHeaderBytes = 0;
+	m_dDuration = 0.0;
+}
+
+/*!
+*   \brief Read and parse the whole header record from the current stream position.
+*	\note Reads strictly forward (no seeking) and leaves the stream at the first data record.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eReadHeader( void )
+{
+	m_eDynamicStatus = EDF_VOID;
+
 	// Fake for loop for common error exit:
 	for( bool allDone = false; allDone == false; allDone = true )
 	{
-		m_poEdfFile = new ifstream( pszInputFile );
-
-		if( m_poEdfFile->fail() )
-		{
-			m_eDynamicStatus = EDF_FILE_OPEN_ERROR;
-			break;
-		}
-
 		m_pcFileData = new char[sizeof(CReadEDF::headerFixedLength_S)+1 ];
 		{
 			// error handling
@@ -41,6 +133,7 @@ CReadEDF::CReadEDF( char *pszInputFile, edfStatus_E *peEdfStatus )
 
 		if( m_poEdfFile->fail() )
 		{
+			m_eDynamicStatus = EDF_FILE_CONTENTS_ERROR;		// empty or short input
 			break;
 		}
 
@@ -110,20 +203,21 @@ CReadEDF::CReadEDF( char *pszInputFile, edfStatus_E *peEdfStatus )
 		m_pacNumberSamples = new char[iSize];
 		m_poEdfFile->read( m_pacNumberSamples, iSize );
 		if( m_poEdfFile->fail() ) break;
-		
-		m_eDynamicStatus = EDF_SUCCESS;			// We are successfull when arriving here
-		break;
 
-	} //for()
+		// Reserved Field (read, so the stream ends up at the first data record):
+		iSize = (m_iNumberSignals * eReserved32Size);
+		m_pacReserveds = new char[iSize];
+		m_poEdfFile->read( m_pacReserveds, iSize );
+		if( m_poEdfFile->fail() ) break;
 
-	m_eStaticStatus = m_eDynamicStatus;		// Set the static (constructor) status
+		// Derive the data record layout once, so sample and record reads need no header parsing:
+		m_eDynamicStatus = eBuildRecordLayout();
+		break;
 
-	if( peEdfStatus )
-	{
-		*peEdfStatus = m_eStaticStatus;
-	}
+	} //for()
 
-} // CReadEDF()
+	return( m_eDynamicStatus );
+}
 
 
 /*!
@@ -136,10 +230,140 @@ CReadEDF::CReadEDF( char *pszInputFile, edfStatus_E *peEdfStatus )
 
 CReadEDF::~CReadEDF( void )
 {
-	if( m_poEdfFile )
+	if( m_bOwnsStream )
+	{
+		delete m_poEdfFile;				// closes the file
+	}
+
+	delete [] m_pcFileData;
+	delete [] m_pacSignalLabels;
+	delete [] m_pacTransducerTypes;
+	delete [] m_pacPhysicalDimensions;
+	delete [] m_pacPhysicalMinimums;
+	delete [] m_pacPhysicalMaximums;
+	delete [] m_pacDigitalMinimums;
+	delete [] m_pacDigitalMaximums;
+	delete [] m_pacPrefilterings;
+	delete [] m_pacNumberSamples;
+	delete [] m_pacReserveds;
+	delete [] m_piNumberSamples;
+	delete [] m_piSignalOffsets;
+	delete [] m_pdGains;
+	delete [] m_pdOffsets;
+	delete [] m_piDigitalMinimums;
+	delete [] m_piDigitalMaximums;
+}
+
+/*!
+*   \brief Parse a space padded numeric ASCII header field.
+*   \param pacField points to the (not terminated) header field.
+*   \param iSize is the field size in bytes.
+*   \return Field value (0.0 if not numeric).
+*/
+
+double CReadEDF::dParseField( const char *pacField, int iSize )
+{
+	char szField[ eTransducerTypeSize+1 ];		// largest header field
+
+	if( iSize > eTransducerTypeSize )
 	{
-		m_poEdfFile->close();
+		iSize = eTransducerTypeSize;
 	}
+
+	memcpy( szField, pacField, iSize );
+	szField[ iSize ] = '\0';					// make sure there is a string terminator
+
+	return( atof( szField ) );
+}
+
+/*!
+*   \brief Build the data record layout from the header fields.
+*	\note Called once by the constructor after all variable length header fields are loaded.
+*   \param (none)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eBuildRecordLayout( void )
+{
+	edfStatus_E eEdfStatus = EDF_FILE_CONTENTS_ERROR;	// be pessimistic
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_iNumberSignals <= 0 )
+		{
+			break;
+		}
+
+		m_piNumberSamples = new int[m_iNumberSignals];
+		m_piSignalOffsets = new int[m_iNumberSignals];
+		m_pdGains = new double[m_iNumberSignals];
+		m_pdOffsets = new double[m_iNumberSignals];
+		m_piDigitalMinimums = new int[m_iNumberSignals];
+		m_piDigitalMaximums = new int[m_iNumberSignals];
+
+		physicalMinimum_S *pacPhysicalMinimums = (physicalMinimum_S *)m_pacPhysicalMinimums;
+		physicalMaximum_S *pacPhysicalMaximums = (physicalMaximum_S *)m_pacPhysicalMaximums;
+		digitalMinimum_S *pacDigitalMinimums = (digitalMinimum_S *)m_pacDigitalMinimums;
+		digitalMaximum_S *pacDigitalMaximums = (digitalMaximum_S *)m_pacDigitalMaximums;
+
+		m_iSamplesPerRecord = 0;
+		int iThisSignal = 0;
+
+		for( ; iThisSignal < m_iNumberSignals; iThisSignal++ )
+		{
+			int iNumberSamples = iGetNumberSamples( iThisSignal, &eEdfStatus );
+			if( eEdfStatus != EDF_SUCCESS || iNumberSamples <= 0 )
+			{
+				eEdfStatus = EDF_FILE_CONTENTS_ERROR;
+				break;
+			}
+
+			m_piNumberSamples[iThisSignal] = iNumberSamples;
+			m_piSignalOffsets[iThisSignal] = m_iSamplesPerRecord;
+			m_iSamplesPerRecord += iNumberSamples;
+
+			// Physical value = gain * digital value + offset (the 4 extremes specify both):
+			double dPhysicalMinimum = dParseField( pacPhysicalMinimums[iThisSignal].acPhysicalMinimum, ePhysicalMinimumSize );
+			double dPhysicalMaximum = dParseField( pacPhysicalMaximums[iThisSignal].acPhysicalMaximum, ePhysicalMaximumSize );
+			double dDigitalMinimum = dParseField( pacDigitalMinimums[iThisSignal].acDigitalMinimum, eDigitalMinimumSize );
+			double dDigitalMaximum = dParseField( pacDigitalMaximums[iThisSignal].acDigitalMaximum, eDigitalMaximumSize );
+
+			m_piDigitalMinimums[iThisSignal] = (int)dDigitalMinimum;
+			m_piDigitalMaximums[iThisSignal] = (int)dDigitalMaximum;
+
+			if( dDigitalMaximum != dDigitalMinimum )
+			{
+				m_pdGains[iThisSignal] = (dPhysicalMaximum - dPhysicalMinimum) / (dDigitalMaximum - dDigitalMinimum);
+			}
+			else
+			{
+				m_pdGains[iThisSignal] = 1.0;		// degenerate header, leave the samples uncalibrated
+			}
+			m_pdOffsets[iThisSignal] = dPhysicalMaximum - (m_pdGains[iThisSignal] * dDigitalMaximum);
+		}
+
+		if( iThisSignal != m_iNumberSignals )
+		{
+			break;
+		}
+
+		m_iRecordSize = m_iSamplesPerRecord * eSampleSize;
+		m_iHeaderBytes = sizeof(headerFixedLength_S) + (sizeof(headerVariableLength_S) * m_iNumberSignals);
+
+		eEdfStatus = eGetNumberRecords();
+		if( eEdfStatus != EDF_SUCCESS )
+		{
+			break;
+		}
+
+		m_dDuration = dParseField( m_acHeaderFixedLength.acDuration, eDurationSize );
+
+		eEdfStatus = EDF_SUCCESS;
+		break;
+	} //for()
+
+	return( eEdfStatus );
 }
 
 /*!
@@ -159,7 +383,7 @@ bool CReadEDF::bValidTimeValue( void )
 		{
 			/// \todo if leading space(s) are allowed in time then test for them here:	
 			if( pacTime->cH_MSD < '0' || pacTime->cH_MSD > '2' ) break;		// check for max 24-hour time
-			if( pacTime->cH_LSD < '0' || pacTime->cH_MSD > '9' ) break;		// allow 09:00 and 19:00
+			if( pacTime->cH_LSD < '0' || pacTime->cH_LSD > '9' ) break;		// allow 09:00 and 19:00
 			if( pacTime->cDot1 != '.' ) break;								// ensure a non-digit terminator for atoi()
 
 			// Test for valid hours:
@@ -168,12 +392,12 @@ bool CReadEDF::bValidTimeValue( void )
 
 			// Test for valid minutes:
 			if( pacTime->cM_MSD < '0' || pacTime->cM_MSD > '5' ) break;
-			if( pacTime->cM_LSD < '0' || pacTime->cM_MSD > '9' ) break;
+			if( pacTime->cM_LSD < '0' || pacTime->cM_LSD > '9' ) break;
 			if( pacTime->cDot2 != '.' ) break;
 
 			// Test for valid seconds:
 			if( pacTime->cS_MSD < '0' || pacTime->cS_MSD > '5' ) break;
-			if( pacTime->cS_LSD < '0' || pacTime->cS_MSD > '9' ) break;
+			if( pacTime->cS_LSD < '0' || pacTime->cS_LSD > '9' ) break;
 
 			bRetVal= true;
 			break;
@@ -201,25 +425,29 @@ bool CReadEDF::bValidDateValue( void )
 	{
 		/// \todo if leading space(s) are allowed in date then test for them here:	
 		if( pacDate->cD_MSD < '0' || pacDate->cD_MSD > '3' ) break;		// check for max 31 days
-		if( pacDate->cD_LSD < '0' || pacDate->cD_MSD > '9' ) break;		// allow day 9, 19, 29
+		if( pacDate->cD_LSD < '0' || pacDate->cD_LSD > '9' ) break;		// allow day 9, 19, 29
 		if( pacDate->cDot1 != '.' ) break;								// ensure a non-digit terminator for atoi()
 
 //			if( int iDD = atoi( (char *)pacDate->cD_MSD ) > 31 ) break;		// no atoi error checking since done above
 		int iDD = ((pacDate->cD_MSD & 0x0F) * 10 + (pacDate->cD_LSD & 0x0F));
-		if( ((pacDate->cD_MSD & 0x0F) * 10 + (pacDate->cD_LSD & 0x0F)) > 31 ) break;
+		if( iDD < 1 || iDD > 31 ) break;
 
 		if( pacDate->cM_MSD < '0' || pacDate->cM_MSD > '1' ) break;
-		if( pacDate->cM_LSD < '0' || pacDate->cM_MSD > '9' ) break;
+		if( pacDate->cM_LSD < '0' || pacDate->cM_LSD > '9' ) break;
 		if( pacDate->cDot2 != '.' ) break;
 
+		// Test for valid months:
+		int iMM = ((pacDate->cM_MSD & 0x0F) * 10 + (pacDate->cM_LSD & 0x0F));
+		if( iMM < 1 || iMM > 12 ) break;
+
 		if( pacDate->cY_MSD < '0' || pacDate->cY_MSD > '9' ) break;
-		if( pacDate->cY_LSD < '0' || pacDate->cY_MSD > '9' ) break;
+		if( pacDate->cY_LSD < '0' || pacDate->cY_LSD > '9' ) break;
 		
 		bRetVal= true;
 		break;
 	} //for()
 
-	m_szValue[ sizeof( time_S ) ] = '\0';		// make sure there is a string terminator
+	m_szValue[ sizeof( date_S ) ] = '\0';		// make sure there is a string terminator
 	return( bRetVal );
 }
 
@@ -287,6 +515,123 @@ char *CReadEDF::pszGetStartDate( edfStatus_E *peEdfStatus )
 	return( &m_szValue[0] );
 }
 
+/*!
+*   \brief Get the start of the recording in seconds since 1970-01-01 00:00:00 (header date and time).
+*	\note Two digit years use the EDF clipping rule: 85-99 are 1985-1999, 00-84 are 2000-2084. EDF+ files
+*	       take the 4 digit year of the "Startdate dd-MMM-yyyy" recording field when it matches (or the
+*	       start date year is "yy", as EDF+ writes it after 2084).
+*   \param pllSeconds is loaded with the start in seconds if not null.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eGetStartSeconds( long long *pllSeconds )
+{
+	edfStatus_E eEdfStatus = EDF_SUCCESS;
+	date_S sDate = m_acHeaderFixedLength.acStartDate;
+	int iEdfPlusYear = iGetEdfPlusYear();
+	bool bYearUnknown = (sDate.cY_MSD == 'y' && sDate.cY_LSD == 'y');
+
+	if( bYearUnknown && iEdfPlusYear > 0 )
+	{
+		sDate.cY_MSD = '0';					// only day and month are checked below
+		sDate.cY_LSD = '0';
+	}
+
+	memcpy( m_szValue, &sDate, sizeof( date_S ) );
+	if( !bValidDateValue() )
+	{
+		return( EDF_DATE_ERROR );
+	}
+
+	pszGetStartTime( &eEdfStatus );
+	if( eEdfStatus != EDF_SUCCESS )
+	{
+		return( eEdfStatus );
+	}
+
+	const time_S &sTime = m_acHeaderFixedLength.acStartTime;
+	int iDay = (sDate.cD_MSD & 0x0F) * 10 + (sDate.cD_LSD & 0x0F);
+	int iMonth = (sDate.cM_MSD & 0x0F) * 10 + (sDate.cM_LSD & 0x0F);
+	int iYear = (sDate.cY_MSD & 0x0F) * 10 + (sDate.cY_LSD & 0x0F);
+
+	if( iEdfPlusYear > 0 && (bYearUnknown || iEdfPlusYear % 100 == iYear) )
+	{
+		iYear = iEdfPlusYear;
+	}
+	else
+	{
+		iYear += (iYear >= 85) ? 1900 : 2000;
+	}
+
+	// Days since 1970-01-01 in the proleptic Gregorian calendar (March based year):
+	int iYearOfEra = iYear - (iMonth <= 2 ? 1 : 0);
+	int iEra = iYearOfEra / 400;
+	int iYearInEra = iYearOfEra - iEra * 400;
+	int iDayOfYear = (153 * (iMonth + (iMonth > 2 ? -3 : 9)) + 2) / 5 + iDay - 1;
+	int iDayOfEra = iYearInEra * 365 + iYearInEra / 4 - iYearInEra / 100 + iDayOfYear;
+	long long llDays = (long long)iEra * 146097 + iDayOfEra - 719468;
+
+	if( pllSeconds != NULL )
+	{
+		*pllSeconds = llDays * 86400
+			+ ((sTime.cH_MSD & 0x0F) * 10 + (sTime.cH_LSD & 0x0F)) * 3600
+			+ ((sTime.cM_MSD & 0x0F) * 10 + (sTime.cM_LSD & 0x0F)) * 60
+			+ ((sTime.cS_MSD & 0x0F) * 10 + (sTime.cS_LSD & 0x0F));
+	}
+
+	return( EDF_SUCCESS );
+}
+
+/*!
+*   \brief Return true for an EDF+ file (reserved field starts with "EDF+").
+*   \param pbDiscontinuous is loaded with true for EDF+D (data records not contiguous in time) if not null.
+*/
+
+bool CReadEDF::bIsEdfPlus( bool *pbDiscontinuous )
+{
+	bool bEdfPlus = (memcmp( m_acHeaderFixedLength.acReserved44, "EDF+", 4 ) == 0);
+
+	if( pbDiscontinuous != NULL )
+	{
+		*pbDiscontinuous = bEdfPlus && m_acHeaderFixedLength.acReserved44[4] == 'D';
+	}
+
+	return( bEdfPlus );
+}
+
+/*!
+*   \brief Return the 4 digit year of an EDF+ recording field ("Startdate dd-MMM-yyyy ..."), or -1 if there is none.
+*/
+
+int CReadEDF::iGetEdfPlusYear( void )
+{
+	const char *pacRecording = m_acHeaderFixedLength.acLocalRecordingID;
+	int iYear = 0;
+
+	if( !bIsEdfPlus() || memcmp( pacRecording, "Startdate ", 10 ) != 0 )
+	{
+		return( -1 );
+	}
+
+	// dd-MMM-yyyy follows "Startdate " ("X" when the date is not known):
+	if( pacRecording[12] != '-' || pacRecording[16] != '-' )
+	{
+		return( -1 );
+	}
+
+	for( int iDigit = 17; iDigit < 21; iDigit++ )
+	{
+		if( pacRecording[iDigit] < '0' || pacRecording[iDigit] > '9' )
+		{
+			return( -1 );
+		}
+
+		iYear = iYear * 10 + (pacRecording[iDigit] & 0x0F);
+	}
+
+	return( (iYear >= 1985) ? iYear : -1 );
+}
+
 /*!
 *   \brief Return the number of signals
 *   \param peEdfStatus is loaded with status value if not null
@@ -344,24 +689,26 @@ CReadEDF::edfStatus_E CReadEDF::eGetNumberSignals( int* piNumberSignals, char* p
 *   \return Status of operation.
 */
 
-CReadEDF::edfStatus_E CReadEDF::eGetNumberRecords( int* piNumberRecords, char* pszNumberRecords )
+CReadEDF::edfStatus_E CReadEDF::eGetNumberRecords( long long* pllNumberRecords, char* pszNumberRecords )
 {
 	m_eDynamicStatus =	EDF_SUCCESS;	// be optimistic
 
 	memcpy( m_szValue, m_acHeaderFixedLength.acNumberRecords, sizeof( numberRecords_S ) );
 	m_szValue[ sizeof(numberRecords_S) ] = '\0' ;	// make sure there is a string terminator
 
-	m_iNumberRecords = atoi( m_szValue);
-	if( errno == ERANGE )
+	char *pcEnd = NULL;
+	errno = 0;
+	m_llNumberRecords = strtoll( m_szValue, &pcEnd, 10 );
+	if( pcEnd == m_szValue || errno == ERANGE )
 	{
-		m_iNumberRecords = 0;
+		m_llNumberRecords = 0;
 		strcpy_s( m_szValue, "BAD!" );
 		m_eDynamicStatus =	EDF_FILE_CONTENTS_ERROR;
 	}
 		
-	if( piNumberRecords )
+	if( pllNumberRecords )
 	{
-		piNumberRecords = &m_iNumberRecords;
+		*pllNumberRecords = m_llNumberRecords;
 	}
 
 	if( pszNumberRecords )
@@ -413,7 +760,7 @@ CReadEDF::edfStatus_E CReadEDF::eGetDuration( int* piDuration, char* pszDuration
 		
 	if( piDuration )
 	{
-		piDuration = &m_iDuration;
+		*piDuration = m_iDuration;
 	}
 
 	if( pszDuration )
@@ -464,7 +811,7 @@ char *CReadEDF::pszGetSignalLabel( int iSignalNumber, edfStatus_E *peEdfStatus )
 			break;
 		}
 
-		if( iSignalNumber > m_iNumberSignals )
+		if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
 		{
 			m_eDynamicStatus = EDF_INVALID_SIGNAL_REQUESTED;
 			break;
@@ -493,6 +840,70 @@ char *CReadEDF::pszGetSignalLabel( int iSignalNumber, edfStatus_E *peEdfStatus )
 	return( &m_szValue[0] );
 }
 
+/*!
+*   \brief Find a signal by label.
+*	\note Leading/trailing spaces are ignored and letters compare case-insensitive ("eeg fp1" finds "EEG Fp1   ").
+*   \param pszLabel must contain the label to look for.
+*   \return Signal number (-1 if not found).
+*/
+
+int CReadEDF::iFindSignal( const char *pszLabel )
+{
+	if( !bReadyStatus() || pszLabel == NULL )
+	{
+		return( -1 );
+	}
+
+	// Trim the requested label once:
+	while( *pszLabel == ' ' )
+	{
+		pszLabel++;
+	}
+
+	int iLength = (int)strlen( pszLabel );
+	while( iLength > 0 && pszLabel[iLength - 1] == ' ' )
+	{
+		iLength--;
+	}
+
+	signalLabel_S *pacSignalLabels = (signalLabel_S *)m_pacSignalLabels;
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		const char *pcField = pacSignalLabels[iThisSignal].acSignalLabel;
+		int iStart = 0;
+		int iEnd = eSignalLabelSize;
+
+		while( iStart < iEnd && pcField[iStart] == ' ' )
+		{
+			iStart++;
+		}
+
+		while( iEnd > iStart && pcField[iEnd - 1] == ' ' )
+		{
+			iEnd--;
+		}
+
+		if( iEnd - iStart != iLength )
+		{
+			continue;
+		}
+
+		int i = 0;
+		while( i < iLength && toupper( (unsigned char)pcField[iStart + i] ) == toupper( (unsigned char)pszLabel[i] ) )
+		{
+			i++;
+		}
+
+		if( i == iLength )
+		{
+			return( iThisSignal );
+		}
+	}
+
+	return( -1 );
+}
+
 /*!
 *   \brief Get number of signal samples
 *   \param iSignalNumber must contain the desired signal number.
@@ -507,6 +918,7 @@ int CReadEDF::iGetNumberSamples( int iSignalNumber, edfStatus_E *peEdfStatus )
 
 	numberSamples_S *pacNumberSamples = (numberSamples_S *)m_pacNumberSamples;
 	memcpy( &m_szValue, &pacNumberSamples[iSignalNumber], eNumberSamplesSize );
+	m_szValue[ eNumberSamplesSize ] = '\0';	// make sure there is a string terminator
 
 	iNumberSamples = atoi( m_szValue );
 	if( errno == ERANGE )
@@ -525,11 +937,14 @@ int CReadEDF::iGetNumberSamples( int iSignalNumber, edfStatus_E *peEdfStatus )
 
 /*!
 *   \brief Get a sample from a signal
-*   \param peEdfStatus is loaded with status value if not null.
+*	\note Byte positions are computed in 64 bits, so recordings beyond 2 GiB are addressed correctly.
+*   \param iSignalNumber must contain the desired signal number (0 based).
+*   \param llSampleNumber must contain the desired sample number of that signal (0 based, across records).
+*   \param piSampleValue is loaded with the digital sample value if not null.
 *   \return Status of operation.
 */
 
-CReadEDF::edfStatus_E CReadEDF::eGetSample( short int iSignalNumber, int iSampleNumber, int *piSampleValue )
+CReadEDF::edfStatus_E CReadEDF::eGetSample( short int iSignalNumber, long long llSampleNumber, int *piSampleValue )
 {
 	short int iSampleValue = 0;	
 	
@@ -543,32 +958,27 @@ CReadEDF::edfStatus_E CReadEDF::eGetSample( short int iSignalNumber, int iSample
 			break;
 		}
 
-		if( iSignalNumber > m_iNumberSignals )
+		if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
 		{
 			m_eDynamicStatus = EDF_INVALID_SIGNAL_REQUESTED;
 			break;
 		}
 
-		int iOffsetPastHeaders = sizeof(headerFixedLength_S) + (sizeof(headerVariableLength_S) * m_iNumberSignals);
-		int iOffsetToSignal = iOffsetPastHeaders;
+		// Sample n of a signal lives in data record n / samples-per-record of that signal:
+		long long llRecord = llSampleNumber / m_piNumberSamples[iSignalNumber];
+		long long llSampleInRecord = llSampleNumber % m_piNumberSamples[iSignalNumber];
 
-		for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
-		{
-			iOffsetToSignal +=  iGetNumberSamples( iThisSignal, &m_eDynamicStatus );
-			if( m_eDynamicStatus != EDF_SUCCESS )
-			{
-				break;
-			}
-		}
-
-		if( m_eDynamicStatus != EDF_SUCCESS )
+		if( llSampleNumber < 0 || (m_llNumberRecords >= 0 && llRecord >= m_llNumberRecords) )
 		{
+			m_eDynamicStatus = EDF_INVALID_RECORD_REQUESTED;
 			break;
 		}
 
-		int iOffsetToSample = iOffsetToSignal + (iSignalNumber * eSampleSize);
-	
-		m_poEdfFile->seekg( iOffsetToSample );
+		long long llOffsetToSample = m_iHeaderBytes + (llRecord * m_iRecordSize)
+			+ ((m_piSignalOffsets[iSignalNumber] + llSampleInRecord) * eSampleSize);
+
+		m_poEdfFile->clear();
+		m_poEdfFile->seekg( (streamoff)llOffsetToSample );
 		//cout << "File currently at byte: " << m_poEdfFile->tellg() << endl;
 
 		if( m_poEdfFile->fail() )
@@ -579,11 +989,207 @@ CReadEDF::edfStatus_E CReadEDF::eGetSample( short int iSignalNumber, int iSample
 
 		m_poEdfFile->read( reinterpret_cast<char *>(&iSampleValue), eSampleSize );
 
+		if( m_poEdfFile->fail() )
+		{
+			m_eDynamicStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
 		if( piSampleValue != NULL )
 		{
 			*piSampleValue = iSampleValue;
 		}
 
+		m_eDynamicStatus = EDF_SUCCESS;
+	} //for()
+
+	return( m_eDynamicStatus );
+}
+
+/*!
+*   \brief Get the sample rate of a signal.
+*   \param iSignalNumber must contain the desired signal number.
+*   \param peEdfStatus is loaded with status value if not null.
+*   \return Samples per second (0.0 if unavailable).
+*/
+
+double CReadEDF::dGetSampleRate( int iSignalNumber, edfStatus_E *peEdfStatus )
+{
+	double dSampleRate = 0.0;
+	edfStatus_E eEdfStatus = EDF_INVALID_SIGNAL_REQUESTED;
+
+	if( !bReadyStatus( &eEdfStatus ) )
+	{
+		// keep the static status
+	}
+	else if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+	{
+		eEdfStatus = EDF_INVALID_SIGNAL_REQUESTED;
+	}
+	else if( m_dDuration <= 0.0 )
+	{
+		eEdfStatus = EDF_FILE_CONTENTS_ERROR;
+	}
+	else
+	{
+		dSampleRate = m_piNumberSamples[iSignalNumber] / m_dDuration;
+	}
+
+	if( peEdfStatus != NULL )
+	{
+		*peEdfStatus = eEdfStatus;
+	}
+
+	return( dSampleRate );
+}
+
+/*!
+*   \brief Get the calibration of a signal (physical value = gain * digital value + offset).
+*   \param iSignalNumber must contain the desired signal number.
+*   \param pdGain is loaded with the gain if not null.
+*   \param pdOffset is loaded with the offset if not null.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eGetCalibration( int iSignalNumber, double *pdGain, double *pdOffset )
+{
+	edfStatus_E eEdfStatus = EDF_INVALID_SIGNAL_REQUESTED;
+
+	if( !bReadyStatus( &eEdfStatus ) )
+	{
+		return( eEdfStatus );
+	}
+
+	if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+	{
+		return( EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( pdGain != NULL )
+	{
+		*pdGain = m_pdGains[iSignalNumber];
+	}
+
+	if( pdOffset != NULL )
+	{
+		*pdOffset = m_pdOffsets[iSignalNumber];
+	}
+
+	return( EDF_SUCCESS );
+}
+
+/*!
+*   \brief Get the digital range of a signal (extreme sample values the A/D converter can produce).
+*   \param iSignalNumber must contain the desired signal number.
+*   \param piDigitalMinimum is loaded with the digital minimum if not null.
+*   \param piDigitalMaximum is loaded with the digital maximum if not null.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eGetDigitalRange( int iSignalNumber, int *piDigitalMinimum, int *piDigitalMaximum )
+{
+	edfStatus_E eEdfStatus = EDF_INVALID_SIGNAL_REQUESTED;
+
+	if( !bReadyStatus( &eEdfStatus ) )
+	{
+		return( eEdfStatus );
+	}
+
+	if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+	{
+		return( EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( piDigitalMinimum != NULL )
+	{
+		*piDigitalMinimum = m_piDigitalMinimums[iSignalNumber];
+	}
+
+	if( piDigitalMaximum != NULL )
+	{
+		*piDigitalMaximum = m_piDigitalMaximums[iSignalNumber];
+	}
+
+	return( EDF_SUCCESS );
+}
+
+/*!
+*   \brief Get the number of bytes in the header record, as stored in the header.
+*	\note Compare with iGetHeaderBytes() (256 + ns * 256) to detect an inconsistent header.
+*   \param piHeaderSize is loaded with the header size if not null.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eGetHeaderSize( int *piHeaderSize )
+{
+	m_eDynamicStatus = EDF_SUCCESS;	// be optimistic
+
+	memcpy( m_szValue, m_acHeaderFixedLength.acHeaderSize, eHeaderSize );
+	m_szValue[ eHeaderSize ] = '\0';	// make sure there is a string terminator
+
+	char *pcEnd = NULL;
+	long lHeaderSize = strtol( m_szValue, &pcEnd, 10 );
+	if( pcEnd == m_szValue )
+	{
+		lHeaderSize = 0;
+		m_eDynamicStatus = EDF_FILE_CONTENTS_ERROR;
+	}
+
+	if( piHeaderSize )
+	{
+		*piHeaderSize = (int)lHeaderSize;
+	}
+
+	return( m_eDynamicStatus );
+}
+
+/*!
+*   \brief Read whole data records (all signals, in file order) with a single seek.
+*	\note Each record holds iGetSamplesPerRecord() samples; signal n starts at iGetSignalOffset(n).
+*   \param llFirstRecord is the first data record to read (0 based).
+*   \param llNumberRecords is the number of consecutive data records to read.
+*   \param psRecords is loaded with llNumberRecords * iGetSamplesPerRecord() samples.
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CReadEDF::eReadRecords( long long llFirstRecord, long long llNumberRecords, short int *psRecords )
+{
+	m_eDynamicStatus = EDF_VOID;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( !bReadyStatus( &m_eDynamicStatus ) )
+		{
+			break;
+		}
+
+		// A negative number of data records means "unknown", so then rely on the read to fail:
+		if( llFirstRecord < 0 || llNumberRecords <= 0 || psRecords == NULL
+			|| (m_llNumberRecords >= 0 && llFirstRecord + llNumberRecords > m_llNumberRecords) )
+		{
+			m_eDynamicStatus = EDF_INVALID_RECORD_REQUESTED;
+			break;
+		}
+
+		m_poEdfFile->clear();
+		m_poEdfFile->seekg( (streamoff)(m_iHeaderBytes + (llFirstRecord * m_iRecordSize)) );
+
+		if( m_poEdfFile->fail() )
+		{
+			m_eDynamicStatus = EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		m_poEdfFile->read( reinterpret_cast<char *>(psRecords), (streamsize)(llNumberRecords * m_iRecordSize) );
+
+		if( m_poEdfFile->fail() )
+		{
+			m_eDynamicStatus = EDF_FILE_CONTENTS_ERROR;
+			break;
+		}
+
+		m_eDynamicStatus = EDF_SUCCESS;
 	} //for()
 
 	return( m_eDynamicStatus );
@@ -103,9 +103,12 @@ class CReadEDF
 		EDF_TIME_ERROR,
 		EDF_DATE_ERROR,
 		EDF_INVALID_SIGNAL_REQUESTED,
+		EDF_INVALID_RECORD_REQUESTED,
+		EDF_INVALID_PARAMETER,
 	};
 
 	CReadEDF( char *csInputFile, edfStatus_E *peEdfStatus = NULL );
+	CReadEDF( istream *poInput, edfStatus_E *peEdfStatus = NULL, bool bOwnsStream = false );
 	~CReadEDF( void );
 
 	//! \brief Return dynamic status (based on last file access)
@@ -138,24 +141,79 @@ class CReadEDF
 
 	char *pszGetStartTime( edfStatus_E *peEdfStatus = NULL );
 	char *pszGetStartDate( edfStatus_E *peEdfStatus = NULL );
+	edfStatus_E eGetStartSeconds( long long *pllSeconds );
+	bool bIsEdfPlus( bool *pbDiscontinuous = NULL );
 
 	edfStatus_E eGetNumberSignals( int* piNumberSignals = NULL, char* pszNumberSignals = NULL  );
 	char *pszGetNumberSignals( edfStatus_E *peEdfStatus = NULL );
 
-	edfStatus_E eGetNumberRecords( int* piNumberRecords = NULL, char* pszNumberRecords = NULL );
+	edfStatus_E eGetNumberRecords( long long* pllNumberRecords = NULL, char* pszNumberRecords = NULL );
 	char *pszGetNumberRecords( edfStatus_E *peEdfStatus = NULL );
 
 	edfStatus_E eGetDuration( int* piDuration = NULL, char* pszDuration = NULL );
 	char *pszGetDuration( edfStatus_E *eEdfStatus = NULL );
 
 	char *pszGetSignalLabel( int iSignalNumber, edfStatus_E *peEdfStatus = NULL );
+	int iFindSignal( const char *pszLabel );
 
 	int iGetNumberSamples( int iSignalNumber, edfStatus_E *peEdfStatus = NULL );
 
-	edfStatus_E eGetSample( short int iSignalNumber, int iSampleNumber, int *piSampleValue );
+	edfStatus_E eGetSample( short int iSignalNumber, long long llSampleNumber, int *piSampleValue );
+
+	// Record (bulk) access, using the data record layout built by the constructor:
+	edfStatus_E eReadRecords( long long llFirstRecord, long long llNumberRecords, short int *psRecords );
+
+	//! \brief Return the total number of samples (all signals) in one data record.
+	int iGetSamplesPerRecord( void )
+	{
+		return( m_iSamplesPerRecord );
+	};
+
+	//! \brief Return the sample offset of a signal within one data record (-1 if invalid).
+	int iGetSignalOffset( int iSignalNumber )
+	{
+		if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals || m_piSignalOffsets == NULL )
+		{
+			return( -1 );
+		}
+
+		return( m_piSignalOffsets[iSignalNumber] );
+	};
+
+	//! \brief Return the number of bytes in one data record.
+	int iGetRecordSize( void )
+	{
+		return( m_iRecordSize );
+	};
+
+	//! \brief Return the header record size implied by the number of signals (256 + ns * 256).
+	int iGetHeaderBytes( void )
+	{
+		return( m_iHeaderBytes );
+	};
+
+	double dGetRecordDuration( void )
+	{
+		return( m_dDuration );
+	};
+
+	double dGetSampleRate( int iSignalNumber, edfStatus_E *peEdfStatus = NULL );
+	edfStatus_E eGetCalibration( int iSignalNumber, double *pdGain, double *pdOffset );
+	edfStatus_E eGetDigitalRange( int iSignalNumber, int *piDigitalMinimum, int *piDigitalMaximum );
+	edfStatus_E eGetHeaderSize( int *piHeaderSize );
 
 	private:
-	ifstream *m_poEdfFile;
+	friend class CEditEDF;								///< rewrites headers using the layout structs below
+	friend class CAnonymizeEDF;							///< blanks identifying header fields in place
+
+	void vInitialize( void );
+	edfStatus_E eReadHeader( void );
+	edfStatus_E eBuildRecordLayout( void );
+	double dParseField( const char *pacField, int iSize );
+	int iGetEdfPlusYear( void );
+
+	istream *m_poEdfFile;
+	bool m_bOwnsStream;									///< true when the destructor deletes the stream
 	edfStatus_E m_edfStatus;
 
 	edfStatus_E m_eStaticStatus;						///< status at end of contypedef structor
@@ -164,7 +222,7 @@ class CReadEDF
 	char *m_pcFileData;
 
 	int m_iNumberSignals;
-	int m_iNumberRecords;
+	long long m_llNumberRecords;						///< 64-bit, so record * record size never overflows
 	int m_iDuration;
 
 //	char **pacHeaderVariableLength;
@@ -179,6 +237,18 @@ class CReadEDF
 	char *m_pacNumberSamples;
 	char *m_pacReserveds;
 
+	// Data record layout (derived from the header by eBuildRecordLayout()):
+	int *m_piNumberSamples;								///< samples per data record for each signal
+	int *m_piSignalOffsets;								///< sample offset of each signal within a data record
+	double *m_pdGains;									///< physical units per digital step for each signal
+	double *m_pdOffsets;								///< physical value at digital 0 for each signal
+	int *m_piDigitalMinimums;							///< digital minimum of each signal
+	int *m_piDigitalMaximums;							///< digital maximum of each signal
+	int m_iSamplesPerRecord;							///< samples (all signals) in one data record
+	int m_iRecordSize;									///< bytes in one data record
+	int m_iHeaderBytes;									///< bytes in the header record (256 + ns * 256)
+	double m_dDuration;									///< duration of a data record, in seconds (may be fractional)
+
 	// Define the Fixed Length Header fields for use in application programs:
 	struct format_S
     {
@@ -0,0 +1,998 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementations for the local (Unix domain socket) recording server and its client.
+*/
+
+#include "edfserver.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <algorithm>
+
+using namespace std;
+using namespace edfServerProtocol;
+
+/*!
+*   \brief Send one message, optionally with a descriptor attached (SCM_RIGHTS).
+*   \return true if the whole message was sent.
+*/
+
+static bool bSendMessage( int iSocket, const void *pvData, size_t iBytes, int iFd = -1 )
+{
+	union
+	{
+		char acBuffer[CMSG_SPACE( sizeof(int) )];
+		struct cmsghdr sAlign;
+	} uControl;
+	struct iovec sIo;
+	struct msghdr sMessage;
+
+	memset( &sMessage, 0, sizeof(sMessage) );
+	memset( &uControl, 0, sizeof(uControl) );
+	sIo.iov_base = (void *)pvData;
+	sIo.iov_len = iBytes;
+	sMessage.msg_iov = &sIo;
+	sMessage.msg_iovlen = 1;
+
+	if( iFd >= 0 )
+	{
+		sMessage.msg_control = uControl.acBuffer;
+		sMessage.msg_controllen = sizeof(uControl.acBuffer);
+
+		struct cmsghdr *psControl = CMSG_FIRSTHDR( &sMessage );
+		psControl->cmsg_level = SOL_SOCKET;
+		psControl->cmsg_type = SCM_RIGHTS;
+		psControl->cmsg_len = CMSG_LEN( sizeof(int) );
+		memcpy( CMSG_DATA( psControl ), &iFd, sizeof(int) );
+	}
+
+	return( sendmsg( iSocket, &sMessage, MSG_NOSIGNAL ) == (ssize_t)iBytes );
+}
+
+/*!
+*   \brief Receive one message of exactly iBytes and the descriptor attached to it, if any.
+*   \param piFd - loaded with the received descriptor, or -1 (may be null when none is expected)
+*   \return true if a whole message was received.
+*/
+
+static bool bReceiveMessage( int iSocket, void *pvData, size_t iBytes, int *piFd = NULL )
+{
+	union
+	{
+		char acBuffer[CMSG_SPACE( sizeof(int) )];
+		struct cmsghdr sAlign;
+	} uControl;
+	struct iovec sIo;
+	struct msghdr sMessage;
+	ssize_t iReceived;
+
+	memset( &sMessage, 0, sizeof(sMessage) );
+	sIo.iov_base = pvData;
+	sIo.iov_len = iBytes;
+	sMessage.msg_iov = &sIo;
+	sMessage.msg_iovlen = 1;
+	sMessage.msg_control = uControl.acBuffer;
+	sMessage.msg_controllen = sizeof(uControl.acBuffer);
+
+	do
+	{
+		iReceived = recvmsg( iSocket, &sMessage, MSG_CMSG_CLOEXEC );
+	} while( iReceived < 0 && errno == EINTR );
+
+	int iFd = -1;
+
+	for( struct cmsghdr *psControl = CMSG_FIRSTHDR( &sMessage ); psControl != NULL; psControl = CMSG_NXTHDR( &sMessage, psControl ) )
+	{
+		if( psControl->cmsg_level == SOL_SOCKET && psControl->cmsg_type == SCM_RIGHTS )
+		{
+			memcpy( &iFd, CMSG_DATA( psControl ), sizeof(int) );
+		}
+	}
+
+	if( piFd != NULL )
+	{
+		*piFd = iFd;
+	}
+	else if( iFd >= 0 )
+	{
+		close( iFd );			// unexpected descriptor
+	}
+
+	return( iReceived == (ssize_t)iBytes );
+}
+
+/*!
+*   \brief Create a memfd holding a copy of a buffer, sealed against any further change.
+*   \return Descriptor, or -1 on failure.
+*/
+
+static int iCreateSealedMemFd( const char *pszName, size_t iBytes, const void *pvData )
+{
+	int iMemFd = memfd_create( pszName, MFD_CLOEXEC | MFD_ALLOW_SEALING );
+
+	if( iMemFd >= 0 && iBytes > 0 && pvData != NULL )
+	{
+		const char *pcData = (const char *)pvData;
+
+		for( size_t iDone = 0; iDone < iBytes; )
+		{
+			ssize_t iWritten = write( iMemFd, pcData + iDone, iBytes - iDone );
+
+			if( iWritten <= 0 )
+			{
+				close( iMemFd );
+				return( -1 );
+			}
+
+			iDone += iWritten;
+		}
+	}
+
+	if( iMemFd >= 0 && pvData != NULL )
+	{
+		fcntl( iMemFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL );
+	}
+
+	return( iMemFd );
+}
+
+/*!
+*   \brief Constructor
+*   \param pszSocketPath - file system path of the Unix domain socket (created by eRun())
+*/
+
+CServerEDF::CServerEDF( const char *pszSocketPath )
+{
+	m_sSocketPath = (pszSocketPath != NULL) ? pszSocketPath : "";
+	m_iListenSocket = -1;
+	m_bStopping = false;
+	m_llCacheBytes = 0;
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CServerEDF::~CServerEDF( void )
+{
+	while( !m_asClients.empty() )
+	{
+		vDisconnect( m_asClients.size() - 1 );
+	}
+
+	for( list<cachedBlock_S>::iterator it = m_asCache.begin(); it != m_asCache.end(); ++it )
+	{
+		close( it->iMemFd );
+	}
+
+	for( size_t iHandle = 0; iHandle < m_asFiles.size(); iHandle++ )
+	{
+		delete m_asFiles[iHandle].poEDF;
+	}
+
+	if( m_iListenSocket >= 0 )
+	{
+		close( m_iListenSocket );
+		unlink( m_sSocketPath.c_str() );
+	}
+}
+
+/*!
+*   \brief Serve clients until vStop() is called.
+*   \return EDF_SUCCESS after vStop(), EDF_FILE_OPEN_ERROR if the socket can not be created.
+*/
+
+CReadEDF::edfStatus_E CServerEDF::eRun( void )
+{
+	struct sockaddr_un sAddress;
+
+	memset( &sAddress, 0, sizeof(sAddress) );
+	sAddress.sun_family = AF_UNIX;
+
+	if( m_sSocketPath.empty() || m_sSocketPath.size() >= sizeof(sAddress.sun_path) )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	strncpy( sAddress.sun_path, m_sSocketPath.c_str(), sizeof(sAddress.sun_path) - 1 );
+
+	if( m_iListenSocket < 0 )
+	{
+		m_iListenSocket = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+		unlink( m_sSocketPath.c_str() );		// stale socket of a previous run
+
+		if( m_iListenSocket < 0
+			|| bind( m_iListenSocket, (struct sockaddr *)&sAddress, sizeof(sAddress) ) != 0
+			|| chmod( m_sSocketPath.c_str(), S_IRUSR | S_IWUSR ) != 0		// owner only: clients get our file access
+			|| listen( m_iListenSocket, 16 ) != 0 )
+		{
+			if( m_iListenSocket >= 0 )
+			{
+				close( m_iListenSocket );
+				m_iListenSocket = -1;
+			}
+
+			return( CReadEDF::EDF_FILE_OPEN_ERROR );
+		}
+	}
+
+	while( !m_bStopping )
+	{
+		vector<struct pollfd> asPoll( 1 + m_asClients.size() );
+
+		asPoll[0].fd = m_iListenSocket;
+		asPoll[0].events = POLLIN;
+
+		for( size_t iClient = 0; iClient < m_asClients.size(); iClient++ )
+		{
+			asPoll[1 + iClient].fd = m_asClients[iClient].iSocket;
+			asPoll[1 + iClient].events = POLLIN;
+		}
+
+		if( poll( &asPoll[0], asPoll.size(), POLL_MILLISECONDS ) <= 0 )
+		{
+			continue;			// timeout or EINTR: check m_bStopping
+		}
+
+		// Clients first, from the back, so disconnecting one does not move the ones not yet served:
+		for( size_t iClient = m_asClients.size(); iClient-- > 0; )
+		{
+			if( asPoll[1 + iClient].revents != 0 && !bServeRequest( m_asClients[iClient] ) )
+			{
+				vDisconnect( iClient );
+			}
+		}
+
+		if( asPoll[0].revents & POLLIN )
+		{
+			int iSocket = accept4( m_iListenSocket, NULL, NULL, SOCK_CLOEXEC );
+			struct ucred sPeer;
+			socklen_t iPeerSize = sizeof(sPeer);
+
+			// Only our own user (the socket mode already says so; this also covers the moment before chmod()):
+			if( iSocket >= 0 && (getsockopt( iSocket, SOL_SOCKET, SO_PEERCRED, &sPeer, &iPeerSize ) != 0 || sPeer.uid != geteuid()) )
+			{
+				close( iSocket );
+			}
+			else if( iSocket >= 0 && m_asClients.size() >= MAX_CLIENTS )
+			{
+				close( iSocket );
+			}
+			else if( iSocket >= 0 )
+			{
+				client_S sClient;
+				sClient.iSocket = iSocket;
+				m_asClients.push_back( sClient );
+			}
+		}
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Receive and answer one request.
+*   \return false if the client is gone (or broke the protocol) and must be disconnected.
+*/
+
+bool CServerEDF::bServeRequest( client_S &sClient )
+{
+	request_S sRequest;
+
+	if( !bReceiveMessage( sClient.iSocket, &sRequest, sizeof(sRequest) ) )
+	{
+		return( false );
+	}
+
+	sRequest.szPath[PATH_BYTES - 1] = '\0';
+
+	switch( sRequest.iCommand )
+	{
+		case CMD_OPEN:
+			return( bOpenFile( sClient, sRequest ) );
+
+		case CMD_READ:
+			return( bReadRecords( sClient, sRequest ) );
+
+		case CMD_CLOSE:
+			return( bCloseFile( sClient, sRequest ) );
+
+		default:
+			return( false );
+	}
+}
+
+/*!
+*   \brief CMD_OPEN: open (or share) a recording and send its header information and signal table.
+*/
+
+bool CServerEDF::bOpenFile( client_S &sClient, const request_S &sRequest )
+{
+	reply_S sReply;
+	char szRealPath[PATH_MAX];
+
+	memset( &sReply, 0, sizeof(sReply) );
+	sReply.iStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	sReply.iHandle = -1;
+
+	if( realpath( sRequest.szPath, szRealPath ) == NULL )
+	{
+		return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply) ) );
+	}
+
+	int iHandle = -1;
+	map<string, int>::iterator itFound = m_aiHandleByPath.find( szRealPath );
+
+	if( itFound != m_aiHandleByPath.end() )
+	{
+		iHandle = itFound->second;
+	}
+	else
+	{
+		CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+		CReadEDF *poEDF = new CReadEDF( szRealPath, &eEdfStatus );
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			delete poEDF;
+			sReply.iStatus = eEdfStatus;
+			return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply) ) );
+		}
+
+		for( iHandle = 0; iHandle < (int)m_asFiles.size() && m_asFiles[iHandle].poEDF != NULL; iHandle++ )
+		{
+		}
+
+		if( iHandle == (int)m_asFiles.size() )
+		{
+			m_asFiles.push_back( file_S() );
+		}
+
+		long long llNumberRecords = 0;
+		struct stat sStat;
+
+		poEDF->eGetNumberRecords( &llNumberRecords );
+
+		if( llNumberRecords < 0 )
+		{
+			llNumberRecords = (poEDF->iGetRecordSize() > 0 && stat( szRealPath, &sStat ) == 0)
+				? max( 0LL, ((long long)sStat.st_size - poEDF->iGetHeaderBytes()) / poEDF->iGetRecordSize() ) : 0;
+		}
+
+		m_asFiles[iHandle].sPath = szRealPath;
+		m_asFiles[iHandle].poEDF = poEDF;
+		m_asFiles[iHandle].llNumberRecords = llNumberRecords;
+		m_asFiles[iHandle].iReferences = 0;
+		m_aiHandleByPath[szRealPath] = iHandle;
+	}
+
+	CReadEDF *poEDF = m_asFiles[iHandle].poEDF;
+	vector<signalInfo_S> asSignals;
+
+	m_asFiles[iHandle].iReferences++;
+	sClient.aiHandles.push_back( iHandle );
+
+	sReply.iStatus = CReadEDF::EDF_SUCCESS;
+	sReply.iHandle = iHandle;
+	sReply.iSamplesPerRecord = poEDF->iGetSamplesPerRecord();
+	sReply.dDuration = poEDF->dGetRecordDuration();
+	sReply.llNumberRecords = m_asFiles[iHandle].llNumberRecords;
+	poEDF->eGetNumberSignals( &sReply.iNumberSignals );
+	poEDF->eGetStartSeconds( &sReply.llStartSeconds );
+
+	asSignals.resize( sReply.iNumberSignals );
+
+	for( int iThisSignal = 0; iThisSignal < sReply.iNumberSignals; iThisSignal++ )
+	{
+		signalInfo_S &sSignal = asSignals[iThisSignal];
+		const char *pszLabel = poEDF->pszGetSignalLabel( iThisSignal );
+
+		memset( &sSignal, 0, sizeof(sSignal) );
+		strncpy( sSignal.szLabel, (pszLabel != NULL) ? pszLabel : "", LABEL_BYTES - 1 );
+		sSignal.iNumberSamples = poEDF->iGetNumberSamples( iThisSignal );
+		sSignal.iSignalOffset = poEDF->iGetSignalOffset( iThisSignal );
+		poEDF->eGetDigitalRange( iThisSignal, &sSignal.iDigitalMinimum, &sSignal.iDigitalMaximum );
+		poEDF->eGetCalibration( iThisSignal, &sSignal.dGain, &sSignal.dOffset );
+	}
+
+	sReply.llBytes = (long long)(asSignals.size() * sizeof(signalInfo_S));
+
+	int iMemFd = iCreateSealedMemFd( "edf-signals", (size_t)sReply.llBytes, asSignals.empty() ? NULL : &asSignals[0] );
+	bool bSent = bSendMessage( sClient.iSocket, &sReply, sizeof(sReply), iMemFd );
+
+	if( iMemFd >= 0 )
+	{
+		close( iMemFd );
+	}
+
+	return( bSent );
+}
+
+/*!
+*   \brief CMD_READ: send a sealed memfd with the requested data records (from the cache when possible).
+*/
+
+bool CServerEDF::bReadRecords( client_S &sClient, const request_S &sRequest )
+{
+	reply_S sReply;
+
+	memset( &sReply, 0, sizeof(sReply) );
+	sReply.iHandle = sRequest.iHandle;
+	sReply.iStatus = CReadEDF::EDF_INVALID_PARAMETER;
+
+	if( find( sClient.aiHandles.begin(), sClient.aiHandles.end(), sRequest.iHandle ) == sClient.aiHandles.end() )
+	{
+		return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply) ) );
+	}
+
+	CReadEDF *poEDF = m_asFiles[sRequest.iHandle].poEDF;
+	long long llBytes = sRequest.llNumberRecords * poEDF->iGetRecordSize();
+
+	sReply.llNumberRecords = m_asFiles[sRequest.iHandle].llNumberRecords;
+
+	if( sRequest.llFirstRecord < 0 || sRequest.llNumberRecords <= 0 || llBytes > MAX_BLOCK_BYTES
+		|| sRequest.llFirstRecord + sRequest.llNumberRecords > sReply.llNumberRecords )
+	{
+		sReply.iStatus = CReadEDF::EDF_INVALID_RECORD_REQUESTED;
+		return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply) ) );
+	}
+
+	list<cachedBlock_S>::iterator itBlock = m_asCache.begin();
+
+	for( ; itBlock != m_asCache.end(); ++itBlock )
+	{
+		if( itBlock->iHandle == sRequest.iHandle && itBlock->llFirstRecord == sRequest.llFirstRecord
+			&& itBlock->llNumberRecords == sRequest.llNumberRecords )
+		{
+			break;
+		}
+	}
+
+	if( itBlock != m_asCache.end() )
+	{
+		m_asCache.splice( m_asCache.begin(), m_asCache, itBlock );		// most recently used
+	}
+	else
+	{
+		// Read straight into the shared pages, then seal them before anyone else sees them:
+		int iMemFd = iCreateSealedMemFd( "edf-records", 0, NULL );
+		void *pvRecords = MAP_FAILED;
+
+		if( iMemFd >= 0 && ftruncate( iMemFd, (off_t)llBytes ) == 0 )
+		{
+			pvRecords = mmap( NULL, (size_t)llBytes, PROT_READ | PROT_WRITE, MAP_SHARED, iMemFd, 0 );
+		}
+
+		sReply.iStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+
+		if( pvRecords != MAP_FAILED )
+		{
+			sReply.iStatus = poEDF->eReadRecords( sRequest.llFirstRecord, sRequest.llNumberRecords, (short int *)pvRecords );
+			munmap( pvRecords, (size_t)llBytes );
+		}
+
+		if( sReply.iStatus != CReadEDF::EDF_SUCCESS
+			|| fcntl( iMemFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL ) != 0 )
+		{
+			if( iMemFd >= 0 )
+			{
+				close( iMemFd );
+			}
+
+			return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply) ) );
+		}
+
+		if( llBytes > CACHE_BYTES )
+		{
+			sReply.llBytes = llBytes;
+
+			bool bSent = bSendMessage( sClient.iSocket, &sReply, sizeof(sReply), iMemFd );
+
+			close( iMemFd );
+			return( bSent );
+		}
+
+		cachedBlock_S sBlock = { sRequest.iHandle, sRequest.llFirstRecord, sRequest.llNumberRecords, iMemFd, llBytes };
+		m_asCache.push_front( sBlock );
+		m_llCacheBytes += llBytes;
+
+		// Evict least recently used blocks; the new one fits on its own:
+		while( m_asCache.size() > CACHE_BLOCKS || m_llCacheBytes > CACHE_BYTES )
+		{
+			m_llCacheBytes -= m_asCache.back().llBytes;
+			close( m_asCache.back().iMemFd );
+			m_asCache.pop_back();
+		}
+	}
+
+	sReply.iStatus = CReadEDF::EDF_SUCCESS;
+	sReply.llBytes = m_asCache.front().llBytes;
+
+	return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply), m_asCache.front().iMemFd ) );
+}
+
+/*!
+*   \brief CMD_CLOSE: drop one of the client's references to a recording.
+*/
+
+bool CServerEDF::bCloseFile( client_S &sClient, const request_S &sRequest )
+{
+	reply_S sReply;
+	vector<int>::iterator itHandle = find( sClient.aiHandles.begin(), sClient.aiHandles.end(), sRequest.iHandle );
+
+	memset( &sReply, 0, sizeof(sReply) );
+	sReply.iHandle = sRequest.iHandle;
+	sReply.iStatus = CReadEDF::EDF_INVALID_PARAMETER;
+
+	if( itHandle != sClient.aiHandles.end() )
+	{
+		sClient.aiHandles.erase( itHandle );
+		vReleaseHandle( sRequest.iHandle );
+		sReply.iStatus = CReadEDF::EDF_SUCCESS;
+	}
+
+	return( bSendMessage( sClient.iSocket, &sReply, sizeof(sReply) ) );
+}
+
+/*!
+*   \brief Drop one reference to a recording; the last one closes it and evicts its cached blocks.
+*/
+
+void CServerEDF::vReleaseHandle( int iHandle )
+{
+	file_S &sFile = m_asFiles[iHandle];
+
+	if( --sFile.iReferences > 0 )
+	{
+		return;
+	}
+
+	for( list<cachedBlock_S>::iterator it = m_asCache.begin(); it != m_asCache.end(); )
+	{
+		if( it->iHandle == iHandle )
+		{
+			m_llCacheBytes -= it->llBytes;
+			close( it->iMemFd );
+			it = m_asCache.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	m_aiHandleByPath.erase( sFile.sPath );
+	delete sFile.poEDF;
+	sFile.poEDF = NULL;
+	sFile.sPath.clear();
+}
+
+/*!
+*   \brief Close a client connection and release the recordings it still has open.
+*/
+
+void CServerEDF::vDisconnect( size_t iClient )
+{
+	client_S &sClient = m_asClients[iClient];
+
+	for( size_t i = 0; i < sClient.aiHandles.size(); i++ )
+	{
+		vReleaseHandle( sClient.aiHandles[i] );
+	}
+
+	close( sClient.iSocket );
+	m_asClients.erase( m_asClients.begin() + iClient );
+}
+
+/*!
+*   \brief Constructor - connect to the server and open a recording.
+*   \param pszSocketPath - server socket path
+*   \param pszInputFile - recording (resolved by the server, so relative paths need the same working directory)
+*   \param peEdfStatus - loaded with the open status if not null
+*/
+
+CClientEDF::CClientEDF( const char *pszSocketPath, const char *pszInputFile, CReadEDF::edfStatus_E *peEdfStatus )
+{
+	struct sockaddr_un sAddress;
+
+	m_eStaticStatus = CReadEDF::EDF_FILE_OPEN_ERROR;
+	memset( &m_sInfo, 0, sizeof(m_sInfo) );
+	memset( &sAddress, 0, sizeof(sAddress) );
+	sAddress.sun_family = AF_UNIX;
+
+	m_iSocket = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( m_iSocket < 0 || pszSocketPath == NULL || pszInputFile == NULL
+			|| strlen( pszSocketPath ) >= sizeof(sAddress.sun_path) || strlen( pszInputFile ) >= PATH_BYTES )
+		{
+			break;
+		}
+
+		strncpy( sAddress.sun_path, pszSocketPath, sizeof(sAddress.sun_path) - 1 );
+
+		if( connect( m_iSocket, (struct sockaddr *)&sAddress, sizeof(sAddress) ) != 0 )
+		{
+			break;
+		}
+
+		request_S sRequest;
+		int iMemFd = -1;
+
+		memset( &sRequest, 0, sizeof(sRequest) );
+		sRequest.iCommand = CMD_OPEN;
+		strncpy( sRequest.szPath, pszInputFile, PATH_BYTES - 1 );
+
+		m_eStaticStatus = eRequest( sRequest, &m_sInfo, &iMemFd );
+		if( m_eStaticStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		// Signal table:
+		m_asSignals.resize( m_sInfo.iNumberSignals );
+
+		if( m_sInfo.iNumberSignals > 0 )
+		{
+			void *pvTable = (iMemFd >= 0 && m_sInfo.llBytes == (long long)(m_asSignals.size() * sizeof(signalInfo_S)))
+				? mmap( NULL, (size_t)m_sInfo.llBytes, PROT_READ, MAP_SHARED, iMemFd, 0 ) : MAP_FAILED;
+
+			if( pvTable == MAP_FAILED )
+			{
+				m_eStaticStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			}
+			else
+			{
+				memcpy( &m_asSignals[0], pvTable, (size_t)m_sInfo.llBytes );
+				munmap( pvTable, (size_t)m_sInfo.llBytes );
+			}
+		}
+
+		if( iMemFd >= 0 )
+		{
+			close( iMemFd );
+		}
+	} //for()
+
+	if( peEdfStatus != NULL )
+	{
+		*peEdfStatus = m_eStaticStatus;
+	}
+}
+
+/*!
+*   \brief Destructor - disconnecting releases the recording on the server.
+*/
+
+CClientEDF::~CClientEDF( void )
+{
+	if( m_iSocket >= 0 )
+	{
+		close( m_iSocket );
+	}
+}
+
+/*!
+*   \brief Send a request and wait for its reply.
+*   \param piMemFd - loaded with the attached descriptor or -1 (the caller closes it)
+*   \return Status from the reply, EDF_FILE_OPEN_ERROR if the server can not be reached.
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eRequest( const request_S &sRequest, reply_S *psReply, int *piMemFd )
+{
+	*piMemFd = -1;
+
+	if( !bSendMessage( m_iSocket, &sRequest, sizeof(sRequest) ) || !bReceiveMessage( m_iSocket, psReply, sizeof(*psReply), piMemFd ) )
+	{
+		if( *piMemFd >= 0 )
+		{
+			close( *piMemFd );
+			*piMemFd = -1;
+		}
+
+		return( CReadEDF::EDF_FILE_OPEN_ERROR );
+	}
+
+	return( (CReadEDF::edfStatus_E)psReply->iStatus );
+}
+
+/*!
+*   \brief Return the number of signals.
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eGetNumberSignals( int *piNumberSignals )
+{
+	if( piNumberSignals != NULL )
+	{
+		*piNumberSignals = m_sInfo.iNumberSignals;
+	}
+
+	return( m_eStaticStatus );
+}
+
+/*!
+*   \brief Return the number of data records (counted from the file size by the server if the header says -1).
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eGetNumberRecords( long long *pllNumberRecords )
+{
+	if( pllNumberRecords != NULL )
+	{
+		*pllNumberRecords = m_sInfo.llNumberRecords;
+	}
+
+	return( m_eStaticStatus );
+}
+
+/*!
+*   \brief Return the recording start in seconds since 1970 (see CReadEDF::eGetStartSeconds()).
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eGetStartSeconds( long long *pllSeconds )
+{
+	if( pllSeconds != NULL )
+	{
+		*pllSeconds = m_sInfo.llStartSeconds;
+	}
+
+	return( m_eStaticStatus );
+}
+
+/*!
+*   \brief Return the label of a signal (NULL if invalid).
+*/
+
+const char *CClientEDF::pszGetSignalLabel( int iSignalNumber )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= (int)m_asSignals.size() )
+	{
+		return( NULL );
+	}
+
+	return( m_asSignals[iSignalNumber].szLabel );
+}
+
+/*!
+*   \brief Find a signal by label, ignoring surrounding spaces and case (see CReadEDF::iFindSignal()).
+*   \return Signal number, or -1 if not found.
+*/
+
+int CClientEDF::iFindSignal( const char *pszLabel )
+{
+	if( pszLabel == NULL )
+	{
+		return( -1 );
+	}
+
+	string sWanted( pszLabel );
+	sWanted.erase( 0, min( sWanted.find_first_not_of( ' ' ), sWanted.size() ) );
+	sWanted.erase( sWanted.find_last_not_of( ' ' ) + 1 );
+
+	for( size_t iThisSignal = 0; iThisSignal < m_asSignals.size(); iThisSignal++ )
+	{
+		string sLabel( m_asSignals[iThisSignal].szLabel );
+		sLabel.erase( 0, min( sLabel.find_first_not_of( ' ' ), sLabel.size() ) );
+		sLabel.erase( sLabel.find_last_not_of( ' ' ) + 1 );
+
+		if( strcasecmp( sLabel.c_str(), sWanted.c_str() ) == 0 )
+		{
+			return( (int)iThisSignal );
+		}
+	}
+
+	return( -1 );
+}
+
+/*!
+*   \brief Return the samples per data record of a signal (-1 if invalid).
+*/
+
+int CClientEDF::iGetNumberSamples( int iSignalNumber )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= (int)m_asSignals.size() )
+	{
+		return( -1 );
+	}
+
+	return( m_asSignals[iSignalNumber].iNumberSamples );
+}
+
+/*!
+*   \brief Return the sample offset of a signal within a data record (-1 if invalid).
+*/
+
+int CClientEDF::iGetSignalOffset( int iSignalNumber )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= (int)m_asSignals.size() )
+	{
+		return( -1 );
+	}
+
+	return( m_asSignals[iSignalNumber].iSignalOffset );
+}
+
+/*!
+*   \brief Return the calibration of a signal (physical = gain * digital + offset).
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eGetCalibration( int iSignalNumber, double *pdGain, double *pdOffset )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= (int)m_asSignals.size() )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( pdGain != NULL )
+	{
+		*pdGain = m_asSignals[iSignalNumber].dGain;
+	}
+
+	if( pdOffset != NULL )
+	{
+		*pdOffset = m_asSignals[iSignalNumber].dOffset;
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Return the digital minimum and maximum of a signal.
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eGetDigitalRange( int iSignalNumber, int *piDigitalMinimum, int *piDigitalMaximum )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= (int)m_asSignals.size() )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( piDigitalMinimum != NULL )
+	{
+		*piDigitalMinimum = m_asSignals[iSignalNumber].iDigitalMinimum;
+	}
+
+	if( piDigitalMaximum != NULL )
+	{
+		*piDigitalMaximum = m_asSignals[iSignalNumber].iDigitalMaximum;
+	}
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Map a range of data records shared with the server (read-only, record layout as CReadEDF::eReadRecords()).
+*   \param llFirstRecord - first data record (0 based)
+*   \param llNumberRecords - number of data records
+*   \param psMapped - loaded with the mapping; release it with vUnmapRecords()
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eMapRecords( long long llFirstRecord, long long llNumberRecords, mappedRecords_S *psMapped )
+{
+	request_S sRequest;
+	reply_S sReply;
+	int iMemFd = -1;
+
+	if( psMapped == NULL || m_eStaticStatus != CReadEDF::EDF_SUCCESS )
+	{
+		return( (m_eStaticStatus != CReadEDF::EDF_SUCCESS) ? m_eStaticStatus : CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	memset( psMapped, 0, sizeof(*psMapped) );
+	memset( &sRequest, 0, sizeof(sRequest) );
+	sRequest.iCommand = CMD_READ;
+	sRequest.iHandle = m_sInfo.iHandle;
+	sRequest.llFirstRecord = llFirstRecord;
+	sRequest.llNumberRecords = llNumberRecords;
+
+	CReadEDF::edfStatus_E eEdfStatus = eRequest( sRequest, &sReply, &iMemFd );
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS )
+	{
+		void *pvRecords = (iMemFd >= 0) ? mmap( NULL, (size_t)sReply.llBytes, PROT_READ, MAP_SHARED, iMemFd, 0 ) : MAP_FAILED;
+
+		if( pvRecords == MAP_FAILED )
+		{
+			eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+		}
+		else
+		{
+			psMapped->psRecords = (const short int *)pvRecords;
+			psMapped->llFirstRecord = llFirstRecord;
+			psMapped->llNumberRecords = llNumberRecords;
+			psMapped->iBytes = (size_t)sReply.llBytes;
+		}
+	}
+
+	if( iMemFd >= 0 )
+	{
+		close( iMemFd );			// the mapping keeps the pages
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Release a mapping from eMapRecords().
+*/
+
+void CClientEDF::vUnmapRecords( mappedRecords_S *psMapped )
+{
+	if( psMapped != NULL && psMapped->psRecords != NULL )
+	{
+		munmap( (void *)psMapped->psRecords, psMapped->iBytes );
+		psMapped->psRecords = NULL;
+	}
+}
+
+/*!
+*   \brief Read consecutive data records into a caller buffer (see CReadEDF::eReadRecords()).
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eReadRecords( long long llFirstRecord, long long llNumberRecords, short int *psRecords )
+{
+	mappedRecords_S sMapped;
+
+	if( psRecords == NULL )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	CReadEDF::edfStatus_E eEdfStatus = eMapRecords( llFirstRecord, llNumberRecords, &sMapped );
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS )
+	{
+		memcpy( psRecords, sMapped.psRecords, sMapped.iBytes );
+		vUnmapRecords( &sMapped );
+	}
+
+	return( eEdfStatus );
+}
+
+/*!
+*   \brief Return one sample (see CReadEDF::eGetSample()).
+*   \param iSignalNumber - signal (0 based)
+*   \param llSampleNumber - sample of that signal (0 based)
+*/
+
+CReadEDF::edfStatus_E CClientEDF::eGetSample( short int iSignalNumber, long long llSampleNumber, int *piSampleValue )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= (int)m_asSignals.size() || m_asSignals[iSignalNumber].iNumberSamples <= 0 )
+	{
+		return( CReadEDF::EDF_INVALID_SIGNAL_REQUESTED );
+	}
+
+	if( llSampleNumber < 0 || piSampleValue == NULL )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	const signalInfo_S &sSignal = m_asSignals[iSignalNumber];
+	mappedRecords_S sMapped;
+	CReadEDF::edfStatus_E eEdfStatus = eMapRecords( llSampleNumber / sSignal.iNumberSamples, 1, &sMapped );
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS )
+	{
+		*piSampleValue = sMapped.psRecords[sSignal.iSignalOffset + llSampleNumber % sSignal.iNumberSamples];
+		vUnmapRecords( &sMapped );
+	}
+
+	return( eEdfStatus );
+}
+
+#endif // __linux__
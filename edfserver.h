@@ -0,0 +1,224 @@
+#ifndef EDFSERVER_H
+#define EDFSERVER_H
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definitions for the local (Unix domain socket) recording server and its client.
+	\note Linux only (memfd_create, SCM_RIGHTS); on other platforms this header declares nothing.
+*/
+
+#if defined(__linux__)
+
+//! \brief Wire format shared by CServerEDF and CClientEDF (same host, so native byte order).
+namespace edfServerProtocol
+{
+	enum command_E
+	{
+		CMD_OPEN = 1,					///< szPath -> handle, recording info and a signal table memfd
+		CMD_READ,						///< handle, record range -> sealed memfd with the raw data records
+		CMD_CLOSE,						///< handle -> (no descriptor)
+	};
+
+	enum protocolConstants_E
+	{
+		PATH_BYTES = 1024,
+		LABEL_BYTES = 17,				///< 16 ascii + terminator
+	};
+
+	struct request_S
+	{
+		int iCommand;
+		int iHandle;
+		long long llFirstRecord;
+		long long llNumberRecords;
+		char szPath[PATH_BYTES];
+	};
+
+	struct reply_S
+	{
+		int iStatus;					///< CReadEDF::edfStatus_E
+		int iHandle;
+		long long llNumberRecords;
+		long long llBytes;				///< size of the attached memfd
+		int iNumberSignals;
+		int iSamplesPerRecord;
+		double dDuration;
+		long long llStartSeconds;
+	};
+
+	//! \brief One entry of the signal table sent with CMD_OPEN.
+	struct signalInfo_S
+	{
+		char szLabel[LABEL_BYTES];
+		int iNumberSamples;
+		int iSignalOffset;
+		int iDigitalMinimum;
+		int iDigitalMaximum;
+		double dGain;
+		double dOffset;
+	};
+}
+
+/*! \class CServerEDF
+    \brief Local server: opens each recording once and answers record range requests with shared memory.
+
+	Clients connect to a Unix domain (SOCK_SEQPACKET) socket. A file is opened (parsed) once, no
+	matter how many clients use it, and is closed when the last client closes it or disconnects.
+	Record ranges are read straight into a memfd, which is sealed read-only and passed back as a
+	descriptor (SCM_RIGHTS); sample data never travels through the socket. The last CACHE_BLOCKS
+	blocks (at most CACHE_BYTES together) are kept, so clients reading the same range (viewer and scorer on one recording) map
+	the very same pages. Requests are served one at a time from a poll() loop; nothing listens on
+	the network.
+
+	The server opens whatever file a client names with its own rights, so only the user it runs
+	as may use it: the socket is made 0600 right after bind(), and every accepted connection
+	whose peer (SO_PEERCRED) is not that user is closed.
+*/
+
+class CServerEDF
+{
+	public:
+
+	enum serverConstants_E
+	{
+		CACHE_BLOCKS = 64,				///< most recently read record blocks kept as memfds
+		CACHE_BYTES = 1 << 30,			///< cap on the bytes of all cached blocks (larger blocks are sent uncached)
+		MAX_CLIENTS = 256,
+		POLL_MILLISECONDS = 250,		///< how often eRun() checks vStop()
+		MAX_BLOCK_BYTES = 1 << 28,		///< largest record range served by one CMD_READ
+	};
+
+	CServerEDF( const char *pszSocketPath );
+	~CServerEDF( void );
+
+	CReadEDF::edfStatus_E eRun( void );
+
+	//! \brief Ask eRun() to return (safe from another thread or a signal handler).
+	void vStop( void )
+	{
+		m_bStopping = true;
+	};
+
+	private:
+
+	struct file_S
+	{
+		string sPath;
+		CReadEDF *poEDF;
+		long long llNumberRecords;		///< from the file size if the header says -1 (unknown)
+		int iReferences;
+	};
+
+	struct cachedBlock_S
+	{
+		int iHandle;
+		long long llFirstRecord;
+		long long llNumberRecords;
+		int iMemFd;
+		long long llBytes;
+	};
+
+	struct client_S
+	{
+		int iSocket;
+		vector<int> aiHandles;			///< files opened by this client (one entry per open)
+	};
+
+	bool bServeRequest( client_S &sClient );
+	bool bOpenFile( client_S &sClient, const edfServerProtocol::request_S &sRequest );
+	bool bReadRecords( client_S &sClient, const edfServerProtocol::request_S &sRequest );
+	bool bCloseFile( client_S &sClient, const edfServerProtocol::request_S &sRequest );
+	void vReleaseHandle( int iHandle );
+	void vDisconnect( size_t iClient );
+
+	string m_sSocketPath;
+	int m_iListenSocket;
+	atomic<bool> m_bStopping;
+	vector<file_S> m_asFiles;			///< indexed by handle; poEDF is NULL for a free slot
+	map<string, int> m_aiHandleByPath;
+	list<cachedBlock_S> m_asCache;		///< most recently used first
+	long long m_llCacheBytes;			///< bytes of all blocks in m_asCache
+	vector<client_S> m_asClients;
+}; //class CServerEDF
+
+/*! \class CClientEDF
+    \brief Reader API (header queries, record and sample access) on a recording opened by a CServerEDF.
+
+	The header is fetched once at construction. eReadRecords() copies from the shared block into
+	the caller's buffer like CReadEDF::eReadRecords(); eMapRecords() hands out the shared, read-only
+	block itself for callers that can consume it in place (release it with vUnmapRecords()).
+*/
+
+class CClientEDF
+{
+	public:
+
+	//! \brief A read-only mapping of raw data records shared with the server.
+	struct mappedRecords_S
+	{
+		const short int *psRecords;
+		long long llFirstRecord;
+		long long llNumberRecords;
+		size_t iBytes;
+	};
+
+	CClientEDF( const char *pszSocketPath, const char *pszInputFile, CReadEDF::edfStatus_E *peEdfStatus = NULL );
+	~CClientEDF( void );
+
+	bool bReadyStatus( CReadEDF::edfStatus_E *peEdfStatus = NULL )
+	{
+		if( peEdfStatus != NULL )
+		{
+			*peEdfStatus = m_eStaticStatus;
+		}
+
+		return( m_eStaticStatus == CReadEDF::EDF_SUCCESS );
+	};
+
+	CReadEDF::edfStatus_E eGetNumberSignals( int *piNumberSignals );
+	CReadEDF::edfStatus_E eGetNumberRecords( long long *pllNumberRecords );
+	CReadEDF::edfStatus_E eGetStartSeconds( long long *pllSeconds );
+	const char *pszGetSignalLabel( int iSignalNumber );
+	int iFindSignal( const char *pszLabel );
+	int iGetNumberSamples( int iSignalNumber );
+	int iGetSignalOffset( int iSignalNumber );
+	CReadEDF::edfStatus_E eGetCalibration( int iSignalNumber, double *pdGain, double *pdOffset );
+	CReadEDF::edfStatus_E eGetDigitalRange( int iSignalNumber, int *piDigitalMinimum, int *piDigitalMaximum );
+
+	int iGetSamplesPerRecord( void )
+	{
+		return( m_sInfo.iSamplesPerRecord );
+	};
+
+	double dGetRecordDuration( void )
+	{
+		return( m_sInfo.dDuration );
+	};
+
+	CReadEDF::edfStatus_E eReadRecords( long long llFirstRecord, long long llNumberRecords, short int *psRecords );
+	CReadEDF::edfStatus_E eGetSample( short int iSignalNumber, long long llSampleNumber, int *piSampleValue );
+
+	CReadEDF::edfStatus_E eMapRecords( long long llFirstRecord, long long llNumberRecords, mappedRecords_S *psMapped );
+	static void vUnmapRecords( mappedRecords_S *psMapped );
+
+	private:
+
+	CReadEDF::edfStatus_E eRequest( const edfServerProtocol::request_S &sRequest, edfServerProtocol::reply_S *psReply, int *piMemFd );
+
+	int m_iSocket;
+	CReadEDF::edfStatus_E m_eStaticStatus;
+	edfServerProtocol::reply_S m_sInfo;
+	vector<edfServerProtocol::signalInfo_S> m_asSignals;
+}; //class CClientEDF
+
+#endif // __linux__
+
+#endif // EDFSERVER_H
@@ -0,0 +1,502 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementations for epoch-wise spectral analysis (Welch PSD and band power) of EDF data.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "edfspectral.h"
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*!
+*   \brief Constructor - precompute the bit reversal table and twiddle factors.
+*   \param iSize - transform size (must be a power of two)
+*/
+
+CFftPlan::CFftPlan( int iSize )
+{
+	int iBits = 0;
+
+	m_iSize = iSize;
+
+	while( (1 << iBits) < iSize )
+	{
+		iBits++;
+	}
+
+	m_aiBitReverse.resize( iSize );
+
+	for( int i = 0; i < iSize; i++ )
+	{
+		int iReversed = 0;
+
+		for( int iBit = 0; iBit < iBits; iBit++ )
+		{
+			iReversed |= ((i >> iBit) & 1) << (iBits - 1 - iBit);
+		}
+
+		m_aiBitReverse[i] = iReversed;
+	}
+
+	m_adCos.resize( iSize / 2 );
+	m_adSin.resize( iSize / 2 );
+
+	for( int k = 0; k < iSize / 2; k++ )
+	{
+		m_adCos[k] = cos( 2.0 * M_PI * k / iSize );
+		m_adSin[k] = sin( 2.0 * M_PI * k / iSize );
+	}
+}
+
+/*!
+*   \brief In-place forward FFT (iterative radix-2, decimation in time).
+*   \param pdReal - real parts (in/out)
+*   \param pdImaginary - imaginary parts (in/out)
+*/
+
+void CFftPlan::vForward( double *pdReal, double *pdImaginary ) const
+{
+	for( int i = 0; i < m_iSize; i++ )
+	{
+		int j = m_aiBitReverse[i];
+
+		if( j > i )
+		{
+			swap( pdReal[i], pdReal[j] );
+			swap( pdImaginary[i], pdImaginary[j] );
+		}
+	}
+
+	for( int iLength = 2; iLength <= m_iSize; iLength <<= 1 )
+	{
+		int iHalf = iLength / 2;
+		int iStride = m_iSize / iLength;
+
+		for( int iStart = 0; iStart < m_iSize; iStart += iLength )
+		{
+			for( int k = 0; k < iHalf; k++ )
+			{
+				double dCos = m_adCos[k * iStride];
+				double dSin = -m_adSin[k * iStride];
+				int iTop = iStart + k;
+				int iBottom = iTop + iHalf;
+				double dReal = pdReal[iBottom] * dCos - pdImaginary[iBottom] * dSin;
+				double dImaginary = pdReal[iBottom] * dSin + pdImaginary[iBottom] * dCos;
+
+				pdReal[iBottom] = pdReal[iTop] - dReal;
+				pdImaginary[iBottom] = pdImaginary[iTop] - dImaginary;
+				pdReal[iTop] += dReal;
+				pdImaginary[iTop] += dImaginary;
+			}
+		}
+	}
+}
+
+/*!
+*   \brief Constructor - read the header and plan the segment size of every signal.
+*	\note Epochs are rounded to a whole number of data records; a partial last epoch is dropped.
+*   \param pszInputFile - input file (each worker thread opens its own reader on it)
+*   \param dEpochSeconds - epoch length in seconds
+*   \param dSegmentSeconds - Welch segment length in seconds (rounded down to a power of two samples)
+*   \param iNumberThreads - worker threads (0 = one per hardware thread)
+*/
+
+CSpectralEDF::CSpectralEDF( char *pszInputFile, double dEpochSeconds, double dSegmentSeconds, int iNumberThreads )
+{
+	m_pszInputFile = new char[strlen( pszInputFile ) + 1];
+	strcpy( m_pszInputFile, pszInputFile );
+
+	m_dEpochSeconds = dEpochSeconds;
+	m_dSegmentSeconds = dSegmentSeconds;
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+	m_iNumberSignals = 0;
+	m_iRecordsPerEpoch = 0;
+	m_iNumberEpochs = 0;
+
+	m_poEDF = new CReadEDF( m_pszInputFile );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		long long llNumberRecords = 0;
+
+		if( !m_poEDF->bReadyStatus() || m_poEDF->dGetRecordDuration() <= 0.0 )
+		{
+			break;
+		}
+
+		m_poEDF->eGetNumberSignals( &m_iNumberSignals );
+		m_poEDF->eGetNumberRecords( &llNumberRecords );
+
+		m_iRecordsPerEpoch = max( 1, (int)floor( dEpochSeconds / m_poEDF->dGetRecordDuration() + 0.5 ) );
+		m_iNumberEpochs = (int)max( 0LL, llNumberRecords / m_iRecordsPerEpoch );
+
+		m_asSignals.resize( m_iNumberSignals );
+
+		for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+		{
+			signalPlan_S &sSignal = m_asSignals[iThisSignal];
+			int iEpochSamples = m_poEDF->iGetNumberSamples( iThisSignal ) * m_iRecordsPerEpoch;
+			int iSegmentSize = 1;
+
+			sSignal.dSampleRate = m_poEDF->dGetSampleRate( iThisSignal );
+			m_poEDF->eGetCalibration( iThisSignal, &sSignal.dGain, &sSignal.dOffset );
+
+			// Largest power of two that fits both the segment length and the epoch:
+			while( iSegmentSize * 2 <= sSignal.dSampleRate * dSegmentSeconds && iSegmentSize * 2 <= iEpochSamples )
+			{
+				iSegmentSize *= 2;
+			}
+
+			sSignal.iSegmentSize = iSegmentSize;
+			sSignal.iPlan = -1;
+
+			for( size_t iPlan = 0; iPlan < m_aoPlans.size(); iPlan++ )
+			{
+				if( m_aoPlans[iPlan].iGetSize() == iSegmentSize )
+				{
+					sSignal.iPlan = (int)iPlan;
+				}
+			}
+
+			if( sSignal.iPlan < 0 )
+			{
+				sSignal.iPlan = (int)m_aoPlans.size();
+				m_aoPlans.push_back( CFftPlan( iSegmentSize ) );
+			}
+
+			// Periodic Hann window:
+			sSignal.adWindow.resize( iSegmentSize );
+			sSignal.dWindowPower = 0.0;
+
+			for( int i = 0; i < iSegmentSize; i++ )
+			{
+				sSignal.adWindow[i] = 0.5 - 0.5 * cos( 2.0 * M_PI * i / iSegmentSize );
+				sSignal.dWindowPower += sSignal.adWindow[i] * sSignal.adWindow[i];
+			}
+		}
+	} //for()
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CSpectralEDF::~CSpectralEDF( void )
+{
+	delete m_poEDF;
+	delete [] m_pszInputFile;
+}
+
+/*!
+*   \brief Add a frequency band for the band power results.
+*	\note Without any added bands eRun() uses delta, theta, alpha and beta (0.5-4-8-13-30 Hz).
+*   \param dLow - lower band edge in Hz (inclusive)
+*   \param dHigh - upper band edge in Hz (exclusive)
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CSpectralEDF::eAddBand( double dLow, double dHigh )
+{
+	if( dLow < 0.0 || dHigh <= dLow )
+	{
+		return( CReadEDF::EDF_INVALID_PARAMETER );
+	}
+
+	band_S sBand = { dLow, dHigh };
+	m_asBands.push_back( sBand );
+
+	return( CReadEDF::EDF_SUCCESS );
+}
+
+/*!
+*   \brief Return the Welch segment size (samples) of a signal.
+*   \param iSignalNumber - signal number
+*   \return Segment size (0 if invalid).
+*/
+
+int CSpectralEDF::iGetSegmentSize( int iSignalNumber )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+	{
+		return( 0 );
+	}
+
+	return( m_asSignals[iSignalNumber].iSegmentSize );
+}
+
+/*!
+*   \brief Return the PSD bin width (Hz) of a signal; bin k is at k * width.
+*   \param iSignalNumber - signal number
+*   \return Bin width (0.0 if invalid).
+*/
+
+double CSpectralEDF::dGetBinWidth( int iSignalNumber )
+{
+	if( iSignalNumber < 0 || iSignalNumber >= m_iNumberSignals )
+	{
+		return( 0.0 );
+	}
+
+	return( m_asSignals[iSignalNumber].dSampleRate / m_asSignals[iSignalNumber].iSegmentSize );
+}
+
+/*!
+*   \brief Compute the Welch PSD and band powers of every signal for one epoch.
+*   \param sWorker - reader and scratch of the calling thread
+*   \param sResult - loaded with the epoch results
+*   \param iEpoch - epoch number
+*   \param bKeepPsd - also return the PSD of every signal
+*/
+
+void CSpectralEDF::vProcessEpoch( worker_S &sWorker, epochResult_S &sResult, int iEpoch, bool bKeepPsd )
+{
+	int iNumberBands = (int)m_asBands.size();
+	int iSamplesPerRecord = sWorker.poEDF->iGetSamplesPerRecord();
+
+	sResult.iEpoch = iEpoch;
+	sResult.dStartTime = (double)iEpoch * m_iRecordsPerEpoch * sWorker.poEDF->dGetRecordDuration();
+	sResult.adBandPowers.assign( (size_t)m_iNumberSignals * iNumberBands, 0.0 );
+	sResult.aadPsd.resize( bKeepPsd ? m_iNumberSignals : 0 );
+
+	sResult.eEdfStatus = sWorker.poEDF->eReadRecords( (long long)iEpoch * m_iRecordsPerEpoch, m_iRecordsPerEpoch, &sWorker.asRecords[0] );
+	if( sResult.eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		return;
+	}
+
+	for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+	{
+		const signalPlan_S &sSignal = m_asSignals[iThisSignal];
+		const CFftPlan &oPlan = m_aoPlans[sSignal.iPlan];
+		int iOffset = sWorker.poEDF->iGetSignalOffset( iThisSignal );
+		int iNumberSamples = sWorker.poEDF->iGetNumberSamples( iThisSignal );
+		int iEpochSamples = iNumberSamples * m_iRecordsPerEpoch;
+		int iSegmentSize = sSignal.iSegmentSize;
+		int iHop = max( 1, iSegmentSize / 2 );
+		int iNumberBins = iSegmentSize / 2 + 1;
+		int iNumberSegments = 0;
+
+		// Gather the calibrated samples of this signal from all records of the epoch:
+		for( int iRecord = 0; iRecord < m_iRecordsPerEpoch; iRecord++ )
+		{
+			const short int *psSegment = &sWorker.asRecords[(size_t)iRecord * iSamplesPerRecord + iOffset];
+			double *pdSignal = &sWorker.pdSignal[(size_t)iRecord * iNumberSamples];
+
+			for( int i = 0; i < iNumberSamples; i++ )
+			{
+				pdSignal[i] = sSignal.dGain * psSegment[i] + sSignal.dOffset;
+			}
+		}
+
+		fill( sWorker.pdPsd, sWorker.pdPsd + iNumberBins, 0.0 );
+
+		for( int iStart = 0; iStart + iSegmentSize <= iEpochSamples; iStart += iHop )
+		{
+			const double *pdSegment = &sWorker.pdSignal[iStart];
+			double dMean = 0.0;
+
+			for( int i = 0; i < iSegmentSize; i++ )
+			{
+				dMean += pdSegment[i];
+			}
+			dMean /= iSegmentSize;
+
+			for( int i = 0; i < iSegmentSize; i++ )
+			{
+				sWorker.pdReal[i] = (pdSegment[i] - dMean) * sSignal.adWindow[i];
+				sWorker.pdImaginary[i] = 0.0;
+			}
+
+			oPlan.vForward( sWorker.pdReal, sWorker.pdImaginary );
+
+			for( int k = 0; k < iNumberBins; k++ )
+			{
+				sWorker.pdPsd[k] += sWorker.pdReal[k] * sWorker.pdReal[k] + sWorker.pdImaginary[k] * sWorker.pdImaginary[k];
+			}
+
+			iNumberSegments++;
+		}
+
+		if( iNumberSegments == 0 || sSignal.dWindowPower <= 0.0 )
+		{
+			continue;
+		}
+
+		// One-sided PSD in units^2/Hz (DC and Nyquist bins are not doubled):
+		double dScale = 1.0 / (iNumberSegments * sSignal.dSampleRate * sSignal.dWindowPower);
+		double dBinWidth = sSignal.dSampleRate / iSegmentSize;
+
+		for( int k = 0; k < iNumberBins; k++ )
+		{
+			sWorker.pdPsd[k] *= (k == 0 || k == iSegmentSize / 2) ? dScale : 2.0 * dScale;
+		}
+
+		for( int iBand = 0; iBand < iNumberBands; iBand++ )
+		{
+			double dPower = 0.0;
+
+			for( int k = 0; k < iNumberBins; k++ )
+			{
+				double dFrequency = k * dBinWidth;
+
+				if( dFrequency >= m_asBands[iBand].dLow && dFrequency < m_asBands[iBand].dHigh )
+				{
+					dPower += sWorker.pdPsd[k] * dBinWidth;
+				}
+			}
+
+			sResult.adBandPowers[(size_t)iThisSignal * iNumberBands + iBand] = dPower;
+		}
+
+		if( bKeepPsd )
+		{
+			sResult.aadPsd[iThisSignal].assign( sWorker.pdPsd, sWorker.pdPsd + iNumberBins );
+		}
+	}
+}
+
+/*!
+*   \brief Analyze every epoch of the file and hand the results to a callback in epoch order.
+*   \param fnCallback - called once per epoch (on the calling thread)
+*   \param bKeepPsd - also return the PSD of every signal
+*   \return Status of operation (last epoch error, if any).
+*/
+
+CReadEDF::edfStatus_E CSpectralEDF::eRun( epochCallback_F fnCallback, bool bKeepPsd )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	vector<worker_S> asWorkers;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		if( m_iNumberEpochs == 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_RECORD_REQUESTED;
+			break;
+		}
+
+		if( m_asBands.empty() )
+		{
+			eAddBand( 0.5, 4.0 );			// delta
+			eAddBand( 4.0, 8.0 );			// theta
+			eAddBand( 8.0, 13.0 );			// alpha
+			eAddBand( 13.0, 30.0 );			// beta
+		}
+
+		int iMaxEpochSamples = 0;
+		int iMaxSegmentSize = 0;
+
+		for( int iThisSignal = 0; iThisSignal < m_iNumberSignals; iThisSignal++ )
+		{
+			iMaxEpochSamples = max( iMaxEpochSamples, m_poEDF->iGetNumberSamples( iThisSignal ) * m_iRecordsPerEpoch );
+			iMaxSegmentSize = max( iMaxSegmentSize, m_asSignals[iThisSignal].iSegmentSize );
+		}
+
+		// Round every scratch array up to a 64 byte multiple, so each one starts cache line aligned:
+		size_t iSignalDoubles = (iMaxEpochSamples + 7) & ~7;
+		size_t iSegmentDoubles = (iMaxSegmentSize + 8) & ~7;
+
+		asWorkers.resize( m_iNumberThreads );
+
+		for( int iWorker = 0; iWorker < m_iNumberThreads; iWorker++ )
+		{
+			worker_S &sWorker = asWorkers[iWorker];
+
+			sWorker.poEDF = new CReadEDF( m_pszInputFile );
+			if( !sWorker.poEDF->bReadyStatus( &eEdfStatus ) )
+			{
+				break;
+			}
+
+			sWorker.asRecords.resize( (size_t)m_iRecordsPerEpoch * sWorker.poEDF->iGetSamplesPerRecord() );
+			sWorker.adArena.resize( iSignalDoubles + 3 * iSegmentDoubles + 8 );
+
+			double *pdArena = &sWorker.adArena[0];
+			pdArena += (8 - ((uintptr_t)pdArena % 64) / sizeof(double)) % 8;
+
+			sWorker.pdSignal = pdArena;
+			sWorker.pdReal = sWorker.pdSignal + iSignalDoubles;
+			sWorker.pdImaginary = sWorker.pdReal + iSegmentDoubles;
+			sWorker.pdPsd = sWorker.pdImaginary + iSegmentDoubles;
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		int iBatchSize = m_iNumberThreads * EPOCHS_PER_THREAD;
+		vector<epochResult_S> asResults( iBatchSize );
+
+		for( int iBatchStart = 0; iBatchStart < m_iNumberEpochs; iBatchStart += iBatchSize )
+		{
+			int iBatchEpochs = min( iBatchSize, m_iNumberEpochs - iBatchStart );
+			atomic<int> iNextEpoch( 0 );
+
+			auto fnWorker = [&]( int iWorker )
+			{
+				for( int i = iNextEpoch++; i < iBatchEpochs; i = iNextEpoch++ )
+				{
+					vProcessEpoch( asWorkers[iWorker], asResults[i], iBatchStart + i, bKeepPsd );
+				}
+			};
+
+			if( m_iNumberThreads == 1 )
+			{
+				fnWorker( 0 );
+			}
+			else
+			{
+				vector<thread> aoThreads;
+
+				for( int iWorker = 0; iWorker < m_iNumberThreads; iWorker++ )
+				{
+					aoThreads.push_back( thread( fnWorker, iWorker ) );
+				}
+
+				for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+				{
+					aoThreads[iThread].join();
+				}
+			}
+
+			// Stream the batch out in epoch order:
+			for( int i = 0; i < iBatchEpochs; i++ )
+			{
+				if( asResults[i].eEdfStatus != CReadEDF::EDF_SUCCESS )
+				{
+					eEdfStatus = asResults[i].eEdfStatus;
+				}
+
+				if( fnCallback )
+				{
+					fnCallback( asResults[i] );
+				}
+			}
+		}
+	} //for()
+
+	for( size_t iWorker = 0; iWorker < asWorkers.size(); iWorker++ )
+	{
+		delete asWorkers[iWorker].poEDF;
+	}
+
+	return( eEdfStatus );
+}
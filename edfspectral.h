@@ -0,0 +1,133 @@
+#ifndef EDFSPECTRAL_H
+#define EDFSPECTRAL_H
+
+#include <vector>
+#include <functional>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definitions for epoch-wise spectral analysis (Welch PSD and band power) of EDF data.
+*/
+
+/*! \class CFftPlan
+    \brief Precomputed radix-2 FFT (bit reversal table and twiddles) for one transform size.
+
+	A plan is read-only after construction, so one plan can be shared by any number of threads.
+*/
+
+class CFftPlan
+{
+	public:
+
+	CFftPlan( int iSize );
+
+	int iGetSize( void )
+	{
+		return( m_iSize );
+	};
+
+	void vForward( double *pdReal, double *pdImaginary ) const;
+
+	private:
+	int m_iSize;
+	vector<int> m_aiBitReverse;
+	vector<double> m_adCos;				///< cos(2 pi k / N), k < N/2
+	vector<double> m_adSin;				///< sin(2 pi k / N), k < N/2
+}; //class CFftPlan
+
+/*! \class CSpectralEDF
+    \brief Parallel Welch PSD and band power per epoch and signal over a whole EDF file.
+
+	Epochs are whole numbers of data records (e.g. 30 s epochs of 1 s records). Each signal is cut
+	into Hann windowed, 50% overlapping segments of a power of two samples, and the averaged
+	periodograms give the one-sided PSD (units^2/Hz) and band powers (units^2).
+
+	Epochs are processed in batches spread across worker threads; each worker owns a CReadEDF
+	instance and a scratch arena that are reused for the whole run. Results are handed to the
+	callback in epoch order as each batch completes, so memory stays bounded by the batch size.
+*/
+
+class CSpectralEDF
+{
+	public:
+
+	enum spectralConstants_E
+	{
+		EPOCHS_PER_THREAD = 4,			///< epochs per worker thread in one batch
+	};
+
+	struct band_S
+	{
+		double dLow;					///< lower band edge in Hz (inclusive)
+		double dHigh;					///< upper band edge in Hz (exclusive)
+	};
+
+	//! \brief Spectral results of one epoch (all signals).
+	struct epochResult_S
+	{
+		int iEpoch;
+		double dStartTime;							///< seconds from the start of the recording
+		CReadEDF::edfStatus_E eEdfStatus;
+		vector<double> adBandPowers;				///< [signal * number of bands + band]
+		vector< vector<double> > aadPsd;			///< [signal][bin], only when PSDs are requested
+	};
+
+	typedef function<void ( const epochResult_S & )> epochCallback_F;
+
+	CSpectralEDF( char *pszInputFile, double dEpochSeconds = 30.0, double dSegmentSeconds = 4.0, int iNumberThreads = 0 );
+	~CSpectralEDF( void );
+
+	CReadEDF::edfStatus_E eAddBand( double dLow, double dHigh );
+	CReadEDF::edfStatus_E eRun( epochCallback_F fnCallback, bool bKeepPsd = false );
+
+	int iGetNumberEpochs( void )
+	{
+		return( m_iNumberEpochs );
+	};
+
+	int iGetSegmentSize( int iSignalNumber );
+	double dGetBinWidth( int iSignalNumber );
+
+	private:
+
+	//! \brief Per-thread reader and scratch arena, allocated once per run.
+	struct worker_S
+	{
+		CReadEDF *poEDF;
+		vector<short int> asRecords;
+		vector<double> adArena;				///< backing store of the aligned scratch arrays below
+		double *pdSignal;					///< calibrated samples of one signal for one epoch
+		double *pdReal;
+		double *pdImaginary;
+		double *pdPsd;
+	};
+
+	struct signalPlan_S
+	{
+		int iSegmentSize;
+		int iPlan;							///< index into m_aoPlans
+		double dSampleRate;
+		double dGain;
+		double dOffset;
+		double dWindowPower;				///< sum of squared window values
+		vector<double> adWindow;
+	};
+
+	void vProcessEpoch( worker_S &sWorker, epochResult_S &sResult, int iEpoch, bool bKeepPsd );
+
+	char *m_pszInputFile;
+	CReadEDF *m_poEDF;
+	double m_dEpochSeconds;
+	double m_dSegmentSeconds;
+	int m_iNumberThreads;
+	int m_iNumberSignals;
+	int m_iRecordsPerEpoch;
+	int m_iNumberEpochs;
+	vector<band_S> m_asBands;
+	vector<CFftPlan> m_aoPlans;
+	vector<signalPlan_S> m_asSignals;
+}; //class CSpectralEDF
+
+#endif // EDFSPECTRAL_H
@@ -0,0 +1,186 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for forward-only (streaming) reading of EDF data from non-seekable inputs.
+*/
+
+#include <algorithm>
+#include <thread>
+#include "edfstream.h"
+using namespace std;
+
+/*!
+*   \brief Constructor - parse the header from the stream and allocate the ring buffers.
+*   \param poInput - binary input stream at the start of the header (not closed by the destructor)
+*   \param peEdfStatus - loaded with the header status if not null
+*/
+
+CStreamEDF::CStreamEDF( istream *poInput, CReadEDF::edfStatus_E *peEdfStatus )
+{
+	m_poInput = poInput;
+	m_iFilledSlots = 0;
+	m_bStopping = false;
+	m_poEDF = new CReadEDF( poInput, peEdfStatus );
+
+	if( m_poEDF->bReadyStatus() )
+	{
+		m_asSlots.resize( RING_SLOTS );
+
+		for( int iSlot = 0; iSlot < RING_SLOTS; iSlot++ )
+		{
+			m_asSlots[iSlot].asRecords.resize( (size_t)SLOT_RECORDS * m_poEDF->iGetSamplesPerRecord() );
+		}
+	}
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CStreamEDF::~CStreamEDF( void )
+{
+	delete m_poEDF;
+}
+
+/*!
+*   \brief Reader thread: fill the ring slots in order until end of stream (or the consumer stops).
+*/
+
+void CStreamEDF::vReadStream( void )
+{
+	long long llTotalRecords = -1;
+	long long llRecordsRead = 0;
+	streamsize iRecordSize = m_poEDF->iGetRecordSize();
+
+	m_poEDF->eGetNumberRecords( &llTotalRecords );		// -1 = unknown, read to end of stream
+
+	for( int iSlot = 0; ; iSlot = (iSlot + 1) % RING_SLOTS )
+	{
+		{
+			unique_lock<mutex> oLock( m_oMutex );
+			m_oSlotFreed.wait( oLock, [this]( void ) { return( m_bStopping || m_iFilledSlots < RING_SLOTS ); } );
+
+			if( m_bStopping )
+			{
+				return;
+			}
+		}
+
+		slot_S &sSlot = m_asSlots[iSlot];
+		long long llWanted = SLOT_RECORDS;
+
+		if( llTotalRecords >= 0 )
+		{
+			llWanted = min( llWanted, llTotalRecords - llRecordsRead );
+		}
+
+		sSlot.eEdfStatus = CReadEDF::EDF_SUCCESS;
+		sSlot.iNumberRecords = 0;
+		sSlot.bLast = (llWanted <= 0);
+
+		if( llWanted > 0 )
+		{
+			m_poInput->read( reinterpret_cast<char *>(&sSlot.asRecords[0]), (streamsize)(llWanted * iRecordSize) );
+
+			streamsize iBytes = m_poInput->gcount();
+			sSlot.iNumberRecords = (int)(iBytes / iRecordSize);
+
+			// A partial record, or fewer records than the header promised, is a truncated stream:
+			if( iBytes % iRecordSize != 0 || (llTotalRecords >= 0 && sSlot.iNumberRecords < llWanted) )
+			{
+				sSlot.eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+			}
+
+			sSlot.bLast = (sSlot.iNumberRecords < llWanted || (llTotalRecords >= 0 && llRecordsRead + llWanted >= llTotalRecords));
+			llRecordsRead += sSlot.iNumberRecords;
+		}
+
+		{
+			lock_guard<mutex> oLock( m_oMutex );
+			m_iFilledSlots++;
+		}
+
+		m_oSlotFilled.notify_one();
+
+		if( sSlot.bLast )
+		{
+			return;
+		}
+	}
+}
+
+/*!
+*   \brief Stream every data record to the callback (on the calling thread), in one pass.
+*   \param fnCallback - called per record with the record number and its samples (CReadEDF::eReadRecords() layout)
+*   \param pllRecords - loaded with the number of records delivered if not null
+*   \return EDF_SUCCESS at end of stream or when the callback stopped it, EDF_FILE_CONTENTS_ERROR if truncated.
+*/
+
+CReadEDF::edfStatus_E CStreamEDF::eRun( recordCallback_F fnCallback, long long *pllRecords )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	long long llRecord = 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( !m_poEDF->bReadyStatus( &eEdfStatus ) )
+		{
+			break;
+		}
+
+		if( !fnCallback )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		int iSamplesPerRecord = m_poEDF->iGetSamplesPerRecord();
+
+		m_bStopping = false;
+		m_iFilledSlots = 0;
+
+		thread oReader( &CStreamEDF::vReadStream, this );
+
+		for( int iSlot = 0; ; iSlot = (iSlot + 1) % RING_SLOTS )
+		{
+			{
+				unique_lock<mutex> oLock( m_oMutex );
+				m_oSlotFilled.wait( oLock, [this]( void ) { return( m_iFilledSlots > 0 ); } );
+			}
+
+			slot_S &sSlot = m_asSlots[iSlot];
+			bool bContinue = true;
+
+			for( int iThisRecord = 0; iThisRecord < sSlot.iNumberRecords && bContinue; iThisRecord++, llRecord++ )
+			{
+				bContinue = fnCallback( llRecord, &sSlot.asRecords[(size_t)iThisRecord * iSamplesPerRecord] );
+			}
+
+			bool bLast = sSlot.bLast || !bContinue || sSlot.eEdfStatus != CReadEDF::EDF_SUCCESS;
+			eEdfStatus = sSlot.eEdfStatus;
+
+			{
+				lock_guard<mutex> oLock( m_oMutex );
+				m_iFilledSlots--;
+				m_bStopping = bLast;
+			}
+
+			m_oSlotFreed.notify_one();
+
+			if( bLast )
+			{
+				break;
+			}
+		}
+
+		oReader.join();		// a reader blocked in read() returns when its data (or end of stream) arrives
+	} //for()
+
+	if( pllRecords != NULL )
+	{
+		*pllRecords = llRecord;
+	}
+
+	return( eEdfStatus );
+}
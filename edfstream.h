@@ -0,0 +1,81 @@
+#ifndef EDFSTREAM_H
+#define EDFSTREAM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for forward-only (streaming) reading of EDF data from non-seekable inputs.
+*/
+
+/*! \class CStreamEDF
+    \brief One pass over an EDF stream (pipe, stdin, socket): header first, then every data record to a callback.
+
+	The header is parsed by CReadEDF from the stream without seeking. eRun() then starts a reader
+	thread that fills a ring of RING_SLOTS fixed buffers (SLOT_RECORDS data records each) while the
+	calling thread hands each record to the callback, so decompression or the producing process
+	upstream overlaps with the consumer, and memory use does not depend on the recording length.
+	Nothing ever seeks. A header with an unknown number of data records (-1) is read to end of
+	stream; a known count stops the read there.
+
+	\code
+	CStreamEDF oStream( &cin );		// e.g. zcat night.edf.gz | tool
+	oStream.eRun( [&]( long long llRecord, const short int *psRecord ) { ...; return( true ); } );
+	\endcode
+
+	\note On Windows, put stdin in binary mode (_setmode( _fileno( stdin ), _O_BINARY )) first.
+*/
+
+class CStreamEDF
+{
+	public:
+
+	enum streamConstants_E
+	{
+		RING_SLOTS = 4,					///< buffers in the ring (one is read while the others are consumed)
+		SLOT_RECORDS = 16,				///< data records per buffer
+	};
+
+	//! \brief Called once per data record, in order; return false to stop the stream.
+	typedef function<bool ( long long llRecord, const short int *psRecord )> recordCallback_F;
+
+	CStreamEDF( istream *poInput, CReadEDF::edfStatus_E *peEdfStatus = NULL );
+	~CStreamEDF( void );
+
+	//! \brief Header access (signal labels, layout, calibration); do not use its random access reads.
+	CReadEDF *poGetHeader( void )
+	{
+		return( m_poEDF );
+	};
+
+	CReadEDF::edfStatus_E eRun( recordCallback_F fnCallback, long long *pllRecords = NULL );
+
+	private:
+
+	struct slot_S
+	{
+		vector<short int> asRecords;
+		int iNumberRecords;
+		CReadEDF::edfStatus_E eEdfStatus;
+		bool bLast;						///< no slot follows this one
+	};
+
+	void vReadStream( void );
+
+	istream *m_poInput;
+	CReadEDF *m_poEDF;
+	vector<slot_S> m_asSlots;
+	int m_iFilledSlots;					///< slots ready for the consumer
+	atomic<bool> m_bStopping;
+	mutex m_oMutex;
+	condition_variable m_oSlotFilled;
+	condition_variable m_oSlotFreed;
+}; //class CStreamEDF
+
+#endif // EDFSTREAM_H
@@ -0,0 +1,346 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for extracting event windows from many EDF files into a [batch, channel, time] tensor.
+*/
+
+#include <math.h>
+#include <limits>
+#include <new>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "edftensor.h"
+using namespace std;
+
+/*!
+*   \brief Constructor
+*   \param apszChannelLabels - channel labels, in tensor channel order (see CReadEDF::iFindSignal())
+*   \param iNumberChannels - number of channels
+*   \param iTimeSamples - samples per window in the tensor
+*   \param iNumberThreads - worker threads (0 = one per hardware thread)
+*/
+
+CTensorEDF::CTensorEDF( const char **apszChannelLabels, int iNumberChannels, int iTimeSamples, int iNumberThreads )
+{
+	for( int iChannel = 0; apszChannelLabels != NULL && iChannel < iNumberChannels; iChannel++ )
+	{
+		m_asChannelLabels.push_back( apszChannelLabels[iChannel] != NULL ? apszChannelLabels[iChannel] : "" );
+	}
+
+	m_iTimeSamples = max( iTimeSamples, 0 );
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CTensorEDF::~CTensorEDF( void )
+{
+}
+
+/*!
+*   \brief Allocate a TENSOR_ALIGNMENT aligned [batch, channel, time] buffer (release with vFreeTensor()).
+*   \return Tensor buffer.
+*/
+
+float *CTensorEDF::pfAllocateTensor( size_t iBatch, int iNumberChannels, int iTimeSamples )
+{
+	size_t iBytes = max( iBatch * iNumberChannels * iTimeSamples * sizeof(float), sizeof(float) );
+
+	return( (float *)::operator new( iBytes, align_val_t( TENSOR_ALIGNMENT ) ) );
+}
+
+/*!
+*   \brief Release a buffer from pfAllocateTensor().
+*/
+
+void CTensorEDF::vFreeTensor( float *pfTensor )
+{
+	if( pfTensor != NULL )
+	{
+		::operator delete( pfTensor, align_val_t( TENSOR_ALIGNMENT ) );
+	}
+}
+
+/*!
+*   \brief Fill every channel of one window with a value.
+*   \param pfWindow - first sample of the window's [channel, time] slice
+*/
+
+void CTensorEDF::vFillWindow( float *pfWindow, float fValue )
+{
+	fill( pfWindow, pfWindow + m_asChannelLabels.size() * m_iTimeSamples, fValue );
+}
+
+/*!
+*   \brief Extract all windows of one file (runs on a worker thread).
+*   \param sFile - input file
+*   \param aiEvents - indexes of this file's windows in asEvents
+*   \param asEvents - all windows
+*   \param pfTensor - tensor
+*   \param aeStatus - per-window status (only this file's entries are written)
+*/
+
+void CTensorEDF::vExtractFile( const string &sFile, const vector<size_t> &aiEvents, const vector<event_S> &asEvents,
+	float *pfTensor, vector<CReadEDF::edfStatus_E> &aeStatus )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	string sInputFile( sFile );
+	CReadEDF oEDF( &sInputFile[0], &eEdfStatus );
+	size_t iNumberChannels = m_asChannelLabels.size();
+	size_t iWindowSize = iNumberChannels * m_iTimeSamples;
+	vector<int> aiSignals( iNumberChannels, -1 );
+
+	for( size_t iChannel = 0; iChannel < iNumberChannels && eEdfStatus == CReadEDF::EDF_SUCCESS; iChannel++ )
+	{
+		aiSignals[iChannel] = oEDF.iFindSignal( m_asChannelLabels[iChannel].c_str() );
+		if( aiSignals[iChannel] < 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_SIGNAL_REQUESTED;
+		}
+	}
+
+	long long llNumberRecords = 0;
+	double dDuration = oEDF.dGetRecordDuration();
+
+	oEDF.eGetNumberRecords( &llNumberRecords );
+
+	if( eEdfStatus == CReadEDF::EDF_SUCCESS && dDuration <= 0.0 )
+	{
+		eEdfStatus = CReadEDF::EDF_FILE_CONTENTS_ERROR;
+	}
+
+	// Record range of every window; the range includes the record after the last sample when it exists,
+	// so the last interpolation point has its right neighbour:
+	vector< pair<long long, size_t> > aoByStart;
+	vector<long long> allEndRecords( aiEvents.size() );
+
+	for( size_t i = 0; i < aiEvents.size(); i++ )
+	{
+		const event_S &sEvent = asEvents[aiEvents[i]];
+
+		aeStatus[aiEvents[i]] = eEdfStatus;
+
+		if( eEdfStatus == CReadEDF::EDF_SUCCESS
+			&& (sEvent.dStart < 0.0 || sEvent.dDuration <= 0.0 || sEvent.dStart + sEvent.dDuration > llNumberRecords * dDuration + 1e-9) )
+		{
+			aeStatus[aiEvents[i]] = CReadEDF::EDF_INVALID_RECORD_REQUESTED;
+		}
+
+		if( aeStatus[aiEvents[i]] != CReadEDF::EDF_SUCCESS )
+		{
+			vFillWindow( &pfTensor[aiEvents[i] * iWindowSize], numeric_limits<float>::quiet_NaN() );
+			continue;
+		}
+
+		long long llFirstRecord = (long long)floor( sEvent.dStart / dDuration );
+		allEndRecords[i] = min( llNumberRecords, (long long)floor( (sEvent.dStart + sEvent.dDuration) / dDuration ) + 1 );
+		aoByStart.push_back( make_pair( llFirstRecord, i ) );
+	}
+
+	sort( aoByStart.begin(), aoByStart.end() );
+
+	// Coalesce the sorted windows into runs of records:
+	vector<run_S> asRuns;
+
+	for( size_t i = 0; i < aoByStart.size(); i++ )
+	{
+		long long llFirstRecord = aoByStart[i].first;
+		long long llEndRecord = allEndRecords[aoByStart[i].second];
+
+		if( !asRuns.empty() )
+		{
+			run_S &sRun = asRuns.back();
+			long long llRunEnd = sRun.llFirstRecord + sRun.llNumberRecords;
+
+			if( llFirstRecord <= llRunEnd + MAX_GAP_RECORDS && max( llRunEnd, llEndRecord ) - sRun.llFirstRecord <= MAX_RUN_RECORDS )
+			{
+				sRun.llNumberRecords = max( llRunEnd, llEndRecord ) - sRun.llFirstRecord;
+				sRun.aiEvents.push_back( aiEvents[aoByStart[i].second] );
+				continue;
+			}
+		}
+
+		run_S sRun;
+		sRun.llFirstRecord = llFirstRecord;
+		sRun.llNumberRecords = llEndRecord - llFirstRecord;
+		sRun.aiEvents.push_back( aiEvents[aoByStart[i].second] );
+		asRuns.push_back( sRun );
+	}
+
+	int iSamplesPerRecord = oEDF.iGetSamplesPerRecord();
+	vector<short int> asRecords;
+	vector<float> afSignal;
+
+	for( size_t iRun = 0; iRun < asRuns.size(); iRun++ )
+	{
+		const run_S &sRun = asRuns[iRun];
+
+		asRecords.resize( (size_t)sRun.llNumberRecords * iSamplesPerRecord );
+		eEdfStatus = oEDF.eReadRecords( sRun.llFirstRecord, sRun.llNumberRecords, &asRecords[0] );
+
+		for( size_t i = 0; i < sRun.aiEvents.size(); i++ )
+		{
+			size_t iEvent = sRun.aiEvents[i];
+			const event_S &sEvent = asEvents[iEvent];
+			float *pfWindow = &pfTensor[iEvent * iWindowSize];
+
+			aeStatus[iEvent] = eEdfStatus;
+
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				vFillWindow( pfWindow, numeric_limits<float>::quiet_NaN() );
+				continue;
+			}
+
+			for( size_t iChannel = 0; iChannel < iNumberChannels; iChannel++ )
+			{
+				int iSignal = aiSignals[iChannel];
+				int iNumberSamples = oEDF.iGetNumberSamples( iSignal );
+				int iSignalOffset = oEDF.iGetSignalOffset( iSignal );
+				double dRate = iNumberSamples / dDuration;
+				double dGain = 1.0;
+				double dOffset = 0.0;
+
+				oEDF.eGetCalibration( iSignal, &dGain, &dOffset );
+
+				// Sample positions of the window, relative to the first sample of the run:
+				double dFirst = (sEvent.dStart - sRun.llFirstRecord * dDuration) * dRate;
+				double dStep = sEvent.dDuration * dRate / max( m_iTimeSamples, 1 );
+				long long llAvailable = sRun.llNumberRecords * iNumberSamples;
+				long long llGatherFirst = max( 0LL, (long long)floor( dFirst ) );
+				long long llGatherEnd = min( llAvailable, (long long)floor( dFirst + (m_iTimeSamples - 1) * dStep ) + 2 );
+
+				// Gather the calibrated samples the window needs into one contiguous array:
+				afSignal.resize( (size_t)max( llGatherEnd - llGatherFirst, 1LL ) );
+
+				for( long long j = llGatherFirst; j < llGatherEnd; )
+				{
+					long long llRecord = j / iNumberSamples;
+					int iSample = (int)(j % iNumberSamples);
+					const short int *psSignal = &asRecords[(size_t)llRecord * iSamplesPerRecord + iSignalOffset];
+
+					for( ; iSample < iNumberSamples && j < llGatherEnd; iSample++, j++ )
+					{
+						afSignal[(size_t)(j - llGatherFirst)] = (float)(dGain * psSignal[iSample] + dOffset);
+					}
+				}
+
+				// Linear interpolation onto the tensor's time axis (an exact copy when aligned 1:1):
+				float *pfChannel = &pfWindow[iChannel * m_iTimeSamples];
+				long long llLast = llGatherEnd - llGatherFirst - 1;
+
+				for( int k = 0; k < m_iTimeSamples; k++ )
+				{
+					double dPosition = dFirst + k * dStep - llGatherFirst;
+					long long j = min( max( (long long)floor( dPosition ), 0LL ), llLast );
+					float fFraction = (float)(dPosition - j);
+					float fLeft = afSignal[(size_t)j];
+					float fRight = afSignal[(size_t)min( j + 1, llLast )];
+
+					pfChannel[k] = fLeft + fFraction * (fRight - fLeft);
+				}
+			}
+		}
+	}
+}
+
+/*!
+*   \brief Extract all windows into the tensor.
+*   \param asFiles - input files
+*   \param asEvents - windows; window b fills tensor slice b
+*   \param pfTensor - asEvents.size() * channels * time samples floats (see pfAllocateTensor())
+*   \param paeStatus - loaded with the status of each window if not null
+*   \return EDF_SUCCESS, or the status of the first window that failed.
+*/
+
+CReadEDF::edfStatus_E CTensorEDF::eExtract( const vector<string> &asFiles, const vector<event_S> &asEvents, float *pfTensor,
+	vector<CReadEDF::edfStatus_E> *paeStatus )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_SUCCESS;
+	vector<CReadEDF::edfStatus_E> aeStatus( asEvents.size(), CReadEDF::EDF_VOID );
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( pfTensor == NULL || m_asChannelLabels.empty() || m_iTimeSamples <= 0 )
+		{
+			eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;
+			break;
+		}
+
+		// Group the windows by file:
+		vector< vector<size_t> > aaiFileEvents( asFiles.size() );
+		vector<int> aiActiveFiles;
+
+		for( size_t iEvent = 0; iEvent < asEvents.size(); iEvent++ )
+		{
+			int iFile = asEvents[iEvent].iFile;
+
+			if( iFile < 0 || iFile >= (int)asFiles.size() )
+			{
+				aeStatus[iEvent] = CReadEDF::EDF_INVALID_PARAMETER;
+				vFillWindow( &pfTensor[iEvent * m_asChannelLabels.size() * m_iTimeSamples], numeric_limits<float>::quiet_NaN() );
+				continue;
+			}
+
+			if( aaiFileEvents[iFile].empty() )
+			{
+				aiActiveFiles.push_back( iFile );
+			}
+
+			aaiFileEvents[iFile].push_back( iEvent );
+		}
+
+		atomic<size_t> iNextFile( 0 );
+
+		auto fnWorker = [&]( void )
+		{
+			for( size_t i = iNextFile++; i < aiActiveFiles.size(); i = iNextFile++ )
+			{
+				int iFile = aiActiveFiles[i];
+				vExtractFile( asFiles[iFile], aaiFileEvents[iFile], asEvents, pfTensor, aeStatus );
+			}
+		};
+
+		int iNumberThreads = (int)min( (size_t)m_iNumberThreads, aiActiveFiles.size() );
+
+		if( iNumberThreads <= 1 )
+		{
+			fnWorker();
+		}
+		else
+		{
+			vector<thread> aoThreads;
+
+			for( int iThread = 0; iThread < iNumberThreads; iThread++ )
+			{
+				aoThreads.push_back( thread( fnWorker ) );
+			}
+
+			for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+			{
+				aoThreads[iThread].join();
+			}
+		}
+
+		for( size_t iEvent = 0; iEvent < aeStatus.size(); iEvent++ )
+		{
+			if( aeStatus[iEvent] != CReadEDF::EDF_SUCCESS )
+			{
+				eEdfStatus = aeStatus[iEvent];
+				break;
+			}
+		}
+	} //for()
+
+	if( paeStatus != NULL )
+	{
+		*paeStatus = aeStatus;
+	}
+
+	return( eEdfStatus );
+}
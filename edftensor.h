@@ -0,0 +1,86 @@
+#ifndef EDFTENSOR_H
+#define EDFTENSOR_H
+
+#include <string>
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for extracting event windows from many EDF files into a [batch, channel, time] tensor.
+*/
+
+/*! \class CTensorEDF
+    \brief Fixed-size, calibrated, optionally resampled windows from many files into one float tensor.
+
+	Each window (event_S) names a file, a start time and a duration; window b of the event list
+	becomes tensor slice [b][channel][0 .. time samples), sampled at iTimeSamples evenly spaced
+	points with linear interpolation. When the window length equals the native sample count and
+	the start is on a sample, the interpolation reduces to a plain copy of the calibrated samples.
+	Interpolation does not low-pass filter, so strong downsampling needs band-limited input.
+
+	I/O is planned per file: the file's windows are sorted by start time and coalesced into runs
+	of data records (windows closer than MAX_GAP_RECORDS records share one read, up to
+	MAX_RUN_RECORDS per run), so the event order given by the caller never causes random reads.
+	Files are spread across worker threads, each with its own reader and read buffer.
+
+	\code
+	float *pfTensor = CTensorEDF::pfAllocateTensor( asEvents.size(), 3, 3000 );
+	const char *apszChannels[] = { "EEG Fpz-Cz", "EEG Pz-Oz", "EOG horizontal" };
+	CTensorEDF oTensor( apszChannels, 3, 3000 );
+	oTensor.eExtract( asFiles, asEvents, pfTensor );
+	\endcode
+
+	Windows that can not be extracted (file error, missing channel, outside the recording) are
+	filled with NaN and reported through the optional per-window status list.
+*/
+
+class CTensorEDF
+{
+	public:
+
+	enum tensorConstants_E
+	{
+		TENSOR_ALIGNMENT = 64,			///< byte alignment of pfAllocateTensor() buffers
+		MAX_GAP_RECORDS = 4,			///< windows at most this many records apart share one read
+		MAX_RUN_RECORDS = 256,			///< data records per coalesced read
+	};
+
+	//! \brief One window to extract.
+	struct event_S
+	{
+		int iFile;						///< index into the file list
+		double dStart;					///< window start, seconds from the start of the recording
+		double dDuration;				///< window length in seconds
+	};
+
+	CTensorEDF( const char **apszChannelLabels, int iNumberChannels, int iTimeSamples, int iNumberThreads = 0 );
+	~CTensorEDF( void );
+
+	static float *pfAllocateTensor( size_t iBatch, int iNumberChannels, int iTimeSamples );
+	static void vFreeTensor( float *pfTensor );
+
+	CReadEDF::edfStatus_E eExtract( const vector<string> &asFiles, const vector<event_S> &asEvents, float *pfTensor,
+		vector<CReadEDF::edfStatus_E> *paeStatus = NULL );
+
+	private:
+
+	//! \brief Coalesced record range and the windows (event indexes) it serves.
+	struct run_S
+	{
+		long long llFirstRecord;
+		long long llNumberRecords;
+		vector<size_t> aiEvents;
+	};
+
+	void vExtractFile( const string &sFile, const vector<size_t> &aiEvents, const vector<event_S> &asEvents,
+		float *pfTensor, vector<CReadEDF::edfStatus_E> &aeStatus );
+	void vFillWindow( float *pfWindow, float fValue );
+
+	vector<string> m_asChannelLabels;
+	int m_iTimeSamples;
+	int m_iNumberThreads;
+}; //class CTensorEDF
+
+#endif // EDFTENSOR_H
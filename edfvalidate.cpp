@@ -0,0 +1,307 @@
+/*!
+	File name: $HeadURL:
+    \file
+    \brief Contains class implementation for full-file EDF validation (header consistency and sample ranges).
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "edfvalidate.h"
+using namespace std;
+
+/*!
+*   \brief Constructor
+*   \param iNumberThreads - data scan threads (0 = one per hardware thread)
+*/
+
+CValidateEDF::CValidateEDF( int iNumberThreads )
+{
+	m_iNumberThreads = (iNumberThreads > 0) ? iNumberThreads : (int)thread::hardware_concurrency();
+	m_iNumberThreads = max( m_iNumberThreads, 1 );
+}
+
+/*!
+*   \brief Destructor
+*/
+
+CValidateEDF::~CValidateEDF( void )
+{
+}
+
+/*!
+*   \brief Append an issue to the report (and mark the report invalid).
+*/
+
+void CValidateEDF::vAddIssue( report_S *psReport, check_E eCheck, int iSignal, long long llRecord, long long llCount, const char *pszDescription )
+{
+	issue_S sIssue;
+
+	sIssue.eCheck = eCheck;
+	sIssue.iSignal = iSignal;
+	sIssue.llRecord = llRecord;
+	sIssue.llCount = llCount;
+	snprintf( sIssue.szDescription, sizeof(sIssue.szDescription), "%s", pszDescription );
+
+	psReport->asIssues.push_back( sIssue );
+	psReport->bValid = false;
+}
+
+/*!
+*   \brief Validate one EDF file.
+*	\note Returns EDF_SUCCESS when the file passed every check; psReport lists what failed otherwise.
+*   \param pszInputFile - input file
+*   \param psReport - loaded with the validation report
+*   \param bScanData - also check every data sample against its digital range
+*   \return Status of operation.
+*/
+
+CReadEDF::edfStatus_E CValidateEDF::eValidate( char *pszInputFile, report_S *psReport, bool bScanData )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	CReadEDF oEDF( pszInputFile, &eEdfStatus );
+	char szDescription[96];
+
+	psReport->bValid = true;
+	psReport->llFileSize = 0;
+	psReport->llExpectedFileSize = 0;
+	psReport->llRecordsScanned = 0;
+	psReport->allOutOfRange.clear();
+	psReport->asIssues.clear();
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		if( eEdfStatus == CReadEDF::EDF_FILE_OPEN_ERROR )
+		{
+			vAddIssue( psReport, CHECK_OPEN, -1, -1, 0, "file can not be opened" );
+			break;
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			vAddIssue( psReport, CHECK_SAMPLES_PER_RECORD, -1, -1, 0, "header can not be parsed (signal count or samples per record)" );
+			break;
+		}
+
+		// Header consistency:
+		CReadEDF::edfStatus_E eFieldStatus = CReadEDF::EDF_VOID;
+		int iNumberSignals = 0;
+		long long llNumberRecords = 0;
+		int iHeaderSize = 0;
+
+		oEDF.pszGetStartDate( &eFieldStatus );
+		if( eFieldStatus != CReadEDF::EDF_SUCCESS )
+		{
+			vAddIssue( psReport, CHECK_START_DATE, -1, -1, 0, "start date is not dd.mm.yy" );
+		}
+
+		oEDF.pszGetStartTime( &eFieldStatus );
+		if( eFieldStatus != CReadEDF::EDF_SUCCESS )
+		{
+			vAddIssue( psReport, CHECK_START_TIME, -1, -1, 0, "start time is not hh.mm.ss" );
+		}
+
+		oEDF.eGetNumberSignals( &iNumberSignals );
+		oEDF.eGetNumberRecords( &llNumberRecords );
+
+		if( oEDF.eGetHeaderSize( &iHeaderSize ) != CReadEDF::EDF_SUCCESS || iHeaderSize != oEDF.iGetHeaderBytes() )
+		{
+			snprintf( szDescription, sizeof(szDescription), "header size field %d, expected 256 + %d * 256 = %d",
+				iHeaderSize, iNumberSignals, oEDF.iGetHeaderBytes() );
+			vAddIssue( psReport, CHECK_HEADER_SIZE, -1, -1, 0, szDescription );
+		}
+
+		if( llNumberRecords < 0 )
+		{
+			vAddIssue( psReport, CHECK_NUMBER_RECORDS, -1, -1, 0, "number of data records is unknown (-1)" );
+		}
+
+		if( oEDF.dGetRecordDuration() < 0.0 )
+		{
+			vAddIssue( psReport, CHECK_DURATION, -1, -1, 0, "negative data record duration" );
+		}
+
+		vector<int> aiDigitalMinimums( iNumberSignals );
+		vector<int> aiDigitalMaximums( iNumberSignals );
+		bool bRangesValid = true;
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			oEDF.eGetDigitalRange( iThisSignal, &aiDigitalMinimums[iThisSignal], &aiDigitalMaximums[iThisSignal] );
+
+			if( aiDigitalMinimums[iThisSignal] >= aiDigitalMaximums[iThisSignal]
+				|| aiDigitalMinimums[iThisSignal] < -32768 || aiDigitalMaximums[iThisSignal] > 32767 )
+			{
+				snprintf( szDescription, sizeof(szDescription), "digital minimum %d / maximum %d is not a valid 16 bit range",
+					aiDigitalMinimums[iThisSignal], aiDigitalMaximums[iThisSignal] );
+				vAddIssue( psReport, CHECK_DIGITAL_RANGE, iThisSignal, -1, 0, szDescription );
+				bRangesValid = false;
+			}
+		}
+
+		// File size against the header:
+		ifstream oFile( pszInputFile, ios::in | ios::binary | ios::ate );
+		psReport->llFileSize = (long long)oFile.tellg();
+		oFile.close();
+
+		long long llRecordSize = oEDF.iGetRecordSize();
+		long long llRecordsPresent = (psReport->llFileSize - oEDF.iGetHeaderBytes()) / llRecordSize;
+		llRecordsPresent = max( llRecordsPresent, 0LL );
+
+		if( llNumberRecords >= 0 )
+		{
+			psReport->llExpectedFileSize = oEDF.iGetHeaderBytes() + llNumberRecords * llRecordSize;
+
+			if( psReport->llFileSize != psReport->llExpectedFileSize )
+			{
+				snprintf( szDescription, sizeof(szDescription), "file size %lld, header implies %lld",
+					psReport->llFileSize, psReport->llExpectedFileSize );
+				vAddIssue( psReport, CHECK_FILE_SIZE, -1, -1, 0, szDescription );
+			}
+
+			llRecordsPresent = min( llRecordsPresent, llNumberRecords );
+		}
+
+		if( !bScanData || !bRangesValid || llRecordsPresent == 0 )
+		{
+			break;
+		}
+
+		// Parallel data scan over the complete records that are present:
+		long long llRecordsPerTask = max( 1LL, (long long)CHUNK_BYTES / llRecordSize );
+		long long llNumberTasks = (llRecordsPresent + llRecordsPerTask - 1) / llRecordsPerTask;
+		int iSamplesPerRecord = oEDF.iGetSamplesPerRecord();
+		vector<int> aiOffsets( iNumberSignals + 1 );
+		atomic<long long> llNextTask( 0 );
+		mutex oMergeMutex;
+		vector<long long> allFirstBadRecord( iNumberSignals, -1 );
+		bool bReadError = false;
+		long long llReadErrorRecord = -1;
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			aiOffsets[iThisSignal] = oEDF.iGetSignalOffset( iThisSignal );
+		}
+		aiOffsets[iNumberSignals] = iSamplesPerRecord;
+
+		psReport->allOutOfRange.assign( iNumberSignals, 0 );
+
+		auto fnScan = [&]( void )
+		{
+			ifstream oData( pszInputFile, ios::in | ios::binary );
+			vector<short int> asChunk( (size_t)llRecordsPerTask * iSamplesPerRecord );
+			vector<long long> allOutOfRange( iNumberSignals, 0 );
+			vector<long long> allFirstBad( iNumberSignals, -1 );
+			long long llFailedRecord = -1;
+
+			for( long long llTask = llNextTask++; llTask < llNumberTasks; llTask = llNextTask++ )
+			{
+				long long llFirstRecord = llTask * llRecordsPerTask;
+				long long llRecords = min( llRecordsPerTask, llRecordsPresent - llFirstRecord );
+
+				oData.clear();
+				oData.seekg( (streamoff)(oEDF.iGetHeaderBytes() + llFirstRecord * llRecordSize) );
+				oData.read( reinterpret_cast<char *>(&asChunk[0]), (streamsize)(llRecords * llRecordSize) );
+
+				if( oData.fail() )
+				{
+					llFailedRecord = llFirstRecord;
+					break;
+				}
+
+				for( long long llRecord = 0; llRecord < llRecords; llRecord++ )
+				{
+					const short int *psRecord = &asChunk[(size_t)(llRecord * iSamplesPerRecord)];
+
+					for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+					{
+						const short int *psSamples = &psRecord[aiOffsets[iThisSignal]];
+						int iNumberSamples = aiOffsets[iThisSignal + 1] - aiOffsets[iThisSignal];
+						int iMinimum = aiDigitalMinimums[iThisSignal];
+						int iMaximum = aiDigitalMaximums[iThisSignal];
+						int iBad = 0;
+
+						// Branch free so the compiler can vectorize the compares:
+						for( int i = 0; i < iNumberSamples; i++ )
+						{
+							iBad += (psSamples[i] < iMinimum) | (psSamples[i] > iMaximum);
+						}
+
+						if( iBad != 0 )
+						{
+							allOutOfRange[iThisSignal] += iBad;
+							if( allFirstBad[iThisSignal] < 0 )
+							{
+								allFirstBad[iThisSignal] = llFirstRecord + llRecord;
+							}
+						}
+					}
+				}
+			}
+
+			lock_guard<mutex> oLock( oMergeMutex );
+
+			for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+			{
+				psReport->allOutOfRange[iThisSignal] += allOutOfRange[iThisSignal];
+
+				if( allFirstBad[iThisSignal] >= 0
+					&& (allFirstBadRecord[iThisSignal] < 0 || allFirstBad[iThisSignal] < allFirstBadRecord[iThisSignal]) )
+				{
+					allFirstBadRecord[iThisSignal] = allFirstBad[iThisSignal];
+				}
+			}
+
+			if( llFailedRecord >= 0 )
+			{
+				bReadError = true;
+				llReadErrorRecord = (llReadErrorRecord < 0) ? llFailedRecord : min( llReadErrorRecord, llFailedRecord );
+			}
+		};
+
+		int iNumberThreads = (int)min( (long long)m_iNumberThreads, llNumberTasks );
+
+		if( iNumberThreads <= 1 )
+		{
+			fnScan();
+		}
+		else
+		{
+			vector<thread> aoThreads;
+
+			for( int iThread = 0; iThread < iNumberThreads; iThread++ )
+			{
+				aoThreads.push_back( thread( fnScan ) );
+			}
+
+			for( size_t iThread = 0; iThread < aoThreads.size(); iThread++ )
+			{
+				aoThreads[iThread].join();
+			}
+		}
+
+		psReport->llRecordsScanned = llRecordsPresent;
+
+		if( bReadError )
+		{
+			vAddIssue( psReport, CHECK_DATA_READ, -1, llReadErrorRecord, 0, "data records can not be read" );
+		}
+
+		for( int iThisSignal = 0; iThisSignal < iNumberSignals; iThisSignal++ )
+		{
+			if( psReport->allOutOfRange[iThisSignal] != 0 )
+			{
+				snprintf( szDescription, sizeof(szDescription), "%lld samples outside digital range %d..%d",
+					psReport->allOutOfRange[iThisSignal], aiDigitalMinimums[iThisSignal], aiDigitalMaximums[iThisSignal] );
+				vAddIssue( psReport, CHECK_SAMPLE_RANGE, iThisSignal, allFirstBadRecord[iThisSignal],
+					psReport->allOutOfRange[iThisSignal], szDescription );
+			}
+		}
+	} //for()
+
+	return( psReport->bValid ? CReadEDF::EDF_SUCCESS : CReadEDF::EDF_FILE_CONTENTS_ERROR );
+}
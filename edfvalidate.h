@@ -0,0 +1,81 @@
+#ifndef EDFVALIDATE_H
+#define EDFVALIDATE_H
+
+#include <vector>
+#include "edfplus.h"
+using namespace std;
+
+/*!
+	\file
+	\brief Contains class definition for full-file EDF validation (header consistency and sample ranges).
+*/
+
+/*! \class CValidateEDF
+    \brief Validate an EDF file at ingest: header consistency first, then every data sample.
+
+	Header checks: start date and time, header byte count against 256 + ns * 256, number of data
+	records, samples per record, record duration, digital minimum < maximum for every signal, and
+	the file size against header bytes + number of records * record size.
+
+	The data scan splits the complete data records over worker threads. Each thread reads large
+	chunks with its own file handle and counts, per signal, the samples outside the signal's
+	digital range with a branch free compare loop the compiler can vectorize.
+*/
+
+class CValidateEDF
+{
+	public:
+
+	enum validateConstants_E
+	{
+		CHUNK_BYTES = 4 * 1024 * 1024,		///< target bytes read per data scan task
+	};
+
+	enum check_E
+	{
+		CHECK_OPEN=0,
+		CHECK_START_DATE,
+		CHECK_START_TIME,
+		CHECK_HEADER_SIZE,
+		CHECK_NUMBER_RECORDS,
+		CHECK_DURATION,
+		CHECK_SAMPLES_PER_RECORD,
+		CHECK_DIGITAL_RANGE,
+		CHECK_FILE_SIZE,
+		CHECK_DATA_READ,
+		CHECK_SAMPLE_RANGE,
+	};
+
+	//! \brief One failed check.
+	struct issue_S
+	{
+		check_E eCheck;
+		int iSignal;						///< -1 if not signal specific
+		long long llRecord;					///< first offending data record, -1 if not record specific
+		long long llCount;					///< number of offending samples (CHECK_SAMPLE_RANGE), else 0
+		char szDescription[96];
+	};
+
+	//! \brief Structured validation report.
+	struct report_S
+	{
+		bool bValid;
+		long long llFileSize;
+		long long llExpectedFileSize;
+		long long llRecordsScanned;
+		vector<long long> allOutOfRange;	///< per signal: samples outside the digital range
+		vector<issue_S> asIssues;
+	};
+
+	CValidateEDF( int iNumberThreads = 0 );
+	~CValidateEDF( void );
+
+	CReadEDF::edfStatus_E eValidate( char *pszInputFile, report_S *psReport, bool bScanData = true );
+
+	private:
+	static void vAddIssue( report_S *psReport, check_E eCheck, int iSignal, long long llRecord, long long llCount, const char *pszDescription );
+
+	int m_iNumberThreads;
+}; //class CValidateEDF
+
+#endif // EDFVALIDATE_H
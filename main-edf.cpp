@@ -9,6 +9,16 @@
 
 		  EDF input files previously used:
 		  "C:\2014-05-00 MindWare Programming Exercise\TestFile1.edf" (and TestFile2.edf)
+
+		  Non-interactive export mode (for batch jobs, does not wait for a key):
+		  ReadEDF <input.edf> --export <output.npy|.csv|.raw> [--format raw|npy|csv]
+		          [--signals 1,3,"EEG Fp1-REF"] [--start <seconds>] [--duration <seconds>]
+		          [--calibrate] [--threads <n>]
+		  Signal numbers are 1 based (as displayed); anything that is not a number is a signal label.
+		  The input may also be gzip or seekable zstd compressed (see edfcompressed.h for the build flags).
+
+		  Local recording server (Linux; clients use CClientEDF, stop with Ctrl+C or SIGTERM):
+		  ReadEDF --serve <socket path>
 */
 
 /*!
@@ -25,7 +35,170 @@
 */
 
 #include <iostream>
+#include <string>
+#include <string.h>
 #include "edfplus.h"
+#include "edfexport.h"
+#include "edfcompressed.h"
+#include "edfserver.h"
+
+#if defined(__linux__)
+#include <signal.h>
+
+static CServerEDF *s_poServer = NULL;	///< server stopped by vStopServer()
+
+//! \brief SIGINT/SIGTERM handler for the server mode.
+static void vStopServer( int )
+{
+	if( s_poServer != NULL )
+	{
+		s_poServer->vStop();
+	}
+}
+#endif
+
+/*!
+*   \brief Run the local recording server until SIGINT or SIGTERM.
+*   \param pszSocketPath - Unix domain socket path
+*   \return Status of operation.
+*/
+
+static CReadEDF::edfStatus_E eRunServer( const char *pszSocketPath )
+{
+#if defined(__linux__)
+	CServerEDF oServer( pszSocketPath );
+	struct sigaction sAction;
+
+	memset( &sAction, 0, sizeof(sAction) );
+	sAction.sa_handler = vStopServer;
+	s_poServer = &oServer;
+	sigaction( SIGINT, &sAction, NULL );
+	sigaction( SIGTERM, &sAction, NULL );
+
+	cout << "Serving recordings on " << pszSocketPath << endl;
+
+	CReadEDF::edfStatus_E eEdfStatus = oServer.eRun();
+	s_poServer = NULL;
+
+	if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+	{
+		cout << "Can not create the server socket: " << pszSocketPath << endl;
+	}
+
+	return( eEdfStatus );
+#else
+	cout << "The server mode is only available on Linux" << endl;
+	return( CReadEDF::EDF_INVALID_PARAMETER );
+#endif
+}
+
+/*!
+*   \brief Run the non-interactive export mode from the command line options.
+*   \param poEDF - opened reader
+*   \param argc, argv - command line (options start at argv[2])
+*   \return Status of operation.
+*/
+
+static CReadEDF::edfStatus_E eRunExport( CReadEDF *poEDF, int argc, char* argv[] )
+{
+	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_INVALID_PARAMETER;	// be pessimistic
+	const char *pszOutputFile = NULL;
+	const char *pszFormat = NULL;
+	const char *pszSignals = NULL;
+	double dStartSeconds = 0.0;
+	double dDurationSeconds = -1.0;
+	bool bCalibrate = false;
+	int iNumberThreads = 0;
+
+	// Fake for loop for common error exit:
+	for( bool allDone = false; allDone == false; allDone = true )
+	{
+		int iArg = 2;
+
+		for( ; iArg < argc; iArg++ )
+		{
+			string sOption( argv[iArg] );
+			bool bHasValue = (iArg + 1 < argc);
+
+			if( sOption == "--calibrate" )				bCalibrate = true;
+			else if( sOption == "--export" && bHasValue )	pszOutputFile = argv[++iArg];
+			else if( sOption == "--format" && bHasValue )	pszFormat = argv[++iArg];
+			else if( sOption == "--signals" && bHasValue )	pszSignals = argv[++iArg];
+			else if( sOption == "--start" && bHasValue )	dStartSeconds = atof( argv[++iArg] );
+			else if( sOption == "--duration" && bHasValue )	dDurationSeconds = atof( argv[++iArg] );
+			else if( sOption == "--threads" && bHasValue )	iNumberThreads = atoi( argv[++iArg] );
+			else break;
+		}
+
+		if( iArg != argc || pszOutputFile == NULL )
+		{
+			cout << "Invalid export option: " << ((iArg < argc) ? argv[iArg] : "(missing --export <file>)") << endl;
+			break;
+		}
+
+		CExportEDF::format_E eFormat = CExportEDF::FORMAT_NPY;
+
+		if( !CExportEDF::bFormatFromName( (pszFormat != NULL) ? pszFormat : pszOutputFile, &eFormat ) )
+		{
+			cout << "Unknown export format (use raw, npy or csv): " << ((pszFormat != NULL) ? pszFormat : pszOutputFile) << endl;
+			break;
+		}
+
+		CExportEDF oExport( poEDF, iNumberThreads );
+		oExport.vSetCalibrate( bCalibrate );
+
+		eEdfStatus = oExport.eSetTimeRange( dStartSeconds, dDurationSeconds );
+
+		// Signal list: "1,3,EEG Fp1-REF" (numbers are 1 based as displayed, anything else is a label):
+		string sSignals( (pszSignals != NULL) ? pszSignals : "" );
+		size_t iStart = 0;
+
+		while( eEdfStatus == CReadEDF::EDF_SUCCESS && iStart < sSignals.size() )
+		{
+			size_t iComma = sSignals.find( ',', iStart );
+			string sSignal = sSignals.substr( iStart, (iComma == string::npos) ? string::npos : iComma - iStart );
+
+			if( !sSignal.empty() && sSignal.find_first_not_of( "0123456789" ) == string::npos )
+			{
+				eEdfStatus = oExport.eSelectSignal( atoi( sSignal.c_str() ) - 1 );
+			}
+			else
+			{
+				eEdfStatus = oExport.eSelectSignal( sSignal.c_str() );
+			}
+
+			if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+			{
+				cout << "Unknown signal: " << sSignal << endl;
+			}
+
+			iStart = (iComma == string::npos) ? sSignals.size() : iComma + 1;
+		}
+
+		if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			break;
+		}
+
+		long long llRowsWritten = 0;
+		eEdfStatus = oExport.eExport( pszOutputFile, eFormat, &llRowsWritten );
+
+		if( eEdfStatus == CReadEDF::EDF_INVALID_SIGNAL_REQUESTED )
+		{
+			cout << "Selected signals must have the same sample rate (use --signals)" << endl;
+		}
+		else if( eEdfStatus != CReadEDF::EDF_SUCCESS )
+		{
+			cout << "Export failed (status " << eEdfStatus << ")" << endl;
+		}
+		else
+		{
+			cout << "Exported " << llRowsWritten << " samples per signal to " << pszOutputFile << endl;
+		}
+	} //for()
+
+	return( eEdfStatus );
+}
 
 int main(int argc, char* argv[])
 {
@@ -33,13 +206,20 @@ int main(int argc, char* argv[])
 	
 	CReadEDF *poEDF = NULL;
 	CReadEDF::edfStatus_E eEdfStatus = CReadEDF::EDF_VOID;
+	bool bInteractive = (argc <= 2);	// export options make it a non-interactive (batch) run
 
 	cout << endl << "ReadEDF program by Kent H, 2014-05-20 (Version 1RC1)" << endl << endl;
 
     // Fake for loop for common error exit:
     for( bool allDone = false; allDone == false; allDone = true )
     {
-		if( argc == 2 )
+		if( argc == 3 && string( argv[1] ) == "--serve" )
+		{
+			eEdfStatus = eRunServer( argv[2] );
+			break;
+		}
+
+		if( argc >= 2 )
 		{
 			cout << "Filename entered was: " << argv[1] << endl;
 		}
@@ -50,7 +230,7 @@ int main(int argc, char* argv[])
 			break;			// if not executable name + single input file then exit with error status
 		}
 		
-		poEDF = new CReadEDF( argv[1] );
+		poEDF = CCompressedStreamEDF::poOpenEDF( argv[1] );		// .edf, .edf.gz or seekable .edf.zst
 
 		if( !poEDF->bReadyStatus( &eEdfStatus ) )
 		{
@@ -62,6 +242,12 @@ int main(int argc, char* argv[])
 			break;		// exit with error status
 		}
 
+		if( !bInteractive )
+		{
+			eEdfStatus = eRunExport( poEDF, argc, argv );
+			break;
+		}
+
 		cout << "Start Time = " << poEDF->pszGetStartTime() << endl;
 		cout << "Start Date = " << poEDF->pszGetStartDate() << endl;
 		cout << "Number of signals = " << poEDF->pszGetNumberSignals() << endl;
@@ -82,7 +268,7 @@ int main(int argc, char* argv[])
 			cout << "Signal " << i+1 << " Label = " << poEDF->pszGetSignalLabel( i ) << endl;
 
 			int iSampleValue = 0;
-			eEdfStatus = poEDF->eGetSample( i, 1, &iSampleValue );
+			eEdfStatus = poEDF->eGetSample( i, 0, &iSampleValue );
 
 			cout << "First Sample = " << iSampleValue << endl;
 		}
@@ -96,9 +282,14 @@ int main(int argc, char* argv[])
 		iRetVal = EXIT_SUCCESS ;
 	}
 
-	char cKey = 0;
-	cout << endl << "Press any key followed by the Enter key to continue: ";
-	cin >> cKey;
+	delete poEDF;
+
+	if( bInteractive )
+	{
+		char cKey = 0;
+		cout << endl << "Press any key followed by the Enter key to continue: ";
+		cin >> cKey;
+	}
 
 	return( iRetVal );
 